@@ -0,0 +1,274 @@
+#ifndef _ASTRE_ASTRE_H
+#define _ASTRE_ASTRE_H
+
+/*
+    ASTRE a-contrario single trajectory extraction
+    Copyright (C) 2011 Mael Primet (mael.primet AT gmail.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Notes:
+ *
+ *   The ASTRE library (lib/libastre.a), which holds the detection engines:
+ *
+ *     astre_engine_noholes : trajectories without holes
+ *     astre_engine_holes   : trajectories with holes
+ *
+ *   Both engines are built from src/astre/astre.c, with ASTRE_HAS_NO_HOLES
+ *   and ASTRE_HAS_HOLES: each engine is a translation unit whose kernels are
+ *   specialised for its criterion, and which is only reached through its
+ *   astre_engine. The engine is picked at run time, for each dataset:
+ *
+ *     const astre_engine* e = astre_engine_find( "holes" );
+ *     astre_options o = astre_options_default();
+ *     o.h = 2 ;
+ *     if( astre( e, rd_in, rd_out, (Rawdata)NULL, o ) != 0 )
+ *       ... the parameters or the points cannot be used
+ *
+ *   The errors of the parameters and of the restart trajectories are logged
+ *   on the standard error and reported by the return values: the library
+ *   leaves the exit, and the display of the parameters, to its caller (see
+ *   astre-main.c).
+ *
+ *   The library is reentrant: the state of a detection is held in an
+ *   astre_ctx, so that several sequences may be processed at the same time,
+ *   in different threads of the same process:
+ *
+ *     astre_tables t = astre_tables_new( K, L );
+ *     astre_ctx ctx = astre_ctx_new( e, pd, &o, t );
+ *     if( ctx && astre_run( ctx, (points_desc)NULL ) == 0 )
+ *       tf = astre_extract( ctx );
+ *     astre_ctx_free_all( &ctx );
+ *     ...
+ *     astre_tables_free_all( &t );
+ *
+ *   The combinatorial coefficients of the log(NFA) (see astre_tables) only
+ *   depend on the number of frames and on the maximal trajectory length, and
+ *   may be shared by all the contexts, which only read them.
+ *
+ *   The loading of the points, the resolution of the parameters, the
+ *   precomputed values that do not depend on the engine and the saving of
+ *   the trajectories are shared by the engines (src/astre/astre-lib.c).
+ *
+ ******************************************************************/
+
+#include <vision/core.h>
+#include <vision/trajs/pointsdesc.h>
+#include <vision/trajs/trajs.h>
+#include <signal.h>
+
+/* Optional parameters defined by each algorithm */
+typedef struct st_astre_parameters {
+  // int param1 ;
+} astre_parameters ;
+
+/* Instruction sets of the kernels computing G */
+#define G_SIMD_SCALAR    0
+#define G_SIMD_SSE41     1
+#define G_SIMD_AVX2      2
+#define G_SIMD_AVX512    3
+
+/* Parameters of a detection (see the options of astre) */
+typedef struct st_astre_options
+{
+  float e ;                     /* Maximal allowed value of log(NFA) */
+  int h ;                       /* Maximal allowed length of a hole (-1: any length) */
+  int l ;                       /* Maximal allowed length of a trajectory (0: any length) */
+  char sliding_window ;         /* compute the frames in a sliding window (requires l),
+                                   which may change the extracted trajectories */
+  int latency ;                 /* Maximal latency of the extraction (-1: 2*l-1) */
+  char streaming ;              /* the frames are read from a stream (see astre_stream) */
+  int threads ;                 /* Number of threads computing G (0: one per processor) */
+  char huge_pages ;             /* back the G arrays with transparent huge pages */
+  int incremental ;             /* Level of incremental computation of G (0, 1 or 2) */
+  char spatial_index ;          /* search the points z in rings using a spatial index */
+  double max_displacement ;     /* maximal displacement between two frames (0: any) */
+  int simd ;                    /* G_SIMD_* level of the kernels (-1: the best available) */
+  char past_conflicts ;         /* go on extracting after a broken candidate */
+  char quiet ;                  /* do not print the logs of the detection */
+  char* partial_fname ;         /* File where we save partial computations, or NULL */
+  char just_tag_trajectories ;  /* tag trajectories with their NFA and exit */
+  char auto_crop ;              /* crop each image to its bounding-box */
+  astre_parameters parameters ; /* optionnal parameters defined by each algorithm */
+} astre_options ;
+
+/* The default parameters of a detection */
+astre_options astre_options_default();
+
+/* Combinatorial coefficients of the log(NFA), which may be shared by the
+ * detections of sequences of at most K frames, and of trajectories of at most
+ * max_length points (see astre_options_resolve) */
+typedef struct st_astre_tables *astre_tables ;
+struct st_astre_tables
+{
+  int K ;                       /* maximal number of frames */
+  int max_length ;              /* maximal trajectory length */
+  double* log_k ;               /* k => log(k), k = 1..K */
+  double* log_cnk ;             /* band of log( comb(n,k) ), n = 0..max_length */
+  double* log_kfact ;           /* k => log(k!), k = 0..K */
+};
+
+astre_tables astre_tables_new( int K, int max_length );
+void astre_tables_free_all( astre_tables* pt );
+
+/* Detection of the trajectories of a sequence. The points and the tables are
+ * not owned by the context, and must outlive it. */
+typedef struct st_astre_ctx *astre_ctx ;
+typedef struct st_astre_engine astre_engine ;
+struct st_astre_ctx
+{
+  const astre_engine* engine ;
+  astre_options o ;             /* resolved parameters */
+  points_desc pd ;              /* points of the sequence */
+  astre_tables tables ;         /* combinatorial coefficients */
+  char owns_tables ;            /* were the tables computed for this context? */
+  double* image_area ;          /* k => area of image k, k = 0..K-1 */
+  double* log_image_area ;      /* k => log( image_area[k] ) */
+  trajs_file tf ;               /* trajectories found, see astre_extract */
+  void* state ;                 /* state of the engine */
+};
+
+/* Detection engine, whose state is created with each context.
+ *
+ *   detect        : detect the trajectories of ctx->pd, restarting from the
+ *                   trajectories of restart if it is not NULL, and move
+ *                   them to ctx->tf
+ *   detect_stream : detect the trajectories of a stream, written to out as
+ *                   soon as they are extracted
+ *
+ * Both return -1 if the threads of the detection cannot be created. */
+struct st_astre_engine
+{
+  const char* name ;
+  char has_holes ;
+  void* (*state_new)();
+  void (*state_free)( void* state );
+  int (*detect)( astre_ctx ctx, points_desc restart );
+  int (*detect_stream)( astre_ctx ctx, points_desc_stream stream, FILE* out );
+};
+
+extern const astre_engine astre_engine_noholes ;
+extern const astre_engine astre_engine_holes ;
+
+/* Engine called name ("noholes" or "holes"), or NULL */
+const astre_engine* astre_engine_find( const char* name );
+
+/* Check the parameters for a sequence of n_frames frames, and replace their
+ * automatic values (any length, one thread per processor...). Return -1 if
+ * they cannot be used for this sequence. */
+int astre_options_resolve( const astre_engine* e, astre_options* o, int n_frames );
+
+/* New context detecting the trajectories of pd with the parameters o, which
+ * are resolved for pd. The tables t are used if they are not NULL (they must
+ * then be large enough), and computed for the context otherwise. Return NULL
+ * if the parameters cannot be resolved or the tables are too small. */
+astre_ctx astre_ctx_new( const astre_engine* e, points_desc pd,
+                         const astre_options* o, astre_tables t );
+
+/* Same for a stream, whose frames are detected with a sliding window */
+astre_ctx astre_ctx_new_stream( const astre_engine* e, points_desc_stream stream,
+                                const astre_options* o, astre_tables t );
+
+void astre_ctx_free_all( astre_ctx* pctx );
+
+/* Detect the trajectories of the context, resuming from the trajectories of
+ * the partial Pointsdesc restart if it is not NULL. Return -1 if restart (or
+ * the points to tag) does not match the points of the context, or if the
+ * threads of the detection cannot be created. */
+int astre_run( astre_ctx ctx, points_desc restart );
+
+/* Detect the trajectories of the stream of the context (see
+ * astre_ctx_new_stream), written to out as soon as they are extracted.
+ * Return -1 if the context was not created for this stream, if its threads
+ * cannot be created, or if the stream is malformed (the trajectories
+ * extracted before have then been written). */
+int astre_run_stream( astre_ctx ctx, points_desc_stream stream, FILE* out );
+
+/* Move the trajectories found by astre_run to a new trajs_file, whose
+ * trajectories hold their log(NFA) as a string in their data */
+trajs_file astre_extract( astre_ctx ctx );
+
+/* Detect the trajectories of i_pd, resuming from the partial Pointsdesc r_pd
+ * if it is not NULL, and save to o_pd the points with an additional column
+ * for the found trajectories. Return -1 if the detection failed. */
+int astre( const astre_engine* e, Rawdata i_pd, Rawdata o_pd, Rawdata r_pd,
+           astre_options o );
+
+/* Same for the points file i_fname, which is mapped in memory if it is a
+ * binary PointsFile (see points_desc_load_file) */
+int astre_file( const astre_engine* e, char* i_fname, Rawdata o_pd, Rawdata r_pd,
+                astre_options o );
+
+/* Detect the trajectories of a stream of points having at most n_frames
+ * frames, with a sliding window: the trajectories are written to out as soon
+ * as they are extracted (see astre_stream_write_traj), and may differ from
+ * those extracted from the whole sequence by astre(), at any latency. Return
+ * -1 if the detection failed or the stream is malformed. */
+int astre_stream( const astre_engine* e, FILE* in, FILE* out, int n_frames,
+                  astre_options o );
+
+/* Detect the trajectories of the n sequences inputs[i], and save them to
+ * outputs[i] as soon as they are found. The sequences are detected n_jobs at
+ * a time (0: one per processor), each one with o.threads threads, and the
+ * sequences having the same number of frames share their tables. A line is
+ * printed for each sequence, whose logs are printed unless o.quiet is set.
+ * Return the number of sequences that could not be loaded, detected or
+ * saved. */
+int astre_batch( const astre_engine* e, int n, char** inputs, char** outputs,
+                 astre_options o, int n_jobs );
+
+/* Detection server, see the protocol in src/astre/astre-server.c */
+typedef struct st_astre_server_options
+{
+  const astre_engine* e ;       /* default engine of the jobs */
+  astre_options o ;             /* default parameters of the jobs */
+  int workers ;                 /* number of jobs detected at the same time */
+  int max_queue ;               /* maximal number of jobs waiting for a worker */
+  long max_size ;               /* maximal size of the points of a job in bytes (0: none) */
+  double timeout ;              /* maximal duration of a job in seconds (0: none) */
+  char verbose ;                /* show the logs of the detections */
+} astre_server_options ;
+
+/* Serve the jobs sent to the Unix socket socket_path until *stop is set (by a
+ * signal handler), then wait for the queued jobs. Return -1 if the socket or
+ * the worker threads cannot be created. */
+int astre_serve( const char* socket_path, const astre_server_options* so,
+                 volatile sig_atomic_t* stop );
+
+/* Parameters of a job sent by astre_submit, the other ones being those of
+ * the server */
+#define ASTRE_SUBMIT_EPSILON            1       /* o->e */
+#define ASTRE_SUBMIT_MAX_HOLE_LENGTH    2       /* o->h */
+#define ASTRE_SUBMIT_MAX_LENGTH         4       /* o->l */
+#define ASTRE_SUBMIT_AUTO_CROP          8       /* o->auto_crop */
+
+/* Send the points in to the server of socket_path, detected with the engine
+ * e (or the engine of the server if NULL) and with the parameters of o given
+ * by the ASTRE_SUBMIT_* flags of keys. The tagged points are stored in out,
+ * and the log(NFA) of the trajectories written to lnfa_out if it is not
+ * NULL. Return -1 if the job failed. */
+int astre_submit( const char* socket_path, const astre_engine* e, const astre_options* o,
+                  int keys, Rawdata in, Rawdata out, FILE* lnfa_out );
+
+/* Save the points of pd to raw_out, with an additional column for the
+ * trajectories of tf and a header with the log(NFA) of each trajectory */
+void astre_points_desc_save_with_trajs( Rawdata raw_out, points_desc pd, trajs_file tf );
+
+/* Write the trajectory tt of index t to a stream, as a comment line
+ * "# traj:<t>:lNFA = <lNFA>" followed by the data lines of its points */
+void astre_stream_write_traj( FILE* out, points_desc pd, const traj* tt, int t );
+
+#endif
@@ -77,11 +77,76 @@ void desc_file_free_all( desc_file* pdf );
 
         desc_file_load
 
-        Create a desc_file structure from [raw_in]
+        Create a desc_file structure from [raw_in], or return NULL if it is
+        malformed
 
 ******************************************************************************/
 desc_file desc_file_load( Rawdata raw_in );
 
+/******************************************************************************
+
+        desc_file_stream
+
+        Read a desc_file line by line from a FILE* (a pipe, a FIFO...): the
+        headers are read when opening the stream, then each data line is
+        parsed on demand into df->lines[0]
+
+******************************************************************************/
+typedef struct st_desc_file_stream *desc_file_stream ;
+struct st_desc_file_stream
+{
+  FILE* in ;
+  desc_file df ;          /* headers, tags and the current line */
+
+  char* buf ;
+  int buf_size ;
+  int dsize ;
+
+  char error ;            /* TRUE once a malformed line was read */
+};
+
+/******************************************************************************
+
+        desc_file_stream_open
+
+        Read the headers of a desc_file from [in], up to the DATA line, or
+        return NULL if they are malformed
+
+******************************************************************************/
+desc_file_stream desc_file_stream_open( FILE* in );
+
+/******************************************************************************
+
+        desc_file_stream_read_raw_line
+
+        Read the next line of [s] that is neither empty nor a comment, and
+        return it without its surrounding whitespaces, or NULL at the end of
+        the stream. The line is only valid until the next read
+
+******************************************************************************/
+char* desc_file_stream_read_raw_line( desc_file_stream s );
+
+/******************************************************************************
+
+        desc_file_stream_read_line
+
+        Read the next data line of [s] and return its fields, or NULL at the
+        end of the stream or if the line is malformed (s->error is then set,
+        and the stream is not read any further). The fields are only valid
+        until the next read
+
+******************************************************************************/
+double* desc_file_stream_read_line( desc_file_stream s );
+
+/******************************************************************************
+
+        desc_file_stream_free_all
+
+        Free a desc_file_stream structure, without closing its file
+
+******************************************************************************/
+void desc_file_stream_free_all( desc_file_stream* ps );
+
 /******************************************************************************
 
         desc_file_save
@@ -1,6 +1,8 @@
 #ifndef _VISION_MATH_COMBINATORICS_H
 #define _VISION_MATH_COMBINATORICS_H
 
+#include <stddef.h>
+
 /*
     ASTRE a-contrario single trajectory extraction
     Copyright (C) 2011 Mael Primet (mael.primet AT gmail.com)
@@ -65,6 +67,41 @@ void combinatorics_log_CNk_fill_store( double* store, int N );
 double* combinatorics_log_Cnk_init( int N );
 void combinatorics_log_Cnk_fill_store( double* store, int N );
 
+/*******************************************************************************
+
+        Compute log C(n,k), n = 0 .. N
+                            k = 0 .. n
+
+        only the band k <= n is stored, use combinatorics_log_Cnk_band to
+        read it, which falls back to combinatorics_log_Cnk_lgamma for n > N
+
+        RETURNS:
+          store[n*(n+1)/2+k] = log C(n,k)
+
+*******************************************************************************/
+double* combinatorics_log_Cnk_band_init( int N );
+void combinatorics_log_Cnk_band_fill_store( double* store, int N );
+
+/*******************************************************************************
+
+        Compute log C(n,k) from the log-gamma function, without any store
+
+        RETURNS:
+          log C(n,k) (0 <= k <= n)
+          -1.0 otherwise
+
+*******************************************************************************/
+double combinatorics_log_Cnk_lgamma( int n, int k );
+
+/* log C(n,k) read in a band store of log C(n,k), n = 0 .. N */
+static inline double
+combinatorics_log_Cnk_band( const double* store, int N, int n, int k )
+{
+  if( k < 0 || k > n ) return -1.0 ;
+  if( n > N ) return combinatorics_log_Cnk_lgamma( n, k );
+  return store[ (size_t)n*(n+1)/2 + k ] ;
+}
+
 /*******************************************************************************
 
         Compute log C(n,k), n = 0 .. N
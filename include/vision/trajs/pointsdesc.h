@@ -34,6 +34,27 @@
  *
  *     frame:<integer frame> x:<x coord> y:<y coord> ...
  *
+ *   The binary PointsFile v.2 holds the same points, and is mapped in memory
+ *   by points_desc_load_file without being parsed nor copied. Its integers
+ *   and its values are little-endian, and its offsets are from the start of
+ *   the file:
+ *
+ *     0   magic "\177PFv2\r\n\032"
+ *     8   u32 size of this header (64)
+ *     12  u32 n_fields (without the frame number)
+ *     16  i32 width, i32 height, i32 uid, i32 orig_first_frame
+ *     32  u32 n_frames
+ *     36  u32 n_headers
+ *     40  u64 offset of the index
+ *     48  u64 offset of the points
+ *     56  u64 number of points
+ *     64  the headers, as NUL-terminated "caption", "content" pairs, then
+ *         the NUL-terminated tags of the fields ("" for no tag)
+ *
+ *   The index (8-byte aligned) holds the u64 number of points before each
+ *   frame, for the n_frames+1 frames, and the points (64-byte aligned) are
+ *   the double arrays pd->points[k] of the frames, one after the other.
+ *
  ******************************************************************/
 
 #include <vision/core.h>
@@ -60,6 +81,10 @@ struct st_points_desc
   /* points[f][p*n_fields + k] gives the value of field k for the point i in
    * image f (first two fields are x, y) */
   double** points ;
+
+  /* Mapping of a binary PointsFile holding the points, or NULL */
+  void* map ;
+  size_t map_size ;
 };
 
 points_desc points_desc_new();
@@ -68,14 +93,55 @@ void points_desc_free_all( points_desc* ppd );
 /* Set a random uid */
 void points_desc_set_uid( points_desc pd );
 
-/* Load and optionally add an additional column */
+/* Load and optionally add an additional column, return NULL if the data is
+ * malformed */
 points_desc points_desc_load_ext( Rawdata raw_in, int n_additional_fields );
 
-/* Load a pointsdesc file from a Rawdata structure */
+/* Load a pointsdesc file from a Rawdata structure, in text or binary format
+ * (the points of a binary file are copied). Return NULL if it is malformed. */
 points_desc points_desc_load( Rawdata raw_in );
 
+/* Load the pointsdesc file fname: a binary file is mapped in memory, and its
+ * points are not copied, a text file is loaded with points_desc_load. Return
+ * NULL if the file cannot be read or is malformed. */
+points_desc points_desc_load_file( char* fname );
+
+/* Stream of points read frame by frame, for instance from a pipe: the
+ * frames must be in increasing order, and a frame is complete once a line of
+ * a next frame (or the end of the stream) is read. The stream has at most
+ * n_frames frames, pd->points[k] being loaded by the k-th call to
+ * points_desc_stream_read_frame (frames without points are empty). The
+ * caller may free the points of a frame once they are no longer needed */
+typedef struct st_points_desc_stream *points_desc_stream ;
+struct st_points_desc_stream
+{
+  desc_file_stream dfs ;
+  points_desc pd ;
+  int n_read_frames ;
+
+  char has_pending ;      /* FALSE once the last frame has been read */
+  double* pending ;       /* first line of the next frame */
+  char error ;            /* TRUE once a malformed line was read */
+};
+
+/* Open the stream, or return NULL if its headers or first line are malformed */
+points_desc_stream points_desc_stream_open( FILE* in, int n_frames );
+/* Read the next frame, returns FALSE at the end of the stream or if it is
+ * malformed (s->error is then set) */
+char points_desc_stream_read_frame( points_desc_stream s );
+void points_desc_stream_free_all( points_desc_stream* ps );
+
+/* Write the headers of pd and the DATA line */
+void points_desc_write_headers( FILE* out, points_desc pd );
+
+/* Write the data line of the point p of frame k, followed by the field tag:v */
+void points_desc_write_point( FILE* out, points_desc pd, int k, int p, char* tag, double v );
+
 void points_desc_save( Rawdata raw_out, points_desc pd );
 
+/* Save pd to raw_out as a binary PointsFile v.2 */
+void points_desc_save_binary( Rawdata raw_out, points_desc pd );
+
 points_desc points_desc_copy( points_desc pd, int n_new_fields );
 
 /* Set a field value for all points */
@@ -82,7 +82,7 @@ TODO:
 
 *******************************************************************************/
 
-static traj*
+static inline traj*
 read_trajectory_descriptor( char* str )
 {
 /*{{{*/
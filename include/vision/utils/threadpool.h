@@ -0,0 +1,90 @@
+#ifndef _VISION_UTILS_THREADPOOL_H
+#define _VISION_UTILS_THREADPOOL_H
+
+/*
+    ASTRE a-contrario single trajectory extraction
+    Copyright (C) 2011 Mael Primet (mael.primet AT gmail.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Notes:
+ *
+ *   A fixed-size pool of worker threads used to run "parallel for" loops.
+ *
+ *   thread_pool tp = thread_pool_new( n_threads );
+ *
+ *   void job( void* data, int i, int thread ) { ... }
+ *   thread_pool_run( tp, n_jobs, &job, data );
+ *
+ *   thread_pool_free_all( &tp );
+ *
+ *   thread_pool_run calls job( data, i, thread ) exactly once for each
+ *   i = 0 .. n_jobs-1, and returns once all the jobs are done. Jobs are
+ *   handed out dynamically (in increasing order of i) to the calling thread
+ *   and to the n_threads-1 workers, and thread is the index (0 ..
+ *   n_threads-1) of the thread running the job, thread 0 being the caller.
+ *
+ *   A pool of 1 thread does not create any worker and simply runs the jobs
+ *   in order in the calling thread. thread_pool_new returns NULL if a worker
+ *   cannot be created.
+ *
+ *   thread_pool_new_with_init( n_threads, &init, arg ) calls init( arg,
+ *   thread ) in each worker when it starts, before it runs any job (eg. to
+ *   set thread-local variables shared with the calling thread).
+ *
+ ******************************************************************/
+
+#include <vision/core.h>
+#include <pthread.h>
+
+typedef void (*thread_pool_job)( void* data, int i, int thread );
+typedef void (*thread_pool_init)( void* arg, int thread );
+
+typedef struct st_thread_pool *thread_pool ;
+struct st_thread_pool
+{
+  int n_threads ;
+  pthread_t* workers ;
+
+  pthread_mutex_t lock ;
+  pthread_cond_t start ;                      /* a new generation is available */
+  pthread_cond_t done ;                       /* all workers are idle */
+
+  /* Current parallel loop */
+  thread_pool_job job ;
+  void* data ;
+  int n_jobs ;
+  volatile int next_job ;
+  int generation ;
+  int n_busy ;
+  char shutdown ;
+
+  /* Initialization of the workers */
+  thread_pool_init init ;
+  void* init_arg ;
+};
+
+thread_pool thread_pool_new( int n_threads );
+thread_pool thread_pool_new_with_init( int n_threads, thread_pool_init init, void* arg );
+void thread_pool_free_all( thread_pool* ptp );
+
+/* Run job(data, i, thread) for i = 0 .. n_jobs-1 and wait for completion */
+void thread_pool_run( thread_pool tp, int n_jobs, thread_pool_job job, void* data );
+
+/* Number of online processors (at least 1) */
+int thread_pool_n_cpus();
+
+#endif
@@ -17,12 +17,12 @@
 */
 
 #include <vision/core.h>
-#include <vision/utils/argparser.h>
 #include <vision/trajs/pointsdesc.h>
 #include <vision/trajs/trajs.h>
 #include <cbase/util.h>
 
-#define P printf
+/* The logs of the detection, unless it is quiet */
+#define P(...) ( S->QUIET ? 0 : printf( __VA_ARGS__ ) )
 
 /*******************************************************************************
 
@@ -48,18 +48,18 @@ discrete_area_init( int max_r )
     exit(-1);
   }
 
-  if( discrete_area_data )
+  if( S->discrete_area_data )
   {
     discrete_area_free();
   }
 
-  discrete_area_max_r = max_r ;
-  discrete_area_max_r_sq = max_r*max_r ;
-  discrete_area_width = max_r+1 ;
-  discrete_area_data = (double*)calloc_or_die( (max_r+1)*(max_r+1), sizeof(double) );
+  S->discrete_area_max_r = max_r ;
+  S->discrete_area_max_r_sq = max_r*max_r ;
+  S->discrete_area_width = max_r+1 ;
+  S->discrete_area_data = (double*)calloc_or_die( (max_r+1)*(max_r+1), sizeof(double) );
 
   for( int i = 0 ; i < (max_r+1)*(max_r+1) ; i++ )
-    discrete_area_data[i] = -1.0 ;
+    S->discrete_area_data[i] = -1.0 ;
 
   /* Total number of pixel in the first octant */
   int total_num_pix = (max_r+1)*(max_r+2)/2 ;
@@ -124,8 +124,8 @@ discrete_area_init( int max_r )
       int px = pp->x, py = pp->y ;
 
       /* Discrete_area_data is the first quadrant, so we fill it by symmetry */
-      discrete_area_data[py*discrete_area_width + px] = (double)cur_area ;
-      discrete_area_data[px*discrete_area_width + py] = (double)cur_area ;
+      S->discrete_area_data[py*S->discrete_area_width + px] = (double)cur_area ;
+      S->discrete_area_data[px*S->discrete_area_width + py] = (double)cur_area ;
     }
 
     fst_pix_layer = lst_pix_layer + 1 ;
@@ -143,10 +143,10 @@ discrete_area_init( int max_r )
 static void
 discrete_area_free()
 {
-  discrete_area_max_r = -1 ;
-  discrete_area_max_r_sq = -1 ;
-  discrete_area_width = -1 ;
-  free( discrete_area_data ); discrete_area_data = (double*)NULL ;
+  S->discrete_area_max_r = -1 ;
+  S->discrete_area_max_r_sq = -1 ;
+  S->discrete_area_width = -1 ;
+  free( S->discrete_area_data ); S->discrete_area_data = (double*)NULL ;
 }
 
 /*******************************************************************************
@@ -167,434 +167,1143 @@ static double
 discrete_area( int x, int y )
 {
   int d_sq = x*x + y*y ;
-  if( d_sq > discrete_area_max_r_sq ) return M_PI*(double)d_sq ;
+  if( d_sq > S->discrete_area_max_r_sq ) return M_PI*(double)d_sq ;
   else
   {
     if( x < 0 ) x = -x ;
     if( y < 0 ) y = -y ;
-    return discrete_area_data[y*discrete_area_width+x] ;
+    return S->discrete_area_data[y*S->discrete_area_width+x] ;
   }
 }
 /*}}}*/
 
 /*******************************************************************************
 
-        Find the NFA of the most significant trajectory.
+        Criterion codes, see the description in astre-common-defs.h
 
 *******************************************************************************/
+/*{{{*/
+/* Code of the criterion of the acceleration (x,y) between the frames q .. */
+static inline uint32_t
+criterion_code( int x, int y, int q )
+{
+  if( S->G_CODES_ARE_AREAS )
+  {
+    uint32_t code ;
+    int d_sq = x*x + y*y ;
+    if( d_sq > S->discrete_area_max_r_sq )
+      code = S->G_AREA_CODE_NEAR_MAX + (uint32_t)(d_sq - S->discrete_area_max_r_sq) ;
+    else
+    {
+      if( x < 0 ) x = -x ;
+      if( y < 0 ) y = -y ;
+      code = (uint32_t)S->discrete_area_data[y*S->discrete_area_width+x] ;
+    }
+    return code < S->G_CODE_MAX ? code : S->G_CODE_MAX ;
+  }
+  else
+  {
+    float criterion = discrete_area( x, y );
+    criterion = criterion / S->IMAGE_AREA[q] ;
+    uint32_t code ;
+    memcpy( &code, &criterion, sizeof(float) );
+    return code ;
+  }
+}
 
-double
-find_minimal_NFA()
+/* Discrete area of an area code */
+static inline double
+g_area_code_to_area( uint32_t code )
 {
-/*{{{*/
-  float min_log_NFA = INFTY ;
+  if( code <= S->G_AREA_CODE_NEAR_MAX ) return (double)code ;
+  return M_PI*(double)(code - S->G_AREA_CODE_NEAR_MAX + S->discrete_area_max_r_sq) ;
+}
 
-  FORALL_k
+/* Criterion (delta) of a code, as it would have been computed in floating
+ * point by criterion__define */
+static inline float
+g_code_to_delta( uint32_t code )
+{
+  if( code == G_CODE_INFTY ) return INFTY ;
+  if( S->G_CODES_ARE_AREAS )
+  {
+    if( S->g_code_delta ) return S->g_code_delta[code] ;
+    float area = g_area_code_to_area( code );
+    return area / S->IMAGE_AREA[0] ;
+  }
+  else
+  {
+    float delta ;
+    memcpy( &delta, &code, sizeof(float) );
+    return delta ;
+  }
+}
 
+/* Choose the codes of the criterion and of the argmins. Must be called after
+ * discrete_area_init and precompute_image_areas, and before g_store_init. */
+static void
+g_codes_init()
+{
 #ifdef ASTRE_HAS_NO_HOLES
-    FORALL_x ; FORALL_y ; FORALL_l
-    const float delta = *g_l_cur ;
+  const int max_h = 0 ;
 #endif
 #ifdef ASTRE_HAS_HOLES
-    FORALL_x ; FORALL_h ; FORALL_y
-    FORALL_l ; FORALL_s ; FORALL_j
-    const float delta = *g_j_cur ;
+  const int max_h = max_i( 0, min_i( S->K-2, S->MAX_ALLOWED_HOLE_LENGTH ) );
 #endif
 
-      if( delta >= INFTY-1 ) continue ; /* No trajectory */
+  S->G_CODE_BITS = 32 ;
+  S->G_CODES_ARE_AREAS = FALSE ;
+  S->G_CODE_MAX = G_CODE_INFTY-1 ;
+  S->G_AREA_CODE_NEAR_MAX = 0 ;
+  S->g_code_delta = (float*)NULL ;
+
+  /* The areas are only comparable if all the images have the same area */
+  for( int k = 1 ; k < S->K ; k++ )
+    if( S->IMAGE_AREA[k] != S->IMAGE_AREA[0] ) return ;
+
+  /* The discrete areas must be smaller than the euclidian ones */
+  double near_max = 0.0 ;
+  for( int i = 0 ; i < S->discrete_area_width*S->discrete_area_width ; i++ )
+    near_max = max_d( near_max, S->discrete_area_data[i] );
+  if( near_max >= M_PI*(double)(S->discrete_area_max_r_sq+1) ) return ;
+
+  S->G_CODES_ARE_AREAS = TRUE ;
+  S->G_AREA_CODE_NEAR_MAX = (uint32_t)near_max ;
+
+  /* 16 bits codes, saturated to the first area covering the image, if such
+   * an acceleration is never meaningful, and if the largest argmin code
+   * G_BP_CODE(max_h,N-1) fits as well */
+  if( S->MAX_ALLOWED_LOG_NFA + LOG_NFA_COMP_EPS >= S->LOG_K ) return ;
+  if( (int64_t)(max_h+1)*S->N > 0xFFFF ) return ;
+
+  uint32_t sat = 0 ;
+  while( sat < 0xFFFF && g_area_code_to_area( sat ) < S->IMAGE_AREA[0] ) sat++ ;
+  if( sat >= 0xFFFF ) return ;
+
+  S->G_CODE_BITS = 16 ;
+  S->G_CODE_MAX = sat ;
+  S->g_code_delta = (float*)calloc_or_die( sat+1, sizeof(float) );
+  for( uint32_t code = 0 ; code <= sat ; code++ )
+  {
+    float area = g_area_code_to_area( code );
+    S->g_code_delta[code] = area / S->IMAGE_AREA[0] ;
+  }
+}
+
+static void
+g_codes_free()
+{
+  free( S->g_code_delta ); S->g_code_delta = (float*)NULL ;
+}
+
+/* Lower bound of the codes of the accelerations (x,y) between the frames
+ * q .. having max(|x|,|y|) >= m. The discrete areas increase with the radius,
+ * as the euclidian ones, but they might be larger than the first euclidian
+ * area, of radius^2 = discrete_area_max_r_sq+1. */
+static inline uint32_t
+criterion_code_lower_bound( int m, int q )
+{
+  const uint32_t code = criterion_code( m, 0, q );
+  if( m > S->discrete_area_max_r ) return code ;
+  const uint32_t code_euclidian = criterion_code( S->discrete_area_max_r, 1, q );
+  return code < code_euclidian ? code : code_euclidian ;
+}
+/*}}}*/
+
+/*******************************************************************************
+
+        Spatial index of the points, see the description in
+        astre-common-defs.h
+
+*******************************************************************************/
+/*{{{*/
+static void
+points_grid_free_frame( int k )
+{
+  free( S->points_grid_f[k].cell_start ); S->points_grid_f[k].cell_start = (int*)NULL ;
+  free( S->points_grid_f[k].idx ); S->points_grid_f[k].idx = (int*)NULL ;
+  free( S->points_grid_f[k].xy ); S->points_grid_f[k].xy = (float*)NULL ;
+}
+
+static void
+points_grid_init_frame( int k )
+{
+/*{{{*/
+  points_grid_free_frame( k );
+
+  points_grid* grid = &(S->points_grid_f[k]) ;
+  const int n = S->n_points_in_frame[k] ;
+  const float* pts_X = S->points_x_f[k] ;
+  const float* pts_Y = S->points_y_f[k] ;
+
+  double xmin = 0.0, ymin = 0.0, xmax = 0.0, ymax = 0.0 ;
+  for( int p = 0 ; p < n ; p++ )
+  {
+    double pX = pts_X[p] ;
+    double pY = pts_Y[p] ;
+    if( p == 0 )
+    {
+      xmin = xmax = pX ;
+      ymin = ymax = pY ;
+    }
+    else
+    {
+      xmin = min_d(xmin, pX);
+      xmax = max_d(xmax, pX);
+      ymin = min_d(ymin, pY);
+      ymax = max_d(ymax, pY);
+    }
+  }
+
+  /* Cells of about POINTS_GRID_POINTS_PER_CELL points, and at most 1024
+   * cells per side */
+  double area = max_d( 1.0, (xmax-xmin)*(ymax-ymin) );
+  double size = sqrt( area*POINTS_GRID_POINTS_PER_CELL/(double)max_i( n, 1 ) );
+  size = max_d( size, max_d( 1.0, max_d( xmax-xmin, ymax-ymin )/1024.0 ) );
+
+  grid->x0 = xmin ;
+  grid->y0 = ymin ;
+  grid->size = size ;
+  grid->nx = (int)((xmax-xmin)/size) + 1 ;
+  grid->ny = (int)((ymax-ymin)/size) + 1 ;
+
+  const int n_cells = grid->nx*grid->ny ;
+  int* cell_p = (int*)calloc_or_die( max_i( n, 1 ), sizeof(int) );
+  grid->cell_start = (int*)calloc_or_die( n_cells+1, sizeof(int) );
+  grid->idx = (int*)calloc_or_die( max_i( n, 1 ), sizeof(int) );
+  grid->xy = (float*)calloc_or_die( 2*max_i( n, 1 ), sizeof(float) );
+
+  /* Counting sort of the points by cell, keeping the order of the indices */
+  for( int p = 0 ; p < n ; p++ )
+  {
+    int cx = clamp_i( (int)((pts_X[p]-xmin)/size), 0, grid->nx-1 );
+    int cy = clamp_i( (int)((pts_Y[p]-ymin)/size), 0, grid->ny-1 );
+    cell_p[p] = cy*grid->nx + cx ;
+    grid->cell_start[cell_p[p]+1]++ ;
+  }
+  for( int c = 0 ; c < n_cells ; c++ )
+    grid->cell_start[c+1] += grid->cell_start[c] ;
+
+  int* cur = (int*)calloc_or_die( n_cells, sizeof(int) );
+  for( int p = 0 ; p < n ; p++ )
+  {
+    int i = grid->cell_start[cell_p[p]] + cur[cell_p[p]]++ ;
+    grid->idx[i] = p ;
+    grid->xy[2*i+0] = pts_X[p] ;
+    grid->xy[2*i+1] = pts_Y[p] ;
+  }
+
+  free( cur ); cur = (int*)NULL ;
+  free( cell_p ); cell_p = (int*)NULL ;
+/*}}}*/
+}
+
+static void
+points_grid_init_arrays()
+{
+  S->points_grid_f = (points_grid*)calloc_or_die( S->K, sizeof(points_grid) );
+}
+
+static void
+points_grid_init()
+{
+  points_grid_init_arrays();
+  for( int k = 0 ; k < S->K ; k++ )
+    points_grid_init_frame( k );
+}
+
+static void
+points_grid_free()
+{
+  if( !S->points_grid_f ) return ;
+  for( int k = 0 ; k < S->K ; k++ )
+    points_grid_free_frame( k );
+  free( S->points_grid_f ); S->points_grid_f = (points_grid*)NULL ;
+}
+
+/* Remove the inactive points from the grid of frame f */
+static void
+points_grid_compact( int f )
+{
+/*{{{*/
+  points_grid* grid = &(S->points_grid_f[f]) ;
+  const int n_cells = grid->nx*grid->ny ;
+  int n = 0 ;
+  int first = grid->cell_start[0] ;
+  for( int c = 0 ; c < n_cells ; c++ )
+  {
+    const int last = grid->cell_start[c+1] ;
+    grid->cell_start[c] = n ;
+    for( int i = first ; i < last ; i++ )
+    {
+      if( !S->activated_fp[f][grid->idx[i]] ) continue ;
+      grid->idx[n] = grid->idx[i] ;
+      grid->xy[2*n+0] = grid->xy[2*i+0] ;
+      grid->xy[2*n+1] = grid->xy[2*i+1] ;
+      n++ ;
+    }
+    first = last ;
+  }
+  grid->cell_start[n_cells] = n ;
+/*}}}*/
+}
+
+/* Cell (*cx,*cy) of the grid containing the point (pX,pY), or the closest one */
+static inline void
+points_grid_cell( const points_grid* grid, double pX, double pY, int* cx, int* cy )
+{
+  double fx = (pX - grid->x0)/grid->size ;
+  double fy = (pY - grid->y0)/grid->size ;
+  *cx = fx < 0.0 ? 0 : fx >= (double)grid->nx ? grid->nx-1 : (int)fx ;
+  *cy = fy < 0.0 ? 0 : fy >= (double)grid->ny ? grid->ny-1 : (int)fy ;
+}
+
+/* Lower bound of max(|X-pX|,|Y-pY|) for the points (X,Y) that are not in
+ * the rings 0 .. r around the cell (cx,cy), or -1 if there is none */
+static inline double
+points_grid_ring_distance( const points_grid* grid, double pX, double pY,
+                           int cx, int cy, int r )
+{
+/*{{{*/
+  double d = INFTY ;
+  char is_last_ring = TRUE ;
+  if( cx-r > 0 )
+  {
+    d = min_d( d, pX - (grid->x0 + (double)(cx-r)*grid->size) );
+    is_last_ring = FALSE ;
+  }
+  if( cx+r < grid->nx-1 )
+  {
+    d = min_d( d, grid->x0 + (double)(cx+r+1)*grid->size - pX );
+    is_last_ring = FALSE ;
+  }
+  if( cy-r > 0 )
+  {
+    d = min_d( d, pY - (grid->y0 + (double)(cy-r)*grid->size) );
+    is_last_ring = FALSE ;
+  }
+  if( cy+r < grid->ny-1 )
+  {
+    d = min_d( d, grid->y0 + (double)(cy+r+1)*grid->size - pY );
+    is_last_ring = FALSE ;
+  }
+  return is_last_ring ? -1.0 : max_d( d, 0.0 ) ;
+/*}}}*/
+}
+/*}}}*/
+
+/*******************************************************************************
 
+        Links between the points, see the description in astre-common-defs.h
+
+*******************************************************************************/
+/*{{{*/
+static int
+g_links_compare_y( const void* a, const void* b )
+{
+  return *(const int*)a - *(const int*)b ;
+}
+
+/* Store the points y of frame p at distance at most r of (pX,pY) in link_y
+ * (if not NULL), and return their number */
+static size_t
+g_links_find_neighbours( int p, double pX, double pY, double r, int* link_y )
+{
+/*{{{*/
+  const points_grid* grid = &(S->points_grid_f[p]) ;
+  int cx_min, cy_min, cx_max, cy_max ;
+  points_grid_cell( grid, pX-r, pY-r, &cx_min, &cy_min );
+  points_grid_cell( grid, pX+r, pY+r, &cx_max, &cy_max );
+
+  size_t n = 0 ;
+  for( int cy = cy_min ; cy <= cy_max ; cy++ )
+  for( int cx = cx_min ; cx <= cx_max ; cx++ )
+  {
+    const int cell = cy*grid->nx + cx ;
+    for( int i = grid->cell_start[cell] ; i < grid->cell_start[cell+1] ; i++ )
+    {
+      const double dX = (double)grid->xy[2*i+0] - pX ;
+      const double dY = (double)grid->xy[2*i+1] - pY ;
+      if( dX*dX + dY*dY > r*r ) continue ;
+      if( link_y ) link_y[n] = grid->idx[i] ;
+      n++ ;
+    }
+  }
+  return n ;
+/*}}}*/
+}
+
+/* Links of the points of frame k >= 1, once the points (and the grids) of
+ * the frames k-max_h-1 .. k are known */
+static void
+g_links_init_frame( int k )
+{
+/*{{{*/
 #ifdef ASTRE_HAS_NO_HOLES
-      FIND_MINIMAL_NFA__COMPUTE_NFA(k,x,y,l,delta);
+  const int __max_h = 0 ;
 #endif
 #ifdef ASTRE_HAS_HOLES
-      FIND_MINIMAL_NFA__COMPUTE_NFA(k,x,y,l,s,j,delta);
+  DEFINE_MAX_h(k);
 #endif
+  S->g_n_h_f[k] = __max_h+1 ;
+
+  const int n_x = S->n_points_in_frame[k] ;
+  const size_t n_xh = (size_t)n_x*S->g_n_h_f[k] ;
+  size_t* start = (size_t*)calloc_or_die( n_xh+1, sizeof(size_t) );
+  S->g_link_start_f[k] = start ;
 
-      if( lNFA < min_log_NFA )
+  /* Every point y is linked to every (x,h) */
+  if( S->MAX_DISPLACEMENT <= 0 )
+  {
+    for( int x = 0 ; x < n_x ; x++ )
+      for( int h = 0 ; h <= __max_h ; h++ )
+        start[G_XH(k,x,h)+1] = start[G_XH(k,x,h)] + (size_t)S->n_points_in_frame[k-h-1] ;
+    return ;
+  }
+
+  /* Count the links, then fill them and sort them by y */
+  for( int pass = 0 ; pass < 2 ; pass++ )
+  {
+    int* link_y = pass == 0 ? (int*)NULL : S->g_link_y_f[k] ;
+    for( int x = 0 ; x < n_x ; x++ )
+      for( int h = 0 ; h <= __max_h ; h++ )
       {
-        min_log_NFA = lNFA ;
+        const size_t xh = G_XH(k,x,h) ;
+        const size_t n = g_links_find_neighbours( k-h-1,
+            S->points_x_f[k][x], S->points_y_f[k][x],
+            (double)(h+1)*S->MAX_DISPLACEMENT, link_y ? link_y + start[xh] : (int*)NULL );
+        if( pass == 0 )
+          start[xh+1] = start[xh] + n ;
+        else
+          qsort( link_y + start[xh], n, sizeof(int), &g_links_compare_y );
       }
+    if( pass == 0 )
+      S->g_link_y_f[k] = (int*)calloc_or_die( start[n_xh]+1, sizeof(int) );
+  }
+/*}}}*/
+}
 
-#ifdef ASTRE_HAS_NO_HOLES
-    END_FORALL_l ; END_FORALL_y ; END_FORALL_x
-#endif
-#ifdef ASTRE_HAS_HOLES
-    END_FORALL_j ; END_FORALL_s ; END_FORALL_l
-    END_FORALL_y ; END_FORALL_h ; END_FORALL_x
-#endif
+static void
+g_links_free_frame( int k )
+{
+  free( S->g_link_start_f[k] ); S->g_link_start_f[k] = (size_t*)NULL ;
+  free( S->g_link_y_f[k] ); S->g_link_y_f[k] = (int*)NULL ;
+  S->g_n_h_f[k] = 0 ;
+}
 
-  END_FORALL_k
+static void
+g_links_init_arrays()
+{
+  S->g_n_h_f = (int*)calloc_or_die( S->K, sizeof(int) );
+  S->g_link_start_f = (size_t**)calloc_or_die( S->K, sizeof(size_t*) );
+  S->g_link_y_f = (int**)calloc_or_die( S->K, sizeof(int*) );
+}
 
-  return min_log_NFA ;
+static void
+g_links_init()
+{
+/*{{{*/
+  g_links_init_arrays();
+
+  DEFINE_MAX_k ;
+  for( int k = 1 ; k <= __max_k ; k++ )
+    g_links_init_frame( k );
 /*}}}*/
 }
 
+static void
+g_links_free()
+{
+  if( !S->g_link_start_f ) return ;
+  for( int k = 0 ; k < S->K ; k++ )
+    g_links_free_frame( k );
+  free( S->g_link_start_f ); S->g_link_start_f = (size_t**)NULL ;
+  free( S->g_link_y_f ); S->g_link_y_f = (int**)NULL ;
+  free( S->g_n_h_f ); S->g_n_h_f = (int*)NULL ;
+}
+/*}}}*/
+
 /*******************************************************************************
 
-        Extract a trajectory if it is unbroken (ie. all the points are
-        activated). Add the trajectory to the store if it is valid.
+        Candidate trajectories, see the description in astre-common-defs.h
 
-        Also, we don't consider every possible trajectory of the same type
-        ending in the same points, but we try to greedily detect one.
-        This means that we can conclude that the "greedily found" trajectory
-        is broken and return FALSE while there exist an unbroken trajectory.
-        If there really exist a trajectory, we will still find it at the next
-        computation / extraction iteration of the algorithm.
+*******************************************************************************/
+/*{{{*/
+static void
+g_candidates_init()
+{
+  memset( &S->g_cand_heap, 0, sizeof(g_candidates) );
+  memset( &S->g_cand_batch, 0, sizeof(g_candidates) );
+  S->g_cand_thread = (g_candidates*)calloc_or_die( S->N_THREADS, sizeof(g_candidates) );
+  for( int t = 0 ; t < S->N_THREADS ; t++ )
+    S->g_cand_thread[t].min_lNFA = HUGE_VAL ;
+  S->g_cand_heap_is_heap = TRUE ;
+  S->g_cand_min_lNFA = HUGE_VAL ;
+  S->g_batch_n = (int*)NULL ;
+  S->g_batch_frames = S->g_batch_points = (int*)NULL ;
+  S->g_batch_allocated = 0 ;
+}
 
-        PARAMETERS:
+static void
+g_candidates_free()
+{
+  free( S->g_cand_heap.data ); S->g_cand_heap.data = (g_candidate*)NULL ;
+  free( S->g_cand_batch.data ); S->g_cand_batch.data = (g_candidate*)NULL ;
+  for( int t = 0 ; t < S->N_THREADS ; t++ )
+    free( S->g_cand_thread[t].data );
+  free( S->g_cand_thread ); S->g_cand_thread = (g_candidates*)NULL ;
+  free( S->g_batch_n ); S->g_batch_n = (int*)NULL ;
+  free( S->g_batch_frames ); S->g_batch_frames = (int*)NULL ;
+  free( S->g_batch_points ); S->g_batch_points = (int*)NULL ;
+  S->g_batch_allocated = 0 ;
+}
 
-          k     = End frame
-          x     = Index of the point in the last frame
-          h     = Size of the first hole
-          y     = Index of the point in the previous frame
-          l     = Length (ie. span of the trajectory)
-          s     = Size (ie. number of present points)
-          j     = Number of runs of consecutive present points
-          info_logNFA = log(NFA) of trajectory, to add to the trajectory infos
+/* log(NFA) of a G value of the given code */
+#ifdef ASTRE_HAS_NO_HOLES
+static double
+g_code_log_NFA( int k, int l, uint32_t code )
+{
+  const float delta = g_code_to_delta( code );
+  CANDIDATE__COMPUTE_NFA(k,0,0,l,delta);
+  return lNFA ;
+}
+#endif
+#ifdef ASTRE_HAS_HOLES
+static double
+g_code_log_NFA( int k, int l, int s, int j, uint32_t code )
+{
+  const float delta = g_code_to_delta( code );
+  CANDIDATE__COMPUTE_NFA(k,0,0,l,s,j,delta);
+  return lNFA ;
+}
+#endif
 
-        RETURNS:
-          TRUE    if the trajectory was not broken
-          FALSE   otherwise
+/* Approximate code of a criterion delta (inverse of g_code_to_delta) */
+static uint32_t
+g_delta_to_code( double delta )
+{
+/*{{{*/
+  if( !(delta > 0.0) ) return 0 ;
+  if( S->G_CODES_ARE_AREAS )
+  {
+    double area = delta*S->IMAGE_AREA[0] ;
+    double code = area <= (double)S->G_AREA_CODE_NEAR_MAX ? area :
+      area/M_PI - (double)S->discrete_area_max_r_sq + (double)S->G_AREA_CODE_NEAR_MAX ;
+    return code >= (double)S->G_CODE_MAX ? S->G_CODE_MAX : (uint32_t)code ;
+  }
+  else
+  {
+    float f_delta = delta < INFTY ? (float)delta : INFTY ;
+    uint32_t code ;
+    memcpy( &code, &f_delta, sizeof(float) );
+    return code ;
+  }
+/*}}}*/
+}
 
-*******************************************************************************/
+#ifdef ASTRE_HAS_NO_HOLES
+  #define G_CODE_IS_ADMISSIBLE(code) ( g_code_log_NFA( k, l, (code) ) <= max_lNFA )
+#endif
+#ifdef ASTRE_HAS_HOLES
+  #define G_CODE_IS_ADMISSIBLE(code) ( g_code_log_NFA( k, l, s, j, (code) ) <= max_lNFA )
+#endif
 
+/* Maximal admissible code for (k,l[,s,j]), searched around the code of the
+ * maximal admissible delta 10^((max_lNFA - offset)/(s-2)) */
 #ifdef ASTRE_HAS_NO_HOLES
-char
-extract_trajectory_if_possible( int k, int x, int y, int l, double logNFA )
+static uint32_t
+g_max_admissible_code( int k, int l, double max_lNFA )
+{
+  const int s = l ;
 #endif
 #ifdef ASTRE_HAS_HOLES
-char
-extract_trajectory_if_possible( int k,
-                                int x, int h, int y,
-                                int l, int s, int j,
-                                double logNFA )
+static uint32_t
+g_max_admissible_code( int k, int l, int s, int j, double max_lNFA )
+{
 #endif
+/*{{{*/
+  /* Offset of the log(NFA), ie. all the terms but (s-2).log10(delta),
+   * which is (about) the log(NFA) of delta = 1 */
+#ifdef ASTRE_HAS_NO_HOLES
+  const double offset = g_code_log_NFA( k, l, g_delta_to_code( 1.0 ) );
+#endif
+#ifdef ASTRE_HAS_HOLES
+  const double offset = g_code_log_NFA( k, l, s, j, g_delta_to_code( 1.0 ) );
+#endif
+  const uint32_t guess = g_delta_to_code( pow( 10.0, (max_lNFA - offset)/(double)(s-2) ) );
+
+  /* Invariant: lo is admissible, hi is not (or is G_CODE_MAX+1) */
+  uint64_t lo, hi ;
+  if( G_CODE_IS_ADMISSIBLE(guess) )
+  {
+    lo = guess ;
+    for( uint64_t step = 1 ; ; step *= 2 )
+    {
+      if( lo >= S->G_CODE_MAX ) return S->G_CODE_MAX ;
+      hi = lo+step < S->G_CODE_MAX ? lo+step : S->G_CODE_MAX ;
+      if( !G_CODE_IS_ADMISSIBLE((uint32_t)hi) ) break ;
+      lo = hi ;
+    }
+  }
+  else
+  {
+    hi = guess ;
+    for( uint64_t step = 1 ; ; step *= 2 )
+    {
+      lo = hi > step ? hi-step : 0 ;
+      if( G_CODE_IS_ADMISSIBLE((uint32_t)lo) ) break ;
+      if( lo == 0 ) return 0 ; /* the exact log(NFA) is checked anyway */
+      hi = lo ;
+    }
+  }
+
+  while( hi-lo > 1 )
+  {
+    uint64_t mid = lo + (hi-lo)/2 ;
+    if( G_CODE_IS_ADMISSIBLE((uint32_t)mid) ) lo = mid ; else hi = mid ;
+  }
+  return (uint32_t)lo ;
+/*}}}*/
+}
+
+/* Precompute g_max_code_f[k] for a frame k >= 1, must be called after
+ * g_codes_init, g_store_init and the LOG_Nprod values of frame k */
+static void
+g_max_codes_init_frame( int k )
 {
 /*{{{*/
-  /* We allocate K points to be safe */
-  int* types = (int*)calloc_or_die( K, sizeof(int) );
-  ref_point* point_refs = (ref_point*)calloc_or_die( K, sizeof(ref_point) );
-  /* Index in the arrays */
-  int cur_idx = 0 ;
-  /* Last frame of the trajectory, we use it to compute the trajectory length */
-  int last_frame = k ;
-#if ASTRE_HAS_NO_HOLES
-  /* So we can use the same code for both ASTRE_HAS_NO_HOLES and ASTRE_HAS_HOLES */
-  const int h = 0 ;
+  const double max_lNFA = S->MAX_ALLOWED_LOG_NFA + LOG_NFA_COMP_EPS ;
+  free( S->g_max_code_f[k] ); S->g_max_code_f[k] = (uint32_t*)NULL ;
+
+#ifdef ASTRE_HAS_NO_HOLES
+  DEFINE_BOUNDS_l(k);
+  if( __size_l0 <= 0 ) return ;
+  S->g_max_code_f[k] = (uint32_t*)calloc_or_die( __size_l0, sizeof(uint32_t) );
+  for( int l0 = 0, l = __min_l ; l0 < __size_l0 ; l0++, l++ )
+    S->g_max_code_f[k][l0] = g_max_admissible_code( k, l, max_lNFA );
 #endif
-  /* Is the trajectory broken ? */
-  char trajectory_is_broken = FALSE ;
-  /* Find the value of the criterion on the trajectory */
-  float global_criterion = -1 ;
+#ifdef ASTRE_HAS_HOLES
+  DEFINE_BOUNDS_l(k,0);
+  if( __size_l0 <= 0 ) return ;
+  const size_t* g_ls_offset = S->g_lsj_offset_h[0] ;
+  S->g_max_code_f[k] = (uint32_t*)calloc_or_die( g_ls_offset[G_LS_IDX(__size_l0,0)], sizeof(uint32_t) );
+  for( int l0 = 0, l = __min_l ; l0 < __size_l0 ; l0++, l++ )
   {
+    DEFINE_BOUNDS_s( k, 0, l );
+    for( int s0 = 0, s = __min_s ; s0 < __size_s0 ; s0++, s++ )
+    {
+      DEFINE_BOUNDS_j( k, 0, l, s );
+      uint32_t* max_code = S->g_max_code_f[k] + g_ls_offset[G_LS_IDX(l0,s0)] ;
+      for( int j0 = 0, j = __min_j ; j0 < __size_j0 ; j0++, j++ )
+        max_code[j0] = g_max_admissible_code( k, l, s, j, max_lNFA );
+    }
+  }
+#endif
+/*}}}*/
+}
+
+static void
+g_max_codes_init_arrays()
+{
+  S->g_max_code_f = (uint32_t**)calloc_or_die( S->K, sizeof(uint32_t*) );
+}
+
+/* Precompute g_max_code_f, must be called after g_codes_init and g_store_init */
+static void
+g_max_codes_init()
+{
+  g_max_codes_init_arrays();
+
+  DEFINE_MAX_k ;
+  for( int k = 1 ; k <= __max_k ; k++ )
+    g_max_codes_init_frame( k );
+}
+
+static void
+g_max_codes_free_frame( int k )
+{
+  free( S->g_max_code_f[k] ); S->g_max_code_f[k] = (uint32_t*)NULL ;
+}
+
+static void
+g_max_codes_free()
+{
+  if( !S->g_max_code_f ) return ;
+  for( int k = 0 ; k < S->K ; k++ )
+    g_max_codes_free_frame( k );
+  free( S->g_max_code_f ); S->g_max_code_f = (uint32_t**)NULL ;
+}
+
+/* Collect the candidates of the cell (x,y) (resp. (x,h,y)) of frame k that
+ * has just been computed by the given thread */
 #ifdef ASTRE_HAS_NO_HOLES
-    DEFINE_MIN_l(k);
+static void
+g_candidates_collect( int k, int x, int y, int thread )
+{
+/*{{{*/
+  const double max_lNFA = S->MAX_ALLOWED_LOG_NFA + LOG_NFA_COMP_EPS ;
+  g_candidates* cands = &(S->g_cand_thread[thread]) ;
+  DEFINE_BOUNDS_l(k);
+  const size_t g_l = G_CELL(k,x,y) ;
 
-    int idx_xy = x*N + y ;
+  const uint32_t* max_code = S->g_max_code_f[k] ;
 
-    global_criterion = g_fxl[k][idx_xy][l-__min_l] ;
-#endif
+  for( int l0 = 0, l = __min_l ; l0 < __size_l0 ; l0++, l++ )
+  {
+    const uint32_t code = g_code_at( k, g_l+l0 );
+    if( code > max_code[l0] ) continue ; /* Not meaningful, or no trajectory */
 
+    const float delta = g_code_to_delta( code );
+    CANDIDATE__COMPUTE_NFA(k,x,y,l,delta);
+    if( lNFA > max_lNFA ) continue ;
+
+    g_candidate cand = { lNFA, g_l+l0, k, x, y, 0, (short)l, (short)l, 1 } ;
+    g_candidates_push_back( cands, &cand );
+    if( lNFA < cands->min_lNFA ) cands->min_lNFA = lNFA ;
+  }
+/*}}}*/
+}
+#endif
 #ifdef ASTRE_HAS_HOLES
-    DEFINE_MAX_h(k);
-    DEFINE_MIN_l(k,h);
-    DEFINE_MIN_s(k,h,l);
-    DEFINE_MIN_j(k,h,l,s);
+static void
+g_candidates_collect( int k, int x, int h, int y, int thread )
+{
+/*{{{*/
+  const double max_lNFA = S->MAX_ALLOWED_LOG_NFA + LOG_NFA_COMP_EPS ;
+  g_candidates* cands = &(S->g_cand_thread[thread]) ;
+  DEFINE_BOUNDS_l(k,h);
+  const size_t g_lsj = G_CELL(k,x,h,y) ;
+  const size_t* g_ls_offset = S->g_lsj_offset_h[h] ;
+
+  for( int l0 = 0, l = __min_l ; l0 < __size_l0 ; l0++, l++ )
+  {
+    DEFINE_BOUNDS_s( k, h, l );
+    for( int s0 = 0, s = __min_s ; s0 < __size_s0 ; s0++, s++ )
+    {
+      DEFINE_BOUNDS_j( k, h, l, s );
+      const size_t g_j = g_lsj + g_ls_offset[G_LS_IDX(l0,s0)] ;
+      /* The maximal codes use the layout of h = 0 */
+      const uint32_t* max_code = S->g_max_code_f[k]
+        + S->g_lsj_offset_h[0][G_LS_IDX(l-3,s-3)] + (__min_j-1) ;
+
+      for( int j0 = 0, j = __min_j ; j0 < __size_j0 ; j0++, j++ )
+      {
+        const uint32_t code = g_code_at( k, g_j+j0 );
+        if( code > max_code[j0] ) continue ; /* Not meaningful, or no trajectory */
 
-    int idx_xhy = x*N*(__max_h+1) + h*N + y ;
+        const float delta = g_code_to_delta( code );
+        CANDIDATE__COMPUTE_NFA(k,x,y,l,s,j,delta);
+        if( lNFA > max_lNFA ) continue ;
 
-    global_criterion = g_fxlsj[k][idx_xhy][l-__min_l][s-__min_s][j-__min_j] ;
+        g_candidate cand = { lNFA, g_j+j0, k, x, y, (short)h, (short)l, (short)s, (short)j } ;
+        g_candidates_push_back( cands, &cand );
+        if( lNFA < cands->min_lNFA ) cands->min_lNFA = lNFA ;
+      }
+    }
+  }
+/*}}}*/
+}
 #endif
+
+/* Merge the candidates collected by the threads in the heap, dropping the
+ * candidates of the cells computed again (frames first_k and after). The heap
+ * is ordered by the extraction, if needed. */
+static void
+g_candidates_merge( int first_k )
+{
+/*{{{*/
+  double min_lNFA = HUGE_VAL ;
+  size_t n = 0 ;
+  for( size_t i = 0 ; i < S->g_cand_heap.n ; i++ )
+  {
+    const g_candidate* c = &(S->g_cand_heap.data[i]) ;
+    if( !S->activated_fp[c->k][c->x] || !S->activated_fp[c->k-c->h-1][c->y] ) continue ;
+    if( c->k >= first_k )
+    {
+      if( c->k > S->g_check_dirty_frame ) continue ;
+#ifdef ASTRE_HAS_NO_HOLES
+      if( S->g_dirty_f[c->k][G_CELL_IDX(c->k,c->x,c->y)] ) continue ;
+#endif
+#ifdef ASTRE_HAS_HOLES
+      if( S->g_dirty_f[c->k][G_CELL_IDX(c->k,c->x,c->h,c->y)] ) continue ;
+#endif
+    }
+    if( c->lNFA < min_lNFA ) min_lNFA = c->lNFA ;
+    S->g_cand_heap.data[n++] = *c ;
   }
+  S->g_cand_heap.n = n ;
 
-  while( TRUE )
+  for( int t = 0 ; t < S->N_THREADS ; t++ )
   {
-    const int p = k-h-1 ;
+    for( size_t i = 0 ; i < S->g_cand_thread[t].n ; i++ )
+      g_candidates_push_back( &S->g_cand_heap, &(S->g_cand_thread[t].data[i]) );
+    if( S->g_cand_thread[t].min_lNFA < min_lNFA ) min_lNFA = S->g_cand_thread[t].min_lNFA ;
+    S->g_cand_thread[t].n = 0 ;
+    S->g_cand_thread[t].min_lNFA = HUGE_VAL ;
+  }
 
-    DEFINE_MAX_x(k);
-    DEFINE_MAX_y(p);
+  S->g_cand_min_lNFA = min_lNFA ;
+  S->g_cand_heap_is_heap = FALSE ;
+/*}}}*/
+}
+
+/* Comparison function for quicksort: order of the frames and of G */
+static int
+g_candidate_compare_positions( const void* a, const void* b )
+{
+  const g_candidate* ca = (const g_candidate*)a ;
+  const g_candidate* cb = (const g_candidate*)b ;
+  if( ca->k != cb->k ) return ca->k < cb->k ? -1 : 1 ;
+  if( ca->i != cb->i ) return ca->i < cb->i ? -1 : 1 ;
+  return 0 ;
+}
 
+/* Comparison function for quicksort: increasing log(NFA), then order of the
+ * frames and of G */
+static int
+g_candidate_compare_lNFA( const void* a, const void* b )
+{
+  const g_candidate* ca = (const g_candidate*)a ;
+  const g_candidate* cb = (const g_candidate*)b ;
+  if( ca->lNFA != cb->lNFA ) return ca->lNFA < cb->lNFA ? -1 : 1 ;
+  return g_candidate_compare_positions( a, b );
+}
+
+/* Follow the argmins of G from the candidate c: the frames and the points of
+ * the trajectory realizing it are stored in frames and points (from the last
+ * one, at most MAX_ALLOWED_TRAJECTORY_LENGTH). Returns their number, or -1 if
+ * the trajectory is broken */
+static int
+g_candidate_points( const g_candidate* c, int* frames, int* points )
+{
+/*{{{*/
+  int k = c->k, x = c->x, y = c->y, l = c->l ;
 #ifdef ASTRE_HAS_NO_HOLES
-    DEFINE_BOUNDS_l(k);
-#else
-    DEFINE_BOUNDS_l(k,h);
-    DEFINE_BOUNDS_s(k,h,l);
-    DEFINE_BOUNDS_j(k,h,l,s);
+  const int h = 0 ;
+#endif
+#ifdef ASTRE_HAS_HOLES
+  int h = c->h, s = c->s, j = c->j ;
 #endif
+  int n = 0 ;
 
-    char* activatedX = activated_fp[k] ;
-    char* activatedY = activated_fp[p] ;
+  while( TRUE )
+  {
+    const int p = k-h-1 ;
+    if( !S->activated_fp[k][x] || !S->activated_fp[p][y] ) return -1 ;
 
-    if( !activatedX[x] || !activatedY[y] )
+    frames[n] = k ; points[n] = x ; n++ ;
+    if( l == h+2 )
     {
-      C_log_error( "[extract_trajectory_if_possible] Points are expected to be active!" );
-      exit( -1 );
+      frames[n] = p ; points[n] = y ; n++ ;
+      return n ;
     }
 
-    /* If (X,Y) are the ending points, add them and stop extracting */
-    if( l == h+2 ) /* h == 0 when ASTRE_HAS_NO_HOLES */
-    {
-      types[cur_idx] = PRTYPE_REF ;
-      point_refs[cur_idx].r = x ;
-      cur_idx++ ;
+#ifdef ASTRE_HAS_NO_HOLES
+    DEFINE_MIN_l(k);
+    const uint32_t bp_code = g_bp_at( k, G_CELL(k,x,y) + (l-__min_l) );
+#endif
+#ifdef ASTRE_HAS_HOLES
+    DEFINE_MIN_l(k,h);
+    DEFINE_MIN_s(k,h,l);
+    DEFINE_MIN_j(k,h,l,s);
+    const uint32_t bp_code =
+      g_bp_at( k, G_LSJ( G_CELL(k,x,h,y), h, l-__min_l, s-__min_s, j-__min_j ) );
+    j = j - (h == 0 ? 0 : 1) ;
+    s = s-1 ;
+#endif
+    if( bp_code == G_BP_NONE ) return -1 ;
 
+    l = l-h-1 ;
+    x = y ;
+    y = (int)((bp_code-1) % (uint32_t)S->N) ;
+    k = p ;
 #ifdef ASTRE_HAS_HOLES
-      for( int cur_h = 0 ; cur_h < h ; cur_h++ )
-      {
-        types[cur_idx] = PRTYPE_NONE ;
-        cur_idx++ ;
-      }
+    h = (int)((bp_code-1) / (uint32_t)S->N) ;
 #endif
+  }
+/*}}}*/
+}
 
-      types[cur_idx] = PRTYPE_REF ;
-      point_refs[cur_idx].r = y ;
-      cur_idx++ ;
+/* Are all the points of a trajectory (see g_candidate_points) active? */
+static char
+g_trajectory_is_active( int n, const int* frames, const int* points )
+{
+  if( n < 0 ) return FALSE ;
+  for( int i = 0 ; i < n ; i++ )
+    if( !S->activated_fp[frames[i]][points[i]] ) return FALSE ;
+  return TRUE ;
+}
 
-      break ;
-    }
+/* Thread pool job: i is the index of the candidate in g_cand_batch */
+static void
+g_candidates_backtrack__job( void* data, int i, int thread )
+{
+  const size_t offset = (size_t)i*S->MAX_ALLOWED_TRAJECTORY_LENGTH ;
+  S->g_batch_n[i] = g_candidate_points( &(S->g_cand_batch.data[i]),
+                                     S->g_batch_frames + offset, S->g_batch_points + offset );
+}
 
-    /* The next l value we are looking for */
-    int l_prev = l-h-1 ;
+/* Follow the argmins of G from all the candidates of g_cand_batch, in
+ * parallel: G and the active points are only read */
+static void
+g_candidates_backtrack()
+{
+/*{{{*/
+  if( S->g_cand_batch.n > S->g_batch_allocated )
+  {
+    S->g_batch_allocated = S->g_cand_batch.allocated ;
+    const size_t n_points = S->g_batch_allocated*S->MAX_ALLOWED_TRAJECTORY_LENGTH ;
+    S->g_batch_n = (int*)realloc_or_die( S->g_batch_n, S->g_batch_allocated*sizeof(int) );
+    S->g_batch_frames = (int*)realloc_or_die( S->g_batch_frames, n_points*sizeof(int) );
+    S->g_batch_points = (int*)realloc_or_die( S->g_batch_points, n_points*sizeof(int) );
+  }
 
-#ifdef ASTRE_HAS_HOLES
-    int s_prev = s-1 ;
-    int j_prev = j - (h == 0 ? 0 : 1) ;
-#endif
+  thread_pool_run( S->astre_thread_pool, (int)S->g_cand_batch.n,
+                   &g_candidates_backtrack__job, (void*)NULL );
+/*}}}*/
+}
+/*}}}*/
 
-#ifdef ASTRE_HAS_NO_HOLES
-    float** g_xl_prev = g_fxl[p] ;
-#else
-    float**** g_xlsj_prev = g_fxlsj[p] ;
-#endif
+/*******************************************************************************
+
+        Extract a trajectory if it is unbroken (ie. all the points are
+        activated). Add the trajectory to the store if it is valid.
+
+        The trajectory is rebuilt by following the argmins stored in g_bp_f
+        while computing G (see g_candidate_points), so it is exactly the
+        trajectory realizing the minimum of G. If one of its points has been
+        deactivated by another extraction, the trajectory is broken and we
+        return FALSE: if there still exist a meaningful trajectory ending in
+        these points, we will find it at the next computation / extraction
+        iteration of the algorithm.
+
+        PARAMETERS:
+
+          n      = Number of points of the trajectory, -1 if it was broken
+                   while following the argmins
+          frames = Frames of the points, from the last one
+          points = Indices of the points in their frames
+          info_logNFA = log(NFA) of trajectory, to add to the trajectory infos
+
+        RETURNS:
+          TRUE    if the trajectory was not broken
+          FALSE   otherwise
 
-    /* Try to find a possible predecessor having minimal criterion */
-    double min_criterion = INFTY ;
-    int min_z = -1 ;
-    int min_h2 = -1 ;
+*******************************************************************************/
 
-    float px_X = points[k][x*n_fields+0] ;
-    float px_Y = points[k][x*n_fields+1] ;
-    float py_X = points[p][y*n_fields+0] ;
-    float py_Y = points[p][y*n_fields+1] ;
-    float f_h1_p1 = (float)h + 1.0 ;
+static char
+extract_trajectory_if_possible( int n, const int* frames, const int* points,
+                                double logNFA )
+{
+/*{{{*/
+  if( n < 0 ) return FALSE ;
 
-#ifdef ASTRE_HAS_NO_HOLES
-    int idx_y = y*N ;
-#else
-    DEFINE_MAX_h_prev( p );
-    int max_h2 = (j_prev == 1) ? 0 : min_i( __max_h_prev, l_prev-s_prev+2-j_prev );
-    int idx_y = y*N*(__max_h_prev+1) ;
-#endif
+  for( int i = 0 ; i < n ; i++ )
+  {
+    if( S->activated_fp[frames[i]][points[i]] ) continue ;
 
-#ifdef ASTRE_HAS_NO_HOLES
-    const int q = p-1 ;
-#endif
-#ifdef ASTRE_HAS_HOLES
-    for( int h2 = 0 ; h2 <= max_h2 ; h2++ )
+    /* The end points (x,y) are checked before the extraction */
+    if( i < 2 )
     {
-      int idx_yh2 = idx_y + h2*N ;
-      const int q = p-1-h2 ;
-      float f_h2_p1 = (float)h2 + 1.0 ;
-#endif
-
-      DEFINE_MAX_z( q );
+      C_log_error( "[extract_trajectory_if_possible] Points are expected to be active!" );
+      exit( -1 );
+    }
 
-#ifdef ASTRE_HAS_NO_HOLES
-      DEFINE_MIN_l_prev( p );
-#else
-      DEFINE_MIN_l_prev( p, h2 );
-#endif
-      int l0_prev = l_prev - __min_l_prev ;
+    /* A point has been used by another trajectory */
+    return FALSE ;
+  }
 
-#ifdef ASTRE_HAS_HOLES
-      DEFINE_MIN_s_prev( p, h2, l_prev );
-      DEFINE_MIN_j_prev( p, h2, l_prev, s_prev );
-      int s0_prev = s_prev - __min_s_prev ;
-      int j0_prev = j_prev - __min_j_prev ;
-#endif
+  /* The frames without points of the trajectory are holes */
+  int starting_frame = frames[n-1] ;
+  int length = frames[0] - starting_frame + 1 ;
+  int* n_types = (int*)calloc_or_die( length, sizeof(int) );
+  ref_point* n_point_refs = (ref_point*)calloc_or_die( length, sizeof(ref_point) );
+  for( int i = n-1 ; i >= 0 ; i-- )
+  {
+    n_types[frames[i]-starting_frame] = PRTYPE_REF ;
+    n_point_refs[frames[i]-starting_frame].r = points[i] ;
+  }
 
-      char* activatedZ = activated_fp[q] ;
-      double* pointsZ = points[q] ;
+  /* Disable points */
+  for( int i = n-1 ; i >= 0 ; i-- )
+    deactivate_point( frames[i], points[i] );
 
-      for( int z = 0 ; z <= __max_z ; z++ )
-      {
-        if( !activatedZ[z] ) continue ;
+  /* Add the log(NFA) to trajectory infos */
+  char buf[100] ; sprintf(buf,"%g",logNFA);
+  char* data = strdup(buf);
 
-#ifdef ASTRE_HAS_NO_HOLES
-        int idx_yz = idx_y + z ;
-#else
-        int idx_yh2z = idx_yh2 + z ;
-#endif
+  add_traj( S->trajectory_store, starting_frame, length, n_types, n_point_refs, (void*)data );
 
-        /* There is no prev_criterion if s <= 2
-         * (we only compute the criterion when there are at least 3 points to
-         * have an acceleration) */
-        float prev_criterion = -1.0 ;
+  /* WARNING: we should not free the n_types and n_point_refs arrays since
+   * they are referenced by the trajectory store */
 
-#ifdef ASTRE_HAS_NO_HOLES
-        char has_prev_criterion = l > 3 ;
-#endif
-#ifdef ASTRE_HAS_HOLES
-        char has_prev_criterion = s > 3 ;
-#endif
+  return TRUE ;
+/*}}}*/
+}
 
-        /* Dismiss possibility early */
-        if( has_prev_criterion )
-        {
-#ifdef ASTRE_HAS_NO_HOLES
-          prev_criterion = g_xl_prev[idx_yz][l0_prev] ;
-#else
-          prev_criterion = g_xlsj_prev[idx_yh2z][l0_prev][s0_prev][j0_prev] ;
-#endif
-          if( prev_criterion >= min_criterion ) continue ;
-        }
+/*******************************************************************************
 
-        /* Otherwise, compute the measure update */
-        float pz_X = pointsZ[z*n_fields+0] ;
-        float pz_Y = pointsZ[z*n_fields+1] ;
+        Extraction with a sliding window.
+
+        A trajectory ending at frame e only shares points with trajectories
+        starting at frame e or before, hence ending at frame e+L-1 at the
+        latest (L being the maximal trajectory length): once the frame
+        last_k = e+L-1 has been computed, the trajectory is settled, all the
+        trajectories competing with it being known.
+
+        The settled candidates are extracted in the order of their NFA, as
+        without a window, while the more significant candidates that are not
+        settled yet reserve their points: the candidates using one of these
+        points wait for the next frames, since the reserving candidate could
+        be extracted first. A candidate is extracted anyway WINDOW_LATENCY
+        frames after its last frame (2L-1 by default), before its G values
+        leave the window.
+
+        This is only an approximation of the greedy extraction on the whole
+        sequence, at any latency: a waiting candidate broken by an extraction
+        is replaced by another trajectory ending at the same point, which
+        may use points it did not reserve, taken meanwhile by a less
+        significant settled candidate, and the candidates reaching the
+        latency are extracted before the more significant candidates that
+        wait. Reserving the frames of the waiting candidates instead of their
+        points avoids the former, but then most candidates wait until the
+        latency, and the extraction is further from the greedy one. Below
+        L-1, the candidates are moreover settled WINDOW_LATENCY frames after
+        their last frame, before all their competitors are known.
+
+        g_window_last_frame is the last frame of the sequence, which may come
+        before frame K-1 when streaming.
+
+        g_reserved_fp[f][p] is g_reserve_stamp when the point p of frame f is
+        reserved during the current extraction pass.
 
-        ASTRE_DEFINE_CRITERION ;
+*******************************************************************************/
 
-        /* Compute the updated criterion if there is a previous criterion */
-        float updated_criterion = -1.0 ;
+static void
+g_window_init_frame( int k )
+{
+  free( S->g_reserved_fp[k] );
+  S->g_reserved_fp[k] = (int*)calloc_or_die( max_i( S->n_points_in_frame[k], 1 ), sizeof(int) );
+}
 
-        if( has_prev_criterion )
-        {
-        /* Update criterion */
-          updated_criterion = max_f( criterion, prev_criterion );
-        }
-        else
-        {
-          updated_criterion = criterion ;
-        }
+static void
+g_window_free_frame( int k )
+{
+  free( S->g_reserved_fp[k] ); S->g_reserved_fp[k] = (int*)NULL ;
+}
 
-        /* Update the minimum found criterion */
-        if( updated_criterion < min_criterion )
-        {
-          min_criterion = updated_criterion ;
-          min_z = z ;
-#ifdef ASTRE_HAS_HOLES
-          min_h2 = h2 ;
+static void
+g_window_init()
+{
+/*{{{*/
+#ifdef ASTRE_HAS_NO_HOLES
+  const int max_h = 0 ;
 #endif
-        }
-      } /* END foreach( POINT z IN FRAME q ) */
 #ifdef ASTRE_HAS_HOLES
-    } /* END foreach( HOLE LENGTH h2 ) */
+  const int max_h = S->MAX_ALLOWED_HOLE_LENGTH ;
 #endif
+  g_window_slots_init( min_i( S->K, 3*S->MAX_ALLOWED_TRAJECTORY_LENGTH + max_h ) );
+  S->g_window_last_frame = S->K-1 ;
+
+  S->g_reserved_fp = (int**)calloc_or_die( S->K, sizeof(int*) );
+  for( int k = 0 ; k < S->K ; k++ )
+    g_window_init_frame( k );
+  S->g_reserve_stamp = 0 ;
+  memset( &S->g_cand_pending, 0, sizeof(g_candidates) );
+/*}}}*/
+}
 
-    /* If we have found a point with a valid maximal acceleration, update
-     * the trajectory */
-    /* We don't really care about making a crude global_criterion+1 approximation
-     * here since:
-     * - we keep the minimal min_criterion, and not the first one that satisfies
-     *   min_criterion <= global_criterion + EPS
-     * - we check in the end that the log(NFA) of the extracted trajectory is not
-     *   too far from the one we are trying to obtain
-     * - sometime, even a moderate EPS like 1E-2 might cause some floating point
-     *   comparison problems, for some unknown reaons. */
-    const float EPS = 1 ; // 1E-2 ;
-    if( min_criterion <= global_criterion + EPS )
-    {
-      /* Copy point X and hole h1 */
-      types[cur_idx] = PRTYPE_REF ;
-      point_refs[cur_idx].r = x ;
-      cur_idx++ ;
+static void
+g_window_free()
+{
+/*{{{*/
+  g_window_slots_free();
+  if( !S->g_reserved_fp ) return ;
+  for( int k = 0 ; k < S->K ; k++ )
+    g_window_free_frame( k );
+  free( S->g_reserved_fp ); S->g_reserved_fp = (int**)NULL ;
+  free( S->g_cand_pending.data ); S->g_cand_pending.data = (g_candidate*)NULL ;
+/*}}}*/
+}
 
-#ifdef ASTRE_HAS_HOLES
-      for( int h_cur = 0 ; h_cur < h ; h_cur++ )
-      {
-        types[cur_idx] = PRTYPE_NONE ;
-        cur_idx++ ;
-      }
+/* Frame k enters the window: the frames before k - g_window_size + 1 leave
+ * it, with the candidates whose trajectory could depend on them */
+static void
+g_window_advance( int k )
+{
+/*{{{*/
+#ifdef ASTRE_HAS_NO_HOLES
+  const int max_h = 0 ;
 #endif
-
-      /* Update variables */
-      x = y ;
-      y = min_z ;
-      k = k-h-1 ;
-
 #ifdef ASTRE_HAS_HOLES
-      h = min_h2 ;
-      s = s_prev ;
-      j = j_prev ;
+  const int max_h = S->MAX_ALLOWED_HOLE_LENGTH ;
 #endif
 
-      l = l_prev ;
-    }
-    else
-    {
-      /* Couldn't extend the trajectory */
-      trajectory_is_broken = TRUE ;
-      break ;
-    }
-  }
-
-  /* If the trajectory is not broken, add it to the trajectory store if the NFA
-   * is not too far from the expected NFA (it might vary because of the EPS slack
-   * comparison when trying to extract the correct trajectory) */
-  if( !trajectory_is_broken )
+  if( S->g_window_first_frame <= k - S->g_window_size )
   {
-    /* Since we stored points in the reverse order, change their positions */
-    int* n_types = (int*)calloc_or_die( cur_idx, sizeof(int) );
-    ref_point* n_point_refs = (ref_point*)calloc_or_die( cur_idx, sizeof(ref_point) );
-    for( int i = 0 ; i < cur_idx ; i++ )
+    while( S->g_window_first_frame <= k - S->g_window_size )
+      g_window_slot_detach( S->g_window_first_frame++ );
+
+    /* Recomputing G after the extraction of a trajectory starting at frame
+     * k-l+1 uses the values of the frames k-l+1-max_h and after */
+    double min_lNFA = HUGE_VAL ;
+    size_t n = 0 ;
+    for( size_t i = 0 ; i < S->g_cand_heap.n ; i++ )
     {
-      n_types[i] = types[cur_idx-i-1] ;
-      n_point_refs[i] = point_refs[cur_idx-i-1] ;
+      const g_candidate* c = &(S->g_cand_heap.data[i]) ;
+      if( c->k - c->l + 1 - max_h < S->g_window_first_frame ) continue ;
+      if( c->lNFA < min_lNFA ) min_lNFA = c->lNFA ;
+      S->g_cand_heap.data[n++] = *c ;
     }
+    S->g_cand_heap.n = n ;
+    S->g_cand_min_lNFA = min_lNFA ;
+    S->g_cand_heap_is_heap = FALSE ;
+  }
 
-    int length = cur_idx ;
-    int starting_frame = last_frame - length + 1 ;
-
-    /* There is one weakness in the extraction process: since we're comparing
-     * floating point values, we need to add a comparison "slack" EPS, and for
-     * some features, this might result in a completely different NFA if the
-     * slack is too high, so we check again that the NFA of the extracted trajectory
-     * is not too far from the predicted NFA */
-    double extracted_lNFA = compute_log_NFA_of_trajectory(
-        starting_frame, length, n_types, n_point_refs
-    );
-    if( abs_d( logNFA - extracted_lNFA ) > 1E-2 )
-    {
-      P(" expected log(NFA) = %g, found log(NFA) = %g (diff: %g)\n", logNFA, extracted_lNFA,
-          abs_d(logNFA-extracted_lNFA));
-      trajectory_is_broken = TRUE ;
-      free( n_types ); n_types = (int*)NULL ;
-      free( n_point_refs ); n_point_refs = (ref_point*)NULL ;
-    }
-    else
-    {
-    /* If the trajectory is not broken and the NFA is not too far, add it to the store */
-      /* Disable points */
-      for( int k = 0 ; k < length ; k++ )
-      {
-        if( n_types[k] == PRTYPE_REF )
-        {
-          if( activated_fp[starting_frame+k][n_point_refs[k].r] == FALSE )
-          {
-            C_log_error( "[extract_trajectory_if_possible] Point is not active!" );
-            exit(-1);
-          }
-          activated_fp[starting_frame+k][n_point_refs[k].r] = FALSE ;
-        }
-      }
+  g_window_slot_attach( k );
+/*}}}*/
+}
 
-      /* Add the log(NFA) to trajectory infos */
-      char buf[100] ; sprintf(buf,"%g",logNFA);
-      char* data = strdup(buf);
+/* Should the candidate c, whose trajectory has n points (see
+ * g_candidate_points), wait for the next frames? Its points are then
+ * reserved */
+static char
+g_candidate_waits( const g_candidate* c, int n, const int* frames, const int* points,
+                   int settled_k )
+{
+/*{{{*/
+  /* broken, see extract_trajectory_if_possible */
+  if( !g_trajectory_is_active( n, frames, points ) ) return FALSE ;
 
-      add_traj( trajectory_store, starting_frame, length, n_types, n_point_refs, (void*)data );
+  char waits = c->k > settled_k ;
+  for( int i = 0 ; i < n && !waits ; i++ )
+    waits = S->g_reserved_fp[frames[i]][points[i]] == S->g_reserve_stamp ;
 
-      /* WARNING: we should not free the n_types and n_point_refs arrays since
-       * they are referenced by the trajectory store */
-    }
+  if( waits )
+  {
+    for( int i = 0 ; i < n ; i++ )
+      S->g_reserved_fp[frames[i]][points[i]] = S->g_reserve_stamp ;
+    g_candidates_push_back( &S->g_cand_pending, c );
   }
+  return waits ;
+/*}}}*/
+}
 
-  /* Free initial arrays */
-  free( types ); types = (int*)NULL ;
-  free( point_refs ); point_refs = (ref_point*)NULL ;
-
-  return !trajectory_is_broken ;
+/* Put the waiting candidates back in the ordered heap */
+static void
+g_candidates_restore_pending()
+{
+/*{{{*/
+  S->g_cand_min_lNFA = S->g_cand_heap.n > 0 ? S->g_cand_heap.data[0].lNFA : HUGE_VAL ;
+  if( S->g_cand_pending.n == 0 ) return ;
+  for( size_t i = 0 ; i < S->g_cand_pending.n ; i++ )
+  {
+    const g_candidate* c = &(S->g_cand_pending.data[i]) ;
+    if( c->lNFA < S->g_cand_min_lNFA ) S->g_cand_min_lNFA = c->lNFA ;
+    g_candidates_push_back( &S->g_cand_heap, c );
+  }
+  S->g_cand_pending.n = 0 ;
+  S->g_cand_heap_is_heap = FALSE ;
 /*}}}*/
 }
 
@@ -606,10 +1315,14 @@ extract_trajectory_if_possible( int k,
         Returns true if there might possibly be other trajectories that can 
         be extracted, returns false otherwise.
 
+        last_k is the last computed frame: with a sliding window, only the
+        settled candidates are extracted, see the extraction with a sliding
+        window.
+
 *******************************************************************************/
 
-char
-extract_and_disable_most_significant_trajectories ()
+static char
+extract_and_disable_most_significant_trajectories( int last_k )
 {
 /*{{{*/
   /* While the trajectory we have encountered are not broken (ie. do not
@@ -622,12 +1335,12 @@ extract_and_disable_most_significant_trajectories ()
 
    0. while( valid_state )
       {
-        1. min <-- min( log NFAs )
+        1. min <-- min( log NFAs of the candidates )
         2. if( min > MIN_ALLOWED_LOG_NFA )
            {
               return false ; // stop
            }
-        3. foreach( x realizing the min )
+        3. foreach( candidate x realizing the min )
            {
               bool is_valid = extract_trajectory_if_possible( x );
 
@@ -638,108 +1351,128 @@ extract_and_disable_most_significant_trajectories ()
 
   */
 
-  /* Because of floating-point precision, we may vary dynamically the precision
-   * of comparisons if the minimal log(NFA) cannot be found */
-  double prec = LOG_NFA_COMP_EPS ;
-  char found_the_minimal_lNFA = FALSE ;
+  /* The candidates within LOG_NFA_COMP_EPS of the minimal log(NFA) are
+   * extracted in the same pass, in the order of the frames and of G: their
+   * trajectories are followed in parallel, then the points of each extracted
+   * trajectory are deactivated in turn, which breaks the next candidates of
+   * the batch sharing one of them. Only the cells of the broken candidates
+   * (and their dependencies) are computed again, see g_dirty_f.
+   *
+   * With EXTRACT_PAST_CONFLICTS, the batch is resolved by increasing log(NFA),
+   * and a broken candidate does not end the round: the next batches are
+   * extracted until MAX_ALLOWED_LOG_NFA, and only then are the broken cells
+   * computed again. The unbroken candidates are still the minima of their
+   * cells, but a broken cell may now have a value between its old one and
+   * theirs, so the extraction may differ from the greedy one. */
+  const double prec = LOG_NFA_COMP_EPS ;
+  char has_broken = FALSE ;
+
+  /* Every candidate is settled once the last frame is computed */
+  const int L = S->MAX_ALLOWED_TRAJECTORY_LENGTH ;
+  const char all_settled = !S->SLIDING_WINDOW || last_k >= S->g_window_last_frame ;
+  const int settled_k = all_settled ? S->K : last_k - min_i( S->WINDOW_LATENCY, L-1 ) ;
+  const int forced_k = all_settled ? S->K : last_k - S->WINDOW_LATENCY ;
+
+  /* The minimum was tracked while computing G: no need to order the heap */
+  if( S->g_cand_min_lNFA > S->MAX_ALLOWED_LOG_NFA )
+  {
+    if( S->g_cand_heap.n > 0 )
+      P( " Min log NFA >= %g > MAX_LOG_NFA = %g\n", S->g_cand_min_lNFA, S->MAX_ALLOWED_LOG_NFA );
+    else
+      P( " Min log NFA > MAX_LOG_NFA = %g\n", S->MAX_ALLOWED_LOG_NFA );
+    P( " All the meaningful trajectories have been extracted!\n" );
+    return FALSE ;
+  }
+
+  g_cand_heap_make();
+  S->g_reserve_stamp++ ;
 
   while( valid_state )
   {
-    double min_log_NFA = find_minimal_NFA() ;
+    /* Drop the candidates having a deactivated end point */
+    while( S->g_cand_heap.n > 0 )
+    {
+      const g_candidate* c = &(S->g_cand_heap.data[0]) ;
+      if( S->activated_fp[c->k][c->x] && S->activated_fp[c->k-c->h-1][c->y] ) break ;
+      g_cand_heap_pop();
+    }
 
-    if( min_log_NFA > MAX_ALLOWED_LOG_NFA )
+    if( S->g_cand_heap.n == 0 || S->g_cand_heap.data[0].lNFA > S->MAX_ALLOWED_LOG_NFA )
     {
-      P( " Min log NFA = %g > MAX_LOG_NFA = %g\n", min_log_NFA, MAX_ALLOWED_LOG_NFA );
+      if( S->g_cand_heap.n > 0 )
+        P( " Min log NFA = %g > MAX_LOG_NFA = %g\n", S->g_cand_heap.data[0].lNFA, S->MAX_ALLOWED_LOG_NFA );
+      else
+        P( " Min log NFA > MAX_LOG_NFA = %g\n", S->MAX_ALLOWED_LOG_NFA );
+      g_candidates_restore_pending();
+      /* The broken cells may still hold meaningful trajectories */
+      if( has_broken )
+      {
+        P( " The broken candidates require a recomputation of the weights!\n" );
+        return TRUE ;
+      }
       P( " All the meaningful trajectories have been extracted!\n" );
       /* Since the state is still valid, we cannot extract trajectories
        * having a log NFA lower than min_log_NFA, so we won't find any
        * new significant trajectories, we can stop the extraction */
       return FALSE ;
     }
-    else
-    {
-      P( " > Min log NFA = %g...\n", min_log_NFA );
-    }
-
-    FORALL_k
-
-#ifdef ASTRE_HAS_NO_HOLES
-      FORALL_x ; FORALL_y ; FORALL_l
-      float delta = *g_l_cur ;
-#endif
-#ifdef ASTRE_HAS_HOLES
-      FORALL_x ; FORALL_h ; FORALL_y
-      FORALL_l ; FORALL_s ; FORALL_j
-      float delta = *g_j_cur ;
-#endif
 
-        if( delta >= INFTY-1 ) continue ; /* No trajectory */
+    const double min_log_NFA = S->g_cand_heap.data[0].lNFA ;
+    P( " > Min log NFA = %g...\n", min_log_NFA );
 
-#ifdef ASTRE_HAS_NO_HOLES
-        double lNFA = log_NFA( k, delta, l );
-#else
-        double lNFA = log_NFA( k, delta, l, s, j );
-#endif
-
-        if( lNFA <= min_log_NFA + prec )
-        {
-          /* Reinit precision */
-          found_the_minimal_lNFA = TRUE ; prec = LOG_NFA_COMP_EPS ;
-
-#ifdef ASTRE_HAS_NO_HOLES
-          char is_valid = extract_trajectory_if_possible( k, x, y, l, lNFA );
-#else
-          char is_valid = extract_trajectory_if_possible( k, x, h, y, l, s, j, lNFA );
-#endif
-          /* If trajectory was broken, we switch to invalid state, we can
-           * still extract other trajectories having same NFA, but we cannot
-           * continue with higher NFAs, since we could find lower NFAs when
-           * doing another computation pass. */
-          valid_state &= is_valid ;
-
-          if( !is_valid )
-          {
-            P(" Two trajectories shared a point, a recomputation of the weights is required!\n ");
-          }
-          else
-          {
-            P(" Trajectory extracted!\n ");
-            /* Since current x and y are now deactivated, we need to find other x, y */
-            goto NextXLoop ;
-          }
-        }
-
-#ifdef ASTRE_HAS_NO_HOLES
-      END_FORALL_l ; END_FORALL_y ;
-#endif
-#ifdef ASTRE_HAS_HOLES
-      END_FORALL_j ; END_FORALL_s ; END_FORALL_l
-      END_FORALL_y ; END_FORALL_h ;
-#endif
-
-NextXLoop: ;      
-      END_FORALL_x
-    END_FORALL_k
+    S->g_cand_batch.n = 0 ;
+    while( S->g_cand_heap.n > 0 && S->g_cand_heap.data[0].lNFA <= min_log_NFA + prec )
+    {
+      g_candidates_push_back( &S->g_cand_batch, &(S->g_cand_heap.data[0]) );
+      g_cand_heap_pop();
+    }
+    qsort( S->g_cand_batch.data, S->g_cand_batch.n, sizeof(g_candidate),
+           S->EXTRACT_PAST_CONFLICTS ? &g_candidate_compare_lNFA
+                                  : &g_candidate_compare_positions );
+    g_candidates_backtrack();
 
-    if( !found_the_minimal_lNFA )
+    for( size_t i = 0 ; i < S->g_cand_batch.n ; i++ )
     {
-      P(" [!] WARNING: couldn't find the minimal lNFA %g!\n", min_log_NFA );
-      prec = prec*10 ;
-      P("              setting precision to %g\n", prec );
-      if( prec >= 0.01 )
+      const g_candidate* c = &(S->g_cand_batch.data[i]) ;
+      const int n = S->g_batch_n[i] ;
+      const int* frames = S->g_batch_frames + i*S->MAX_ALLOWED_TRAJECTORY_LENGTH ;
+      const int* points = S->g_batch_points + i*S->MAX_ALLOWED_TRAJECTORY_LENGTH ;
+
+      /* The points of a previous extraction are deactivated */
+      if( !S->activated_fp[c->k][c->x] || !S->activated_fp[c->k-c->h-1][c->y] ) continue ;
+
+      if( c->k > forced_k && g_candidate_waits( c, n, frames, points, settled_k ) ) continue ;
+
+      char is_valid = extract_trajectory_if_possible( n, frames, points, c->lNFA );
+      /* If trajectory was broken, we switch to invalid state, we can
+       * still extract other trajectories having same NFA, but we cannot
+       * continue with higher NFAs, since we could find lower NFAs when
+       * doing another computation pass. The broken candidates are in
+       * cells that will be computed again, and need not be kept. */
+      if( !S->EXTRACT_PAST_CONFLICTS ) valid_state &= is_valid ;
+      has_broken |= !is_valid ;
+
+      if( !is_valid && S->EXTRACT_PAST_CONFLICTS )
+      {
+        P(" Two trajectories shared a point, the broken one will be computed again!\n ");
+      }
+      else if( !is_valid )
       {
-        mini_mwerror( FATAL, 1, "Precision much too low... might be an error\n" );
+        P(" Two trajectories shared a point, a recomputation of the weights is required!\n ");
+      }
+      else
+      {
+        P(" Trajectory extracted!\n ");
       }
     }
 
-    found_the_minimal_lNFA = FALSE ;
-
     P("\n");
   } /* END while( valid_state ) */
 
   /* The minimal NFA of trajectories that we have checked was greater than
    * the limit, therefore there is possibly other trajectories to extract
    * if we compute the new trajectories NFA for the points that are left */
+  g_candidates_restore_pending();
   return TRUE ;
 /*}}}*/
 }
@@ -752,275 +1485,436 @@ NextXLoop: ;
 
         Brief overview: (TODO)
 
-*******************************************************************************/
-
-void
-compute_most_significant_trajectories()
-#ifdef ASTRE_HAS_NO_HOLES
-{
-/*{{{*/
-  P( "  -- k = 000 / 000" );
-  FORALL_k
-
-    P( "\b\b\b\b\b\b\b\b\b%03d / %03d", k, K-1 ); fflush(stdout) ;
-    double* pointsX = points[k] ;
-
-    FORALL_x
+        Inside a frame k, the G values of a point x (and of a hole length h
+        when there are holes) only depend on the G values of the previous
+        frames, so the frame is split in independent jobs (one per x, or per
+        (x,h)) that are shared between the threads of astre_thread_pool. Each
+        job writes its own slab of G in the same order as the serial version,
+        so the results do not depend on the number of threads.
 
-      const float px_X = pointsX[x*n_fields+0] ;
-      const float px_Y = pointsX[x*n_fields+1] ;
+        When USE_SPATIAL_INDEX is set, the points z are searched in rings
+        around their predicted position, and the minima over z of the G
+        values of each frame are computed right after the frame, see the
+        description of points_grid_f.
 
-      double* pointsY = points[k-1] ;
-      float** g_xl_prev = g_fxl[k-1];
+        After an extraction, only the frames (and the cells, depending on
+        INCREMENTAL_LEVEL) that may have changed are computed again, see the
+        description of g_dirty_f.
 
-      FORALL_y
+        Each computed cell adds its candidate trajectories to the candidates
+        of its thread, which are merged in g_cand_heap at the end.
 
-        const float py_X = pointsY[y*n_fields+0];
-        const float py_Y = pointsY[y*n_fields+1];
-        const int idx_y = y*N ;
-
-        /* Reinit the values for (x,y) */
-        FORALL_l ;
-          *g_l_cur = INFTY ;
-        END_FORALL_l
-
-        if( k <= 1 ) continue ;
-
-        DEFINE_BOUNDS_l_prev( p );
-
-        const int q = k-2 ;
-        DEFINE_MAX_z( q );
-        char* activatedZ = activated_fp[q] ;
-        double* pointsZ = points[q] ;
-
-        for( int z = 0 ; z <= __max_z ; z++ )
-        {
-          if( !activatedZ[z] ) continue ;
-
-          const int idx_yz = idx_y + z ;
-          float* g_l_prev = g_xl_prev[idx_yz] ;
+*******************************************************************************/
 
-          const float pz_X = pointsZ[z*n_fields+0] ;
-          const float pz_Y = pointsZ[z*n_fields+1] ;
+/* The kernels, for each type of codes (the argmin codes having the size of
+ * the criterion codes) and each instruction set */
+#define G_KERNEL_CODE_T uint16_t
+#define G_KERNEL_CODE_BITS 16
+#define G_KERNEL_BP_T uint16_t
+
+#define G_KERNEL_SIMD G_SIMD_SCALAR
+#define G_KERNEL(name) name##__u16
+#include "astre-common-kernels.h"
+#undef G_KERNEL
+#undef G_KERNEL_SIMD
+
+#ifdef ASTRE_HAS_X86_SIMD
+ #define G_KERNEL_SIMD G_SIMD_SSE41
+ #define G_KERNEL(name) name##__u16__sse41
+ #include "astre-common-kernels.h"
+ #undef G_KERNEL
+ #undef G_KERNEL_SIMD
+
+ #define G_KERNEL_SIMD G_SIMD_AVX2
+ #define G_KERNEL(name) name##__u16__avx2
+ #include "astre-common-kernels.h"
+ #undef G_KERNEL
+ #undef G_KERNEL_SIMD
+
+ #define G_KERNEL_SIMD G_SIMD_AVX512
+ #define G_KERNEL(name) name##__u16__avx512
+ #include "astre-common-kernels.h"
+ #undef G_KERNEL
+ #undef G_KERNEL_SIMD
+#endif
 
-          ASTRE_DEFINE_CRITERION ;
+#undef G_KERNEL_BP_T
+#undef G_KERNEL_CODE_BITS
+#undef G_KERNEL_CODE_T
+
+#define G_KERNEL_CODE_T uint32_t
+#define G_KERNEL_CODE_BITS 32
+#define G_KERNEL_BP_T uint32_t
+
+#define G_KERNEL_SIMD G_SIMD_SCALAR
+#define G_KERNEL(name) name##__u32
+#include "astre-common-kernels.h"
+#undef G_KERNEL
+#undef G_KERNEL_SIMD
+
+#ifdef ASTRE_HAS_X86_SIMD
+ #define G_KERNEL_SIMD G_SIMD_SSE41
+ #define G_KERNEL(name) name##__u32__sse41
+ #include "astre-common-kernels.h"
+ #undef G_KERNEL
+ #undef G_KERNEL_SIMD
+
+ #define G_KERNEL_SIMD G_SIMD_AVX2
+ #define G_KERNEL(name) name##__u32__avx2
+ #include "astre-common-kernels.h"
+ #undef G_KERNEL
+ #undef G_KERNEL_SIMD
+
+ #define G_KERNEL_SIMD G_SIMD_AVX512
+ #define G_KERNEL(name) name##__u32__avx512
+ #include "astre-common-kernels.h"
+ #undef G_KERNEL
+ #undef G_KERNEL_SIMD
+#endif
 
-          /* The iteration here looks a bit cumbersome, because it was written
-           * in a way similar to that for the case with holes, where the
-           * iteration is more complex. This actually simply loops on all
-           * length len from 3 to (k+1), and the check whether the
-           * corresponding best trajectory of length len-1 ending on (z,y) and
-           * extended by (y,x) is better than the other extensions of length
-           * len ending on (y,x). */
+#undef G_KERNEL_BP_T
+#undef G_KERNEL_CODE_BITS
+#undef G_KERNEL_CODE_T
 
-          /* Points to G(y,z,k-1,l=3) */
-          float* g_l_prev_first = &(g_l_prev[0]);
-          /* Points after last G(z,y,k-1,l) */
-          float* g_l_prev_last = &(g_l_prev[__size_l0_prev]);
+/* Kernels used for the type of codes and the instruction set, selected by
+ * g_kernels_init(), see g_kernel */
+#ifdef ASTRE_HAS_NO_HOLES
+#define G_KERNEL_COMPUTE(suffix) &compute_most_significant_trajectories__x##suffix
+#define G_KERNEL_COMPUTE_SPECIALISED(suffix) G_KERNEL_COMPUTE(suffix)
+#endif
+#ifdef ASTRE_HAS_HOLES
+#define G_KERNEL_COMPUTE(suffix) &compute_most_significant_trajectories__xh##suffix
+/* The kernels specialised for the maximal hole length, if there is one (only
+ * for AVX2 and AVX-512, see astre-common-kernels.h) */
+#define G_KERNEL_COMPUTE_SPECIALISED(suffix) \
+  ( S->MAX_ALLOWED_HOLE_LENGTH == 1 ? &compute_most_significant_trajectories__xh__h1##suffix : \
+    S->MAX_ALLOWED_HOLE_LENGTH == 2 ? &compute_most_significant_trajectories__xh__h2##suffix : \
+                                   &compute_most_significant_trajectories__xh##suffix )
+#endif
 
-          /* Points to G(x,y,k,l=3) */
-          float* g_l_cur = &(g_l[0]);
+static const char* G_SIMD_NAMES[] = { "scalar", "SSE4.1", "AVX2", "AVX-512" } ;
 
-          /* Len == 3 */
-          {
-            if( *g_l_cur > criterion ) *g_l_cur = criterion ;
-            g_l_cur++ ;
-          }
+/* Select the kernels of the instruction set SIMD_LEVEL, or of the best one
+ * supported by the processor */
+static void
+g_kernels_init()
+{
+/*{{{*/
+  int best_level = G_SIMD_SCALAR ;
+#ifdef ASTRE_HAS_X86_SIMD
+  __builtin_cpu_init();
+  if( __builtin_cpu_supports( "sse4.1" ) ) best_level = G_SIMD_SSE41 ;
+  if( __builtin_cpu_supports( "avx2" ) ) best_level = G_SIMD_AVX2 ;
+  if( __builtin_cpu_supports( "avx512f" ) && __builtin_cpu_supports( "avx512bw" ) )
+    best_level = G_SIMD_AVX512 ;
+#endif
 
-          /* Len > 3 */
-          for( float* g_l_prev_cur = g_l_prev_first ;
-                      g_l_prev_cur != g_l_prev_last ;
-                      g_l_prev_cur++, g_l_cur++ )
-          {
-            float delta_prev = *g_l_prev_cur ;
-            float updated_criterion = max_f( criterion, delta_prev );
+  if( S->SIMD_LEVEL > best_level )
+    C_log_warning( "The %s kernels are not supported, using the %s ones\n",
+                   G_SIMD_NAMES[S->SIMD_LEVEL], G_SIMD_NAMES[best_level] );
+  if( S->SIMD_LEVEL < 0 || S->SIMD_LEVEL > best_level )
+    S->SIMD_LEVEL = best_level ;
 
-            if( *g_l_cur > updated_criterion ) *g_l_cur = updated_criterion ;
+  #define G_KERNELS_CASE(level,compute,suffix) \
+    case level: \
+      S->g_kernel = compute(suffix) ; \
+      S->g_kernel_zmin = &compute_zmin__y##suffix ; \
+      break ;
 
-          } /* END foreach( LENGTH l ) */
-        } /* END foreach( POINT z IN FRAME q ) */
+  /* The kernels of the types of codes, for each instruction set */
+#ifdef ASTRE_HAS_X86_SIMD
+  #define G_KERNELS_SWITCH(types) \
+    switch( S->SIMD_LEVEL ) \
+    { \
+      G_KERNELS_CASE( G_SIMD_SCALAR, G_KERNEL_COMPUTE, types ) \
+      G_KERNELS_CASE( G_SIMD_SSE41, G_KERNEL_COMPUTE, types##__sse41 ) \
+      G_KERNELS_CASE( G_SIMD_AVX2, G_KERNEL_COMPUTE_SPECIALISED, types##__avx2 ) \
+      G_KERNELS_CASE( G_SIMD_AVX512, G_KERNEL_COMPUTE_SPECIALISED, types##__avx512 ) \
+    }
+#else
+  #define G_KERNELS_SWITCH(types) \
+    switch( S->SIMD_LEVEL ) \
+    { \
+      G_KERNELS_CASE( G_SIMD_SCALAR, G_KERNEL_COMPUTE, types ) \
+    }
+#endif
 
-      END_FORALL_y
-    END_FORALL_x
-  END_FORALL_k
+  if( S->G_CODE_BITS == 16 ) { G_KERNELS_SWITCH( __u16 ) }
+  else { G_KERNELS_SWITCH( __u32 ) }
 
-  P("\n");
+  #undef G_KERNELS_SWITCH
+  #undef G_KERNELS_CASE
 /*}}}*/
 }
-#endif
-#ifdef ASTRE_HAS_HOLES
+
+/* Rebuild the lists of the active points (and compact the grids) of the
+ * frames having deactivated points, once the links are built */
+static void
+active_points_update()
 {
 /*{{{*/
-  P( "  -- k = 000 / 000" );
-  FORALL_k
-
-    P( "\b\b\b\b\b\b\b\b\b%03d / %03d", k, K-1 ); fflush(stdout) ;
-    double* pointsX = points[k] ;
-
-    FORALL_x
-
-      const float px_X = pointsX[x*n_fields+0] ;
-      const float px_Y = pointsX[x*n_fields+1] ;
-
-      FORALL_h
-
-        double* pointsY = points[p] ;
-
-        /* constants initialization */
-        const float f_h1_p1 = (float)h+1.0 ;
-        
-        /* if there is a hole (h > 0), the next j we are looking for is cur_j - eps_j */
-        const int eps_j = h == 0 ? 0 : 1 ;
-
-        /* the next l we are looking for is cur_l - delta_l */
-        const int delta_l = h+1 ;
-
-        float**** g_xlsj_prev = g_fxlsj[p];
-        DEFINE_MAX_h_prev( p );
+  for( int k = 0 ; k < S->K ; k++ )
+  {
+    if( !S->active_fp_is_stale_f[k] ) continue ;
+    active_fp_rebuild( k );
+    if( S->points_grid_f ) points_grid_compact( k );
+  }
+/*}}}*/
+}
 
-        FORALL_y
+/* Thread pool job: i is the index of the active point y of frame *data */
+static void
+compute_zmin__job( void* data, int i, int thread )
+{
+  const int p = *(int*)data ;
+  S->g_kernel_zmin( p, S->active_fp[p][i] );
+}
 
-          const float py_X = pointsY[y*n_fields+0] ;
-          const float py_Y = pointsY[y*n_fields+1] ;
-          const int idx_y = y*N*(__max_h_prev+1);
+/* Thread pool job: i is the index of the active point x (of (x,h) when there
+ * are holes) */
+static void
+compute_most_significant_trajectories__job( void* data, int i, int thread )
+{
+  const int k = *(int*)data ;
+#ifdef ASTRE_HAS_NO_HOLES
+  S->g_kernel( k, S->active_fp[k][i], thread );
+#endif
+#ifdef ASTRE_HAS_HOLES
+  DEFINE_MAX_h(k);
+  S->g_kernel( k, S->active_fp[k][i/(__max_h+1)], i%(__max_h+1), thread );
+#endif
+}
 
-          /* Reinit the values for (x,h,y) */
-          FORALL_l ;
-            FORALL_s ;
-              FORALL_j ;
-                *g_j_cur = INFTY ;
-              END_FORALL_j ;
-            END_FORALL_s ;
-          END_FORALL_l
+/* Compute the G values of the frames first_k .. last_k, one after the other */
+static void
+compute_frames( int first_k, int last_k, char check_dirty )
+{
+/*{{{*/
+  for( int k = first_k ; k <= last_k ; k++ )
+  {
+    P( "\b\b\b\b\b\b\b\b\b%03d / %03d", k, S->K-1 ); fflush(stdout) ;
 
-          for( int h2 = 0 ; h2 <= __max_h_prev ; h2++ )
-          {
-            const int idx_yh2 = idx_y + h2*N ;
-            const float f_h2_p1 = (float)h2+1.0 ;
+#ifdef ASTRE_HAS_NO_HOLES
+    const int n_jobs = S->n_active_f[k] ;
+#endif
+#ifdef ASTRE_HAS_HOLES
+    DEFINE_MAX_h(k);
+    const int n_jobs = S->n_active_f[k]*(__max_h+1) ;
+#endif
 
-            DEFINE_BOUNDS_l_prev( p, h2 );
+    thread_pool_run( S->astre_thread_pool, n_jobs,
+                     &compute_most_significant_trajectories__job, (void*)&k );
 
-            const int q = p-1-h2 ;
-            DEFINE_MAX_z( q );
-            char* activatedZ = activated_fp[q] ;
-            double* pointsZ = points[q] ;
+    if( S->USE_SPATIAL_INDEX )
+      thread_pool_run( S->astre_thread_pool, S->n_active_f[k], &compute_zmin__job, (void*)&k );
 
-            for( int z = 0 ; z <= __max_z ; z++ )
-            {
-              if( !activatedZ[z] ) continue ;
+    if( check_dirty && k > S->g_check_dirty_frame )
+      memset( S->g_dirty_f[k], 1, S->g_n_cells_f[k] );
+  }
+/*}}}*/
+}
 
-              const int idx_yh2z = idx_yh2 + z ;
-              float*** g_lsj_prev = g_xlsj_prev[idx_yh2z] ;
+#ifdef ASTRE_HAS_HOLES
+/*******************************************************************************
 
-              const float pz_X = pointsZ[z*n_fields+0] ;
-              const float pz_Y = pointsZ[z*n_fields+1] ;
+        Wavefront computation of the frames (with holes).
 
-              ASTRE_DEFINE_CRITERION ;
+        The slab (k,h) of frame k (the cells (x,h,y) of all the points x)
+        only depends on the frame p = k-h-1, ie. on its G values, its dirty
+        flags and its minima over z. Hence, rather than waiting for the whole
+        frame k-1, the slabs of the next frames whose frame p is complete are
+        computed with the slabs of frame k: the frames overlap in a wavefront,
+        and a frame having many points no longer leaves the threads idle
+        while its last slabs are computed.
 
-              /* Criterion initialization */
-              {
-                int l = k-q+1 ;
-                int s = 3 ;
-                int j = 1+(h==0?0:1)+(h2==0?0:1) ;
+        The slabs are split in tasks of a few points x, and the minima over
+        z of a frame in tasks of a few points y, which are queued once their
+        dependencies are complete. Each thread of astre_thread_pool takes the
+        oldest ready task of the queue, so that the frames complete in order
+        as much as possible. Each task writes its own values as in the
+        frame by frame computation, so the results are the same.
 
-                DEFINE_MIN_l(k,h);
-                DEFINE_MIN_s(k,h,l);
-                DEFINE_MIN_j(k,h,l,s);
+*******************************************************************************/
 
-#ifdef ALL_CHECKS
-                C_assert( l >= __min_l );
-                C_assert( s >= __min_s );
-                C_assert( j >= __min_j );
-#endif
+/* Number of tasks of n points */
+static inline int
+g_wave_n_tasks( int n )
+{
+  return min_i( n, 4*S->N_THREADS );
+}
 
-                float *init = &(g_lsj[l-__min_l][s-__min_s][j-__min_j]);
-                if( *init > criterion ) *init = criterion ;
-              }
+/* Queue the tasks of the slab (k,h) (the minima over z when h = -1) */
+static void
+g_wave_push( int k, int h )
+{
+/*{{{*/
+  const int n = S->n_active_f[k] ;
+  const int n_tasks = g_wave_n_tasks( n );
+  for( int t = 0 ; t < n_tasks ; t++ )
+  {
+    g_wave_task* task = &(S->g_wave_queue[S->g_wave_tail++]) ;
+    task->k = k ;
+    task->h = h ;
+    task->first = (int)( (long)n*t/n_tasks ) ;
+    task->n = (int)( (long)n*(t+1)/n_tasks ) - task->first ;
+  }
+/*}}}*/
+}
 
-              for( int l0_prev = 0, l_prev = __min_l_prev ; l0_prev < __size_l0_prev ; l0_prev++, l_prev++ )
-              {
-                float** g_sj_prev = g_lsj_prev[l0_prev];
+/* The slabs (resp. the minima) of frame k are complete, called with
+ * g_wave_lock held */
+static void
+g_wave_complete( int k, char slabs )
+{
+/*{{{*/
+  if( slabs )
+  {
+    if( S->g_wave_check_dirty && k > S->g_check_dirty_frame )
+      memset( S->g_dirty_f[k], 1, S->g_n_cells_f[k] );
 
-                DEFINE_BOUNDS_s_prev( p, h2, l_prev );
+    if( S->USE_SPATIAL_INDEX && S->n_active_f[k] > 0 )
+    {
+      S->g_wave_remaining_f[k] = g_wave_n_tasks( S->n_active_f[k] ) ;
+      g_wave_push( k, -1 );
+      return ;
+    }
+  }
 
-                const int l = l_prev + delta_l ;
-                float** g_sj = g_lsj[l-__min_l] ;
+  /* Frame k is complete: queue the slabs depending on it */
+  S->g_wave_n_frames-- ;
+  P( "\b\b\b\b\b\b\b\b\b%03d / %03d", k, S->K-1 ); fflush(stdout) ;
 
-                DEFINE_MIN_s( k, h1, l );
+  for( int k2 = k+1 ; k2 <= min_i( S->g_wave_last_k, k+1+S->MAX_ALLOWED_HOLE_LENGTH ) ; k2++ )
+  {
+    DEFINE_MAX_h(k2);
+    const int h = k2-k-1 ;
+    if( h > __max_h || k2 < S->g_wave_first_k ) continue ;
+    g_wave_push( k2, h );
+    S->g_wave_remaining_f[k2] += g_wave_n_tasks( S->n_active_f[k2] ) - 1 ;
+    if( S->g_wave_remaining_f[k2] == 0 ) g_wave_complete( k2, TRUE );
+  }
+/*}}}*/
+}
 
-                for( int s0_prev = 0, s_prev = __min_s_prev ; s0_prev < __size_s0_prev ; s0_prev++, s_prev++ )
-                {
-                  float* g_j_prev = g_sj_prev[s0_prev];
+/* Thread pool job: each thread runs the ready tasks until all the frames are
+ * complete */
+static void
+g_wave__job( void* data, int i, int thread )
+{
+/*{{{*/
+  pthread_mutex_lock( &S->g_wave_lock );
+  while( TRUE )
+  {
+    while( S->g_wave_head == S->g_wave_tail && S->g_wave_n_frames > 0 )
+      pthread_cond_wait( &S->g_wave_ready, &S->g_wave_lock );
+    if( S->g_wave_head == S->g_wave_tail ) break ;
 
-                  DEFINE_BOUNDS_j_prev( p, h2, l_prev, s_prev );
+    const g_wave_task task = S->g_wave_queue[S->g_wave_head++] ;
+    pthread_mutex_unlock( &S->g_wave_lock );
 
-                  float* g_j_prev_first = &(g_j_prev[0]);
-                  float* g_j_prev_last = &(g_j_prev[__size_j0_prev]);
+    for( int i = task.first ; i < task.first + task.n ; i++ )
+    {
+      if( task.h < 0 )
+        S->g_kernel_zmin( task.k, S->active_fp[task.k][i] );
+      else
+        S->g_kernel( task.k, S->active_fp[task.k][i], task.h, thread );
+    }
 
-                  const int s = s_prev + 1 ;
-                  float* g_j = g_sj[s-__min_s] ;
-                  DEFINE_MIN_j( k, h, l, s );
+    pthread_mutex_lock( &S->g_wave_lock );
+    const int tail = S->g_wave_tail ;
+    if( --S->g_wave_remaining_f[task.k] == 0 )
+      g_wave_complete( task.k, task.h >= 0 );
+    if( S->g_wave_tail != tail || S->g_wave_n_frames == 0 )
+      pthread_cond_broadcast( &S->g_wave_ready );
+  }
+  pthread_mutex_unlock( &S->g_wave_lock );
+/*}}}*/
+}
 
-                  int j_fst = __min_j_prev + eps_j ; /* eps_j = 1 if there is a hole (h > 0) */
-                  float* g_j_cur = &(g_j[j_fst-__min_j]);
+/* Compute the G values of the frames first_k .. last_k in a wavefront */
+static void
+compute_frames__wavefront( int first_k, int last_k, char check_dirty )
+{
+/*{{{*/
+  S->g_wave_first_k = first_k ;
+  S->g_wave_last_k = last_k ;
+  S->g_wave_check_dirty = check_dirty ;
+  S->g_wave_n_frames = last_k - first_k + 1 ;
 
-                  for( float* g_j_prev_cur = g_j_prev_first ;
-                              g_j_prev_cur != g_j_prev_last ;
-                              g_j_prev_cur++, g_j_cur++ )
-                  {
-                    float delta_prev = *g_j_prev_cur ;
+  S->g_wave_remaining_f = (int*)calloc_or_die( S->K, sizeof(int) );
+  S->g_wave_head = S->g_wave_tail = 0 ;
 
-                    float updated_criterion = max_f(criterion, delta_prev);
+  /* The slabs not queued yet count as one task each */
+  size_t n_tasks = 0 ;
+  for( int k = first_k ; k <= last_k ; k++ )
+  {
+    DEFINE_MAX_h(k);
+    S->g_wave_remaining_f[k] = __max_h+1 ;
+    n_tasks += (size_t)(__max_h+2)*g_wave_n_tasks( S->n_active_f[k] ) ;
+  }
+  S->g_wave_queue = (g_wave_task*)calloc_or_die( n_tasks+1, sizeof(g_wave_task) );
 
-                    if( *g_j_cur > updated_criterion )
-                    {
-                        *g_j_cur = updated_criterion ;
-                    }
+  /* Queue the slabs depending on the frames before first_k */
+  for( int k = first_k ; k <= last_k ; k++ )
+  {
+    DEFINE_MAX_h(k);
+    for( int h = k-first_k ; h <= __max_h ; h++ )
+    {
+      g_wave_push( k, h );
+      S->g_wave_remaining_f[k] += g_wave_n_tasks( S->n_active_f[k] ) - 1 ;
+    }
+    if( S->g_wave_remaining_f[k] == 0 ) g_wave_complete( k, TRUE );
+  }
 
-                  } /* END foreach( RUNS j ) */
-                } /* END foreach( SIZE s ) */
-              } /* END foreach( LENGTH l ) */
-            } /* END foreach( POINT z IN FRAME q ) */
-          } /* END foreach( HOLE LENGTH h2 ) */
+  thread_pool_run( S->astre_thread_pool, S->N_THREADS, &g_wave__job, (void*)NULL );
 
-        END_FORALL_y
-      END_FORALL_h
-    END_FORALL_x
-  END_FORALL_k
+  free( S->g_wave_queue ); S->g_wave_queue = (g_wave_task*)NULL ;
+  free( S->g_wave_remaining_f ); S->g_wave_remaining_f = (int*)NULL ;
 /*}}}*/
 }
-#endif
+#endif // ASTRE_HAS_HOLES
 
-void
-my_points_desc_save_with_new_trajs( Rawdata raw_out, points_desc pd, trajs_file tf )
+/* Compute the G values of the frames up to last_k (K-1 but with a sliding
+ * window), the frames after the last computed one being computed for the
+ * first time */
+static void
+compute_most_significant_trajectories( int last_k )
 {
 /*{{{*/
-  points_desc pn = points_desc_copy( pd, 1 );
-
-  int n_field = pn->n_fields-1 ;
-  pn->tags[n_field] = C_string_dup("t");
+  /* G does not change before the first frame having a deactivated point */
+  int first_k = 1 ;
+  if( S->g_is_computed && S->INCREMENTAL_LEVEL >= 1 )
+    first_k = max_i( 1, S->g_first_dirty_frame+1 );
+  first_k = min_i( first_k, S->g_last_computed_frame+1 );
+
+  const char check_dirty = S->g_is_computed && S->INCREMENTAL_LEVEL >= 2 ;
+  if( check_dirty )
+  {
+    /* The frames that left the sliding window have no flags */
+    for( int k = 1 ; k < first_k && k <= last_k ; k++ )
+      if( S->g_dirty_f[k] ) memset( S->g_dirty_f[k], 0, S->g_n_cells_f[k] );
+  }
 
-  /* Tag trajectories */
-  points_desc_set_traj_tags( pn, tf, n_field );
+  S->g_first_dirty_frame = S->K ;
+  active_points_update();
 
-  char **captions = (char**)realloc_or_die(pn->header_captions, (pn->n_headers+tf->num_of_trajs)*sizeof(char*));
-  pn->header_captions = captions;
-  char **contents =  (char**)realloc_or_die(pn->header_contents, (pn->n_headers+tf->num_of_trajs)*sizeof(char*));
-  pn->header_contents = contents;
+  /* A frame computed for the first time has no values to check, and all its
+   * cells are new */
+  S->g_check_dirty_frame = check_dirty ? S->g_last_computed_frame : 0 ;
 
-  for( int i = 0 ; i < tf->num_of_trajs ; i++ )
-  {
-      char buf[256]; sprintf(buf, "traj:%d:lNFA", i);
-      pn->header_captions[pn->n_headers + i] = C_string_dup(buf);
-      pn->header_contents[pn->n_headers + i] = C_string_dup(tf->trajs[i].data);
-  }
-  pn->n_headers += tf->num_of_trajs;
+  P( "  -- k = 000 / 000" );
+#ifdef ASTRE_HAS_HOLES
+  if( S->N_THREADS > 1 && first_k < last_k )
+    compute_frames__wavefront( first_k, last_k, check_dirty );
+  else
+#endif
+    compute_frames( first_k, last_k, check_dirty );
 
-  /* Save points_desc */
-  points_desc_save( raw_out, pn );
+  g_candidates_merge( first_k );
+  S->g_is_computed = TRUE ;
+  S->g_last_computed_frame = max_i( S->g_last_computed_frame, last_k );
 
-  /* Free memory */
-  points_desc_free_all( &pn );
+  P("\n");
 /*}}}*/
 }
 
@@ -1043,31 +1937,186 @@ my_points_desc_save_with_new_trajs( Rawdata raw_out, points_desc pd, trajs_file
 
 *******************************************************************************/
 
-void
+static void
+save_partial_results()
+{
+/*{{{*/
+  if( !S->partial_results_fname ) return ;
+
+  P( " > saving to temporary file %s...\n", S->partial_results_fname );
+  Rawdata rd = new_rawdata_or_die();
+  S->tf->num_of_trajs = S->trajectory_store->num_trajs ;
+  S->tf->trajs = S->trajectory_store->trajs ;
+  astre_points_desc_save_with_trajs( rd, S->pd, S->tf );
+  save_rawdata( rd, S->partial_results_fname );
+  mw_delete_rawdata( rd ); rd = (Rawdata)NULL ;
+/*}}}*/
+}
+
+static void
 do_detect()
 {
 /*{{{*/
   while( TRUE )
   {
     P( " > computing..." ); fflush( stdout );
-    compute_most_significant_trajectories() ;
+    compute_most_significant_trajectories( S->K-1 ) ;
     P( "done!\n" );
 
     P( " > extracting...\n" );
-    char cont = extract_and_disable_most_significant_trajectories() ;
+    char cont = extract_and_disable_most_significant_trajectories( S->K-1 ) ;
     if( !cont ) break ;
 
-    if( partial_results_fname )
-    {
-      P( " > saving to temporary file %s...\n", partial_results_fname );
-      Rawdata rd = new_rawdata_or_die();
-      tf->num_of_trajs = trajectory_store->num_trajs ;
-      tf->trajs = trajectory_store->trajs ;
-      my_points_desc_save_with_new_trajs( rd, pd, tf );
-      save_rawdata( rd, partial_results_fname );
-      mw_delete_rawdata( rd ); rd = (Rawdata)NULL ;
-    }
+    save_partial_results();
+  }
+/*}}}*/
+}
+
+/* Detection with a sliding window: the frames enter the window one after the
+ * other, and the trajectories are extracted as soon as they are settled, see
+ * the extraction with a sliding window */
+static void
+do_detect_windowed()
+{
+/*{{{*/
+  for( int k = 1 ; k < S->K ; k++ )
+  {
+    g_window_advance( k );
+    const int n_trajs = S->trajectory_store->num_trajs ;
+
+    P( " > computing frame %d...", k ); fflush( stdout );
+    compute_most_significant_trajectories( k );
+    P( "done!\n" );
+
+    P( " > extracting...\n" );
+    while( extract_and_disable_most_significant_trajectories( k ) )
+      compute_most_significant_trajectories( k );
+
+    if( S->trajectory_store->num_trajs > n_trajs ) save_partial_results();
+  }
+/*}}}*/
+}
+
+/*******************************************************************************
+
+        Streaming detection.
+
+        The frames are read one after the other from the stream, and enter
+        the sliding window once their points are known: the values depending
+        on the points of frame k (coordinates, active points, LOG_Nprod of
+        the trajectories ending at frame k, grid, links, sizes of G...) are
+        then computed by astre_frame_init. Each extracted trajectory is
+        written at once, as a comment line "# traj:<i>:lNFA = <lNFA>"
+        followed by the data lines of its points, tagged with t:<i>: the
+        output is a PointsFile of the points of the trajectories.
+
+        The frames before g_window_first_frame - 2*(max_h+1) are no longer
+        read by the computation of G nor by the extraction (see
+        g_window_advance), and are retired by astre_frame_retire, with their
+        points.
+
+*******************************************************************************/
+
+/* The points of frame k are known */
+static void
+astre_frame_init( int k )
+{
+/*{{{*/
+  points_xy_init_frame( k );
+  activated_fp_init_frame( k );
+  log_nprod_init_frame( k );
+  if( S->points_grid_f ) points_grid_init_frame( k );
+  g_window_init_frame( k );
+  if( k == 0 ) return ;
+
+  g_links_init_frame( k );
+  g_store_init_frame( k );
+  g_max_codes_init_frame( k );
+/*}}}*/
+}
+
+/* Free the values and the points of frame k */
+static void
+astre_frame_retire( int k )
+{
+/*{{{*/
+  g_max_codes_free_frame( k );
+  g_store_free_frame( k );
+  g_links_free_frame( k );
+  g_window_free_frame( k );
+  if( S->points_grid_f ) points_grid_free_frame( k );
+  log_nprod_free_frame( k );
+  activated_fp_free_frame( k );
+  points_xy_free_frame( k );
+  free( S->pd->points[k] ); S->pd->points[k] = (double*)NULL ;
+/*}}}*/
+}
+
+/* Write the trajectories of the store, which are then freed, the first one
+ * being the trajectory *n_written */
+static void
+astre_stream_write_trajectories( FILE* out, int* n_written )
+{
+/*{{{*/
+  for( int i = 0 ; i < S->trajectory_store->num_trajs ; i++ )
+  {
+    traj* tt = &(S->trajectory_store->trajs[i]) ;
+    const int t = (*n_written)++ ;
+
+    astre_stream_write_traj( out, S->pd, tt, t );
+
+    free( tt->type ); tt->type = (int*)NULL ;
+    free( tt->points ); tt->points = (ref_point*)NULL ;
+    free( tt->data ); tt->data = NULL ;
+  }
+  S->trajectory_store->num_trajs = 0 ;
+  fflush( out );
+/*}}}*/
+}
+
+static void
+do_detect_stream( points_desc_stream stream, FILE* out )
+{
+/*{{{*/
+#ifdef ASTRE_HAS_NO_HOLES
+  const int max_h = 0 ;
+#endif
+#ifdef ASTRE_HAS_HOLES
+  const int max_h = S->MAX_ALLOWED_HOLE_LENGTH ;
+#endif
+  int n_written = 0 ;
+  int first_frame = 0 ;                 /* first frame that was not retired */
+
+  points_desc_write_headers( out, S->pd );
+  fflush( out );
+
+  for( int k = 0 ; points_desc_stream_read_frame( stream ) ; k++ )
+  {
+    P( " > frame %d: %d points\n", k, S->n_points_in_frame[k] );
+    astre_frame_init( k );
+    if( k == 0 ) continue ;
+
+    /* Every candidate is settled at the end of the stream */
+    if( !stream->has_pending )
+      S->g_window_last_frame = min_i( S->g_window_last_frame, k );
+
+    g_window_advance( k );
+
+    P( " > computing frame %d...", k ); fflush( stdout );
+    compute_most_significant_trajectories( k );
+    P( "done!\n" );
+
+    P( " > extracting...\n" );
+    while( extract_and_disable_most_significant_trajectories( k ) )
+      compute_most_significant_trajectories( k );
+    astre_stream_write_trajectories( out, &n_written );
+
+    for( ; first_frame < S->g_window_first_frame - 2*(max_h+1) ; first_frame++ )
+      astre_frame_retire( first_frame );
   }
+
+  free( S->trajectory_store->trajs ); S->trajectory_store->trajs = (traj*)NULL ;
+  S->trajectory_store->allocated_trajs = 0 ;
 /*}}}*/
 }
 
@@ -1098,7 +2147,7 @@ inline static float __astre_get_point_coordinate
   else
   {
     int idx = pt->r ;
-    return points[k][idx*n_fields+coord] ;
+    return coord == 0 ? S->points_x_f[k][idx] : S->points_y_f[k][idx] ;
   }
 /*}}}*/
 }
@@ -1121,7 +2170,7 @@ inline static int __astre_get_point_ref
 }
 
 /* Replace all interpolated points by holes */
-void compute_caracteristics_of_trajectory( int starting_frame, int length, int* type, union u_ref_point* points, float* o_delta, int* o_s, int* o_j )
+static void compute_caracteristics_of_trajectory( int starting_frame, int length, int* type, union u_ref_point* points, float* o_delta, int* o_s, int* o_j )
 {
 /*{{{*/
   if( type[0] != PRTYPE_REF || type[length-1] != PRTYPE_REF || length < 2 )
@@ -1214,7 +2263,7 @@ void compute_caracteristics_of_trajectory( int starting_frame, int length, int*
 }
 
 /* Replace all interpolated points by holes */
-double compute_log_NFA_of_trajectory( int starting_frame, int length, int* type, union u_ref_point* points )
+static double compute_log_NFA_of_trajectory( int starting_frame, int length, int* type, union u_ref_point* points )
 {
   float delta = -1.0 ;
   int s = -1, j = -1 ;
@@ -1230,29 +2279,6 @@ double compute_log_NFA_of_trajectory( int starting_frame, int length, int* type,
   return lNFA ;
 }
 
-void info_on_traj( char* str )
-{
-  traj* tt = read_trajectory_descriptor( str );
-
-  float delta ;
-  int s, j ;
-  compute_caracteristics_of_trajectory( tt->starting_frame, tt->length, tt->type, tt->points,
-      &delta, &s, &j );
-  int kl = tt->starting_frame + tt->length - 1 ;
-#ifdef ASTRE_HAS_NO_HOLES
-  double lNFA = log_NFA( kl, delta, tt->length );
-#else
-  double lNFA = log_NFA( kl, delta, tt->length, s, j );
-#endif
-
-  P(" traj: lNFA(%g)  start(%d) delta(%g) len(%d) size(%d) runs(%d)\n",
-      lNFA, tt->starting_frame, delta, tt->length, s, j );
-
-  free( tt->type );
-  free( tt->points );
-  free( tt );
-}
-
 /*******************************************************************************
 
         Restart computation from trajectories
@@ -1262,36 +2288,22 @@ void info_on_traj( char* str )
         trajectory detection problem.
 
 *******************************************************************************/
-void
-astre__restart_trajectories( points_desc restart )
+static void
+astre__restart_trajectories( trajs_file rf )
 {
-  if( restart->uid != pd->uid )
-  {
-    C_log_error( "Restart file UID does not match Pointsdesc file UID!\n" );
-    exit(-1);
-  }
-
-  if( restart->n_fields < 3 )
-  {
-    C_log_error( "Restart file has no trajectory field!\n" );
-    exit(-1);
-  }
-
-  trajs_file rf = points_desc_extract_trajs( restart, -1, FALSE );
-
   for( int k = 0 ; k < rf->num_of_trajs ; k++ )
   {
     traj* tt = &(rf->trajs[k]);
     double lNFA = compute_log_NFA_of_trajectory( tt->starting_frame, tt->length, tt->type, tt->points );
     char buf[256]; sprintf(buf, "%g", lNFA);
     tt->data = strdup(buf);
-    add_traj( trajectory_store, tt->starting_frame, tt->length, tt->type, tt->points, tt->data );
+    add_traj( S->trajectory_store, tt->starting_frame, tt->length, tt->type, tt->points, tt->data );
     /* Deactivate points */
     for( int p = 0 ; p < tt->length ; p++ )
     {
       if( tt->type[p] == PRTYPE_REF )
       {
-        if( !activated_fp[p+tt->starting_frame][tt->points[p].r] )
+        if( !S->activated_fp[p+tt->starting_frame][tt->points[p].r] )
         {
           C_log_error(
               "Error while loading restart trajectories: "
@@ -1299,7 +2311,7 @@ astre__restart_trajectories( points_desc restart )
           );
           exit(-1);
         }
-        activated_fp[p+tt->starting_frame][tt->points[p].r] = FALSE ;
+        deactivate_point( p+tt->starting_frame, tt->points[p].r );
       }
 #ifdef ASTRE_HAS_NO_HOLES
       else
@@ -1323,60 +2335,41 @@ astre__restart_trajectories( points_desc restart )
 
         Main ASTRE function
 
-        i_pd   : Input Pointsdesc
-        o_pd   : Output Pointsdesc, with an additional column for found trajectories
-        i_e    : Maximal allowed value of log(NFA)
-        i_h    : Maximal allowed length of a hole (-1: any length)
-        r_pd   : Partial Pointsdesc to resume from, or NULL
-        partial_fname : File where we save partial computations, or NULL
-        just_tag_trajectories : tag trajectories with their NFA and exit
-        auto_crop : crop each image to its bounding-box
-        parameters : optionnal parameters defined by each algorithm
-
-*******************************************************************************/
-void
-astre
-(
-    Rawdata i_pd,
-    Rawdata o_pd,
-    float i_e,
-    int i_h,
-    Rawdata r_pd,
-    char* partial_fname,
-    char just_tag_trajectories,
-    char auto_crop,
-    astre_parameters parameters
-)
-{
-  pd = points_desc_load ( i_pd ) ;
-  tf = trajs_file_new() ;
-
-  if( pd->n_frames < 3 )
-  {
-    C_log_error("Not enough frames available for a trajectory search!\n");
-    exit(-1);
-  }
-
-  MAX_ALLOWED_LOG_NFA = i_e ;
+        The entry points of the engine (see astre_engine), the parameters
+        being resolved, and the precomputed values computed, by astre_ctx_new.
 
-  if( MAX_ALLOWED_TRAJECTORY_LENGTH == 0 )
-    MAX_ALLOWED_TRAJECTORY_LENGTH = pd->n_frames ;
+        ctx     : Context of the detection, the trajectories found being
+                  moved to ctx->tf
+        restart : Partial Pointsdesc to resume from (checked by astre_run),
+                  or NULL
 
-#ifdef ASTRE_HAS_HOLES
-  MAX_ALLOWED_HOLE_LENGTH = i_h ;
-  if( MAX_ALLOWED_HOLE_LENGTH < 0 )
-    MAX_ALLOWED_HOLE_LENGTH = pd->n_frames-3 ;
-#endif
+        Each entry point makes the state of ctx the current state of the
+        calling thread for the duration of the detection.
 
-  partial_results_fname = partial_fname ;
+*******************************************************************************/
 
-  P( " ------------------------------------------------\n");
-  P( "  MAXIMAL log(NFA) = %g\n", MAX_ALLOWED_LOG_NFA );
-  P( "  MAXIMAL TRAJECTORY LENGTH = %d\n", MAX_ALLOWED_TRAJECTORY_LENGTH );
+/* Set the parameters, once they are resolved */
+static void
+astre__set_parameters( const astre_options* o )
+{
+/*{{{*/
+  S->MAX_ALLOWED_LOG_NFA = o->e ;
+  S->MAX_ALLOWED_TRAJECTORY_LENGTH = o->l ;
+  S->SLIDING_WINDOW = o->sliding_window ;
+  S->WINDOW_LATENCY = o->latency ;
+  S->STREAMING = o->streaming ;
 #ifdef ASTRE_HAS_HOLES
-  P( "  MAXIMAL HOLE LENGTH = %d\n", MAX_ALLOWED_HOLE_LENGTH );
+  S->MAX_ALLOWED_HOLE_LENGTH = o->h ;
 #endif
-  P( " ------------------------------------------------\n");
+  S->N_THREADS = o->threads ;
+  S->G_USE_HUGE_PAGES = o->huge_pages ;
+  S->INCREMENTAL_LEVEL = o->incremental ;
+  S->USE_SPATIAL_INDEX = o->spatial_index ;
+  S->MAX_DISPLACEMENT = o->max_displacement ;
+  S->SIMD_LEVEL = o->simd ;
+  S->EXTRACT_PAST_CONFLICTS = o->past_conflicts ;
+  S->QUIET = o->quiet ;
+  S->partial_results_fname = o->partial_fname ;
 
 #ifdef ALL_CHECKS
   P( "\n\n" );
@@ -1384,33 +2377,101 @@ astre
   P( "  WARNING: ALL_CHECKS is set!\n" );
   P( " ------------------------------------------------\n");
 #endif
+/*}}}*/
+}
+
+/* Free the structures of the computation of G */
+static void
+astre__free_engine()
+{
+/*{{{*/
+  g_candidates_free();
+  points_grid_free();
+  g_max_codes_free();
+  g_store_free();
+  g_window_free();
+  g_links_free();
+  g_codes_free();
+/*}}}*/
+}
+
+/* Free the precomputed values and the points */
+static void
+astre__free_precomputations()
+{
+/*{{{*/
+  ASTRE__DEINITIALIZATION ;
+  thread_pool_free_all( &S->astre_thread_pool );
+  precomputations_detach();
+  points_xy_free();
+  free( S->trajectory_store );
+  discrete_area_free();
+  activated_fp_free();
+  log_nprod_free();
+/*}}}*/
+}
+
+/* Create the worker threads first, as the detection cannot run without them:
+ * return -1 if they cannot be created */
+static int
+astre__thread_pool_init()
+{
+/*{{{*/
+  S->astre_thread_pool = thread_pool_new_with_init( S->N_THREADS, &astre_state_bind_worker, S );
+  return S->astre_thread_pool ? 0 : -1 ;
+/*}}}*/
+}
+
+static void*
+astre__state_new()
+{
+  return astre_state_new();
+}
+
+static void
+astre__state_free( void* state )
+{
+  astre_state_free( (astre_state*)state );
+}
+
+static int
+astre__detect( astre_ctx ctx, points_desc restart )
+{
+  astre_state* caller_state = astre_state_attach( ctx );
+  const astre_options* o = &(ctx->o);
+
+  astre__set_parameters( o );
+  if( astre__thread_pool_init() != 0 )
+  {
+    astre_state_detach( caller_state );
+    return -1 ;
+  }
 
   /*                     Initialize the algorithm variables */
   /* ------------------------------------------------------ */
   P( " > Initialization...\n" );
 
-  n_points_in_frame = pd->n_points_in_frame ;
-  points = pd->points ;
-  n_fields = pd->n_fields ;
+  S->K = S->pd->n_frames ;
+  P( " > Number of frames K = %d\n", S->K );
 
-  K = pd->n_frames ;
-  P( " > Number of frames K = %d\n", K );
+  S->N = 0 ;
+  for( int k = 0 ; k < S->K ; k++ ) S->N = max_ui( S->N, S->n_points_in_frame[k] );
+  P( " > Maximal number of points N = %d\n", S->N );
 
-  N = 0 ;
-  for( int k = 0 ; k < K ; k++ ) N = max_ui( N, n_points_in_frame[k] );
-  P( " > Maximal number of points N = %d\n", N );
-
-  int nr = pd->height ;
-  int nc = pd->width ;
-  precompute_image_areas(nr*nc, auto_crop);
+  precomputations_attach( ctx );
+  points_xy_init();
 
   /* Precomputed values */
-  LOG_K = log10(K);
-  LOG_N = log10(N);
-  precompute_log_k();
-  precompute_log_cnk();
-  precompute_log_kfact();
-  precompute_log_nprod();
+  S->LOG_K = log10(S->K);
+  S->LOG_N = log10(S->N);
+  /* The trajectories to tag, or to restart from, which may be longer than
+   * the maximal trajectory length */
+  trajs_file rf = (trajs_file)NULL ;
+  if( o->just_tag_trajectories )
+    rf = points_desc_extract_trajs( S->pd, -1, FALSE );
+  else if( restart )
+    rf = points_desc_extract_trajs( restart, -1, FALSE );
+  precompute_log_nprod( rf );
   discrete_area_init( 50 );
 
   activated_fp_init();
@@ -1418,99 +2479,27 @@ astre
 
   ASTRE__INITIALIZATION ;
 
-  if( just_tag_trajectories )
+  if( o->just_tag_trajectories )
   {
-    astre__restart_trajectories( pd );
+    astre__restart_trajectories( rf );
     goto astre__SaveTrajectories ;
   }
 
-#ifdef ASTRE_HAS_NO_HOLES
-  DEFINE_MAX_k ;
-  g_fxl = (float***)calloc_or_die( __max_k+1, sizeof(float**) );
-  g_fxl[0] = (float**)NULL ;
-  for( int k = 1 ; k <= __max_k ; k++ )
-  {
-    DEFINE_MAX_x(k);
-    const int p = k-1 ;
-    DEFINE_MAX_y(p);
-    DEFINE_BOUNDS_l(k);
-
-    g_fxl[k] =
-      (float**)calloc_or_die( N*N, sizeof(float*) );
-
-    for( int x = 0 ; x <= __max_x ; x++ )
-    {
-      int x_idx = x*N ;
-
-      for( int y = 0 ; y <= __max_y ; y++ )
-      {
-        int xy_idx = x_idx + y ;
-
-        g_fxl[k][xy_idx] =
-          (float*)calloc_or_die( __size_l0, sizeof(float) );
-      }
-    }
-  }
-#endif
-#ifdef ASTRE_HAS_HOLES
-  DEFINE_MAX_k ;
-  g_fxlsj = (float*****)calloc_or_die( __max_k+1, sizeof(float****) );
-  g_fxlsj[0] = (float****)NULL ;
-  for( int k = 1 ; k <= __max_k ; k++ )
-  {
-    DEFINE_MAX_x(k);
-    DEFINE_MAX_h(k);
-
-    g_fxlsj[k] =
-      (float****)calloc_or_die( N*N*(__max_h+1), sizeof(float***) );
-
-    for( int x = 0 ; x <= __max_x ; x++ )
-    {
-      int x_idx = x*N*(__max_h+1) ;
-
-      for( int h = 0 ; h <= __max_h ; h++ )
-      {
-        int xh_idx = x_idx + h*N ;
-
-        const int p = k-h-1 ;
-        DEFINE_MAX_y(p);
-        DEFINE_BOUNDS_l(k,h);
-
-        for( int y = 0 ; y <= __max_y ; y++ )
-        {
-          int xhy_idx = xh_idx + y ;
-
-          g_fxlsj[k][xhy_idx] =
-            (float***)calloc_or_die( __size_l0, sizeof(float**) );
-
-          for( int l0 = 0, l = __min_l ; l0 < __size_l0 ; l0++, l++ )
-          {
-            DEFINE_BOUNDS_s( k, h, l );
-
-            g_fxlsj[k][xhy_idx][l0] =
-              (float**)calloc_or_die( __size_s0, sizeof(float*) );
-
-            for( int s0 = 0, s = __min_s ; s0 < __size_s0 ; s0++, s++ )
-            {
-              DEFINE_BOUNDS_j( k, h, l, s );
-
-              g_fxlsj[k][xhy_idx][l0][s0] =
-                (float*)calloc_or_die( __size_j0, sizeof(float) );
-            }
-          }
-        }
-      }
-    }
-  }
-#endif
+  g_codes_init();
+  P( " > Criterion and argmin codes: %d bits, %s\n", S->G_CODE_BITS,
+     S->G_CODES_ARE_AREAS ? "discrete areas" : "normalized areas" );
+  g_kernels_init();
+  P( " > Kernels: %s\n", G_SIMD_NAMES[S->SIMD_LEVEL] );
+  if( S->USE_SPATIAL_INDEX || S->MAX_DISPLACEMENT > 0 ) points_grid_init();
+  g_links_init();
+  if( S->SLIDING_WINDOW ) g_window_init();
+  g_store_init();
+  g_max_codes_init();
+  g_candidates_init();
 
   /* Restart */
-  if( r_pd )
-  {
-    points_desc restart = points_desc_load( r_pd );
-    astre__restart_trajectories( restart );
-    points_desc_free_all( &restart );
-  }
+  if( rf )
+    astre__restart_trajectories( rf );
 
   /*                  Run the dynamic programming algorithm */
   /* ------------------------------------------------------ */
@@ -1519,136 +2508,127 @@ astre
      * about certain trajectories */
   ASTRE__SHOW_INFORMATIONS ;
 #else
-  do_detect();
+  if( S->SLIDING_WINDOW )
+    do_detect_windowed();
+  else
+    do_detect();
 #endif
 
   /*                                            Free memory */
   /* ------------------------------------------------------ */
-  /* TODO: free G array */
+  astre__free_engine();
 
-  /*                                  Save the trajectories */
+  /*                      Move the trajectories to ctx->tf */
   /* ------------------------------------------------------ */
 astre__SaveTrajectories:
-  tf->num_of_trajs = trajectory_store->num_trajs ;
-  tf->trajs = trajectory_store->trajs ;
-  my_points_desc_save_with_new_trajs( o_pd, pd, tf );
-  trajectory_store->allocated_trajs = 0 ;
-  trajectory_store->num_trajs = 0 ;
-  trajectory_store->trajs = (traj*)NULL ;
-
-  for( int i = 0 ; i < tf->num_of_trajs ; i++ )
-  {
-      free( tf->trajs[i].data );
-  }
+  S->tf->num_of_trajs = S->trajectory_store->num_trajs ;
+  S->tf->trajs = S->trajectory_store->trajs ;
+  S->trajectory_store->allocated_trajs = 0 ;
+  S->trajectory_store->num_trajs = 0 ;
+  S->trajectory_store->trajs = (traj*)NULL ;
 
   /*                                            Free memory */
   /* ------------------------------------------------------ */
-  ASTRE__DEINITIALIZATION ;
-  free_image_areas();
-  free( trajectory_store );
-  discrete_area_free();
-  activated_fp_free();
-  free( LOG_k ); LOG_k = (double*)NULL ;
-  free( LOG_Cnk ); LOG_Cnk = (double*)NULL ;
-  free( LOG_Kfact ); LOG_Kfact = (double*)NULL ;
-  log_nprod_free();
-  points_desc_free_all( &pd );
-  trajs_file_free_all( &tf );
+  astre__free_precomputations();
+  astre_state_detach( caller_state );
+  return 0 ;
 }
 
 /*******************************************************************************
 
-        Command-line parsing
+        Streaming ASTRE function
+
+        Detect the trajectories of a stream of points (see points_desc_stream)
+        with a sliding window: the trajectories are written to out as soon as
+        they are extracted (see do_detect_stream), and the frames are retired
+        once they left the window.
 
 *******************************************************************************/
-int main( int ARGC, char** ARGV )
+static int
+astre__detect_stream( astre_ctx ctx, points_desc_stream stream, FILE* out )
 {
-  arg_parser ap = arg_parser_new();
-
-  arg_parser_set_info( ap, main__help_msg );
-
-  struct arg_str *p_in = arg_str1( NULL, NULL, "in", "Input points file" );
-  arg_parser_add( ap, p_in );
+  astre_state* caller_state = astre_state_attach( ctx );
 
-  struct arg_str *p_out = arg_str1( NULL, NULL, "out", "Output points file" );
-  arg_parser_add( ap, p_out );
+  astre__set_parameters( &(ctx->o) );
+  if( astre__thread_pool_init() != 0 )
+  {
+    S->STREAMING = FALSE ;
+    astre_state_detach( caller_state );
+    return -1 ;
+  }
 
-  struct arg_dbl *p_e = arg_dbl0( "e", "epsilon", "<e>",
-      "Maximal allowed log(NFA) (default: 0)" );
-  if( p_e ) p_e->dval[0] = 0.0 ;
-  arg_parser_add( ap, p_e );
+  /*                     Initialize the algorithm variables */
+  /* ------------------------------------------------------ */
+  P( " > Initialization...\n" );
 
-  astre_parameters parameters ;
+  S->K = S->pd->n_frames ;
+  P( " > Number of frames K = %d\n", S->K );
 
-#ifdef ASTRE_HAS_HOLES
-  struct arg_int *p_h = arg_int0( "h", "max-hole-length", "<h>", "Maximal allowed hole length (default: -1, any length)" );
-  if( p_h ) p_h->ival[0] = -1 ;
-  arg_parser_add( ap, p_h );
+  /* The number of points of the next frames is unknown: the codes h2*N+z of
+   * the argmins use the largest N */
+#ifdef ASTRE_HAS_NO_HOLES
+  S->N = INT_MAX ;
 #endif
-
-  struct arg_str *p_r = arg_str0( "r", "restart", "<r>",
-      "Restart trajectory detection from partial detections "
-      "(trajectories are assumed to be in the last column)" );
-  arg_parser_add( ap, p_r );
-
-  struct arg_str *p_s = arg_str0( "s", "save-partial", "<s>", "Save partial detections" );
-  arg_parser_add( ap, p_s );
-
-
-  struct arg_lit *p_N = arg_lit0( NULL, "tag-NFA",
-      "Tag the trajectories in file <in> with their NFA and quit" );
-  arg_parser_add( ap, p_N );
-
-  struct arg_lit *p_c = arg_lit0( NULL, "auto-crop", "Auto-crop images to their bounding-box" );
-  arg_parser_add( ap, p_c );
-
-  MAIN__DEFINE_ARGUMENTS ;
-
-  /* Handle arguments */
-  arg_parser_handle( ap, ARGC, ARGV );
-
-  /* Check arguments */
-  char* in = (char*)p_in->sval[0]; C_assert( in && strlen(in) > 0 );
-  char* out = (char*)p_out->sval[0]; C_assert( out && strlen(out) > 0 );
-  double e = p_e->dval[0];
 #ifdef ASTRE_HAS_HOLES
-  int h = p_h->ival[0];
-#else
-  int h = 0 ;
+  S->N = INT_MAX / (min_i( S->K-2, S->MAX_ALLOWED_HOLE_LENGTH )+1) ;
 #endif
 
-  Rawdata rd_in = load_rawdata( in );
-  Rawdata rd_out = new_rawdata_or_die();
+  precomputations_attach( ctx );
+  points_xy_init_arrays();
 
-  Rawdata rd_restart = (Rawdata)NULL ;
-  if( p_r->count > 0 )
-    rd_restart = load_rawdata( (char*)p_r->sval[0] );
+  /* Precomputed values, LOG_Nprod being computed with the frames */
+  S->LOG_K = log10(S->K);
+  S->LOG_N = log10(S->N);
+  log_nprod_init_arrays( (trajs_file)NULL );
+  discrete_area_init( 50 );
+
+  activated_fp_init_arrays();
+  traj_store_init(200); /* Allocate a trajectory store of 200 trajectories */
 
-  char just_tag_trajectories = p_N->count > 0 ;
-  char crop = p_c->count > 0 ;
+  ASTRE__INITIALIZATION ;
 
-  char* save_partial = (char*)NULL ;
-  if( p_s->count > 0 )
-    save_partial = (char*)p_s->sval[0] ;
-  C_assert( !save_partial || strlen(save_partial) > 0 );
+  g_codes_init();
+  P( " > Criterion and argmin codes: %d bits, %s\n", S->G_CODE_BITS,
+     S->G_CODES_ARE_AREAS ? "discrete areas" : "normalized areas" );
+  g_kernels_init();
+  P( " > Kernels: %s\n", G_SIMD_NAMES[S->SIMD_LEVEL] );
+  if( S->USE_SPATIAL_INDEX || S->MAX_DISPLACEMENT > 0 ) points_grid_init_arrays();
+  g_links_init_arrays();
+  g_window_init();
+  g_store_init_arrays();
+  g_max_codes_init_arrays();
+  g_candidates_init();
 
-  MAIN__VERIFY_ARGUMENTS ;
+  /*                  Run the dynamic programming algorithm */
+  /* ------------------------------------------------------ */
+  do_detect_stream( stream, out );
 
-  astre( rd_in, rd_out,
-           e, h,
-           rd_restart, save_partial,
-           just_tag_trajectories, crop,
-           parameters
-  );
+  /*                                            Free memory */
+  /* ------------------------------------------------------ */
+  astre__free_engine();
+  astre__free_precomputations();
+  S->STREAMING = FALSE ;
+  astre_state_detach( caller_state );
+  return 0 ;
+}
 
-  save_rawdata( rd_out, out );
+/*******************************************************************************
 
-  MAIN__AFTER_PROCESSING ;
+        Engine
 
-  mw_delete_rawdata( rd_in );
-  mw_delete_rawdata( rd_out );
-  if( rd_restart ) mw_delete_rawdata( rd_restart );
+        Only the engine is visible outside of this file: both engines are
+        linked in the same library, and each context has its own state.
 
-  /* Clean memory */
-  arg_parser_free_all( &ap );
-}
+*******************************************************************************/
+#ifdef ASTRE_HAS_NO_HOLES
+const astre_engine astre_engine_noholes = {
+  "noholes", FALSE, &astre__state_new, &astre__state_free,
+  &astre__detect, &astre__detect_stream
+} ;
+#endif
+#ifdef ASTRE_HAS_HOLES
+const astre_engine astre_engine_holes = {
+  "holes", TRUE, &astre__state_new, &astre__state_free,
+  &astre__detect, &astre__detect_stream
+} ;
+#endif
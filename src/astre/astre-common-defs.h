@@ -23,6 +23,15 @@
 #include <vision/math/combinatorics.h>
 #include <vision/trajs/pointsdesc.h>
 #include <vision/trajs/trajs.h>
+#include <vision/utils/threadpool.h>
+#include <astre/astre.h>
+#include <limits.h>
+#include <sys/mman.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+ #define ASTRE_HAS_X86_SIMD
+ #include <immintrin.h>
+#endif
 
 #ifdef ASTRE_HAS_HOLES
  #undef ASTRE_HAS_NO_HOLES
@@ -67,24 +76,90 @@ static const float INFTY = 1E18 ;
 /* This is the precision used when comparing log NFAs */
 static const double LOG_NFA_COMP_EPS = 1E-5 ;
 
-static points_desc pd ;
-static trajs_file tf ;
-static int n_fields ;                           /* quick access to pd->n_fields */
-static int *n_points_in_frame ;            /* quick access to pd->n_points_in_frame */
-static double **points ;                        /* quick access to pd->points */
+/*******************************************************************************
+
+        Types of the state, see their description in the sections below.
+
+*******************************************************************************/
+
+#ifdef ASTRE_HAS_HOLES
+typedef struct
+{
+  double* v ;                   /* v[l*(l+1)/2 + s], l = 0 .. n_l-1, s = 0 .. l */
+  double* interior ;            /* N_i of the frames k+1 .. k+n_l-2, decreasing */
+  int n_l ;                     /* # of lengths computed */
+  int max_l ;                   /* maximal length */
+} log_nprod_row ;
+#endif
+
+typedef struct
+{
+  double x0, y0 ;                       /* origin of the grid */
+  double size ;                         /* side of a cell */
+  int nx, ny ;                          /* number of cells */
+  int* cell_start ;                     /* nx*ny+1 first points of the cells */
+  int* idx ;                            /* points, sorted by cell */
+  float* xy ;                           /* coordinates of the sorted points */
+} points_grid ;
+
+typedef struct
+{
+  double lNFA ;
+  size_t i ;                            /* index of the G value in frame k */
+  int k, x, y ;
+  short h, l, s, j ;
+} g_candidate ;
 
-static double* IMAGE_AREA ;
-static int N ;                                  /* maximal number of points in a frame */
-static int K ;                                  /* number of frames */
+typedef struct
+{
+  g_candidate* data ;
+  size_t n ;
+  size_t allocated ;
+  double min_lNFA ;                     /* running minimum of the log(NFA) */
+} g_candidates ;
+
+typedef struct
+{
+  void* data ;
+  size_t mapped ;                               /* see g_arena_alloc */
+  size_t size ;                                 /* allocated bytes */
+} g_window_buffer ;
 
-static double* LOG_IMAGE_AREA ;                 /* log( IMAGE_AREA ) */
-static double LOG_N ;                           /* log( N ) */
-static double LOG_K ;                           /* log( K ) */
+typedef struct
+{
+  g_window_buffer arena, bp, dirty, zmin ;
+} g_window_slot ;
 
+/* Kernels used for the type of codes and the instruction set, selected by
+ * g_kernels_init() */
+#ifdef ASTRE_HAS_NO_HOLES
+typedef void (*g_kernel_fn)( int k, int x, int thread );
+#endif
+#ifdef ASTRE_HAS_HOLES
+typedef void (*g_kernel_fn)( int k, int x, int h, int thread );
+#endif
+typedef void (*g_kernel_zmin_fn)( int p, int y );
 
+#ifdef ASTRE_HAS_HOLES
+typedef struct
+{
+  int k ;               /* frame */
+  int h ;               /* hole length of the slab, -1 for the minima over z */
+  int first, n ;        /* active points x (resp. y) of the task */
+} g_wave_task ;
+#endif
 
 /*******************************************************************************
 
+        State of a detection.
+
+        The whole state of a detection is held in an astre_state, so that
+        several detections may run at the same time in the same process (see
+        astre_ctx). The functions of the engine reach the state of the
+        current detection through S, a thread-local pointer set by the entry
+        points of the engine and by the workers of its thread pool: its fields
+        are the global variables of the engine (S->N, S->K...).
+
         Parameters.
 
         If we have to choose some parameters to lower the computational
@@ -94,144 +169,510 @@ static double LOG_K ;                           /* log( K ) */
 
 *******************************************************************************/
 
-/** Maximal allowed log NFA */
-static double MAX_ALLOWED_LOG_NFA = 0 ;
+typedef struct st_astre_state
+{
+  points_desc pd ;
+  trajs_file tf ;
+  int n_fields ;                        /* quick access to pd->n_fields */
+  int *n_points_in_frame ;              /* quick access to pd->n_points_in_frame */
+
+  double* IMAGE_AREA ;
+  int N ;                               /* maximal number of points in a frame */
+  int K ;                               /* number of frames */
+
+  double* LOG_IMAGE_AREA ;              /* log( IMAGE_AREA ) */
+  double LOG_N ;                        /* log( N ) */
+  double LOG_K ;                        /* log( K ) */
+
+  /** Maximal allowed log NFA */
+  double MAX_ALLOWED_LOG_NFA ;
+
+  /** Maximal allowed trajectory length (ie. number of points in the
+   * trajectory, set as a command line parameter). Set this to 0 to allow any
+   * length. */
+  int MAX_ALLOWED_TRAJECTORY_LENGTH ;
+
+  /** Compute the frames one after the other in a sliding window, keeping
+   * only the G values of the last frames in memory (set as a command line
+   * parameter, requires MAX_ALLOWED_TRAJECTORY_LENGTH), see the description
+   * of the sliding window. */
+  char SLIDING_WINDOW ;
+
+  /** With a sliding window, a trajectory is extracted at the latest
+   * WINDOW_LATENCY frames after its last frame (set as a command line
+   * parameter, 0 .. 2*MAX_ALLOWED_TRAJECTORY_LENGTH-1). Below
+   * MAX_ALLOWED_TRAJECTORY_LENGTH-1 frames, a trajectory may be extracted
+   * before all its competitors are known. */
+  int WINDOW_LATENCY ;
+
+  /** Read the frames one after the other from a stream, retiring the frames
+   * that left the sliding window, see the streaming detection. */
+  char STREAMING ;
 
-/** Maximal allowed trajectory length (ie. number of points in the trajectory).
- * Set this to 0 to allow any length. */
-static int MAX_ALLOWED_TRAJECTORY_LENGTH = 0 ;
+#ifdef ASTRE_HAS_HOLES
+  /** Maximal allowed hole length (set as a command line parameter) */
+  int MAX_ALLOWED_HOLE_LENGTH ;
+#endif
 
+  /** Number of threads used to compute the G function (set as a command
+   * line parameter). The rows of G in a frame are independent, so they are
+   * shared between the threads of astre_thread_pool. */
+  int N_THREADS ;
+  thread_pool astre_thread_pool ;
+
+  /** Incremental computation of the G function after an extraction (set as
+   * a command line parameter): 0 computes G again from scratch, 1 restarts
+   * from the first frame having a deactivated point, 2 also skips the cells
+   * that did not change. */
+  int INCREMENTAL_LEVEL ;
+
+  /** Search the points z of the G computation in rings around their
+   * predicted position, using the spatial index of each frame (unset with a
+   * command line parameter to scan all the points) */
+  char USE_SPATIAL_INDEX ;
+
+  /** Maximal displacement of a point between two consecutive frames (set as
+   * a command line parameter), or 0 for any displacement. When it is set, G
+   * is only computed for the pairs of points that are close enough, see the
+   * description of the links between the points. */
+  double MAX_DISPLACEMENT ;
+
+  /** Instruction set of the kernels computing G (set as a command line
+   * parameter): one of the G_SIMD_* levels (see astre/astre.h), or -1 for
+   * the best one supported by the processor, see g_kernels_init(). */
+  int SIMD_LEVEL ;
+
+  /** Go on extracting the candidates after a broken one (set as a command
+   * line parameter), see extract_and_disable_most_significant_trajectories.
+   * There are fewer rounds of computation, but the extraction is no longer
+   * exactly the greedy one. */
+  char EXTRACT_PAST_CONFLICTS ;
+
+  /** Do not print the logs of the detection (set by the caller of the
+   * library, for instance for the sequences of a batch), see P. */
+  char QUIET ;
+
+  /* Precomputations */
+  double* LOG_k ;
+  double* LOG_Cnk ;
+  double* LOG_Kfact ;
+#ifdef ASTRE_HAS_NO_HOLES
+  double* LOG_Nsum ;                    /* sum of log(N_i), i < f */
+  int* LOG_Nempty ;                     /* # of frames i < f without points */
+#endif
 #ifdef ASTRE_HAS_HOLES
-/** Maximal allowed hole length (set as a command line parameter) */
-static int MAX_ALLOWED_HOLE_LENGTH ;
+  log_nprod_row* LOG_Nprod ;
+  int LOG_Nprod_max_length ;            /* maximal length of the rows */
 #endif
 
-/*******************************************************************************
+  /* Active points */
+  char **activated_fp ;
+  int **active_fp ;
+  int *n_active_f ;
+  char *active_fp_is_stale_f ;          /* a point of frame f was deactivated */
+
+  /** Earliest frame having a point deactivated since the last computation
+   * of the G function */
+  int g_first_dirty_frame ;
+
+  /* Spatial index and coordinates of the points */
+  points_grid* points_grid_f ;
+  float** points_x_f ;
+  float** points_y_f ;
+
+  /* Trajectories found */
+  traj_store trajectory_store ;
+  char* partial_results_fname ;
+
+  /* Candidate trajectories */
+  uint32_t** g_max_code_f ;
+  g_candidates g_cand_heap ;
+  char g_cand_heap_is_heap ;            /* is g_cand_heap ordered? */
+  double g_cand_min_lNFA ;              /* lower bound of the log(NFA) of g_cand_heap */
+  g_candidates g_cand_batch ;           /* candidates of the current extraction */
+  int* g_batch_n ;                      /* # of points of their trajectories */
+  int* g_batch_frames ;                 /* frames and points of their trajectories, */
+  int* g_batch_points ;                 /* MAX_ALLOWED_TRAJECTORY_LENGTH per candidate */
+  size_t g_batch_allocated ;
+  g_candidates* g_cand_thread ;         /* new candidates of each thread */
+
+  /* Criterion codes */
+  int G_CODE_BITS ;
+  char G_CODES_ARE_AREAS ;
+  uint32_t G_CODE_MAX ;
+  uint32_t G_AREA_CODE_NEAR_MAX ;
+  float* g_code_delta ;                 /* normalized criterion of the codes */
+
+  /* Memory arenas of the G function */
+  char G_USE_HUGE_PAGES ;
+  void** g_arena_f ;                    /* arena of frame k */
+  size_t* g_arena_mapped_f ;            /* mmap-ed size, or 0 if malloc-ed */
+  size_t* g_n_values_f ;                /* # of values of frame k */
+  size_t* g_n_cells_f ;                 /* # of cells of frame k */
+
+  /* Links between the points */
+  int* g_n_h_f ;                        /* # of hole lengths h in frame k */
+  size_t** g_link_start_f ;             /* first cell of the links of (x,h) */
+  int** g_link_y_f ;                    /* point y of each cell, or NULL */
+  size_t** g_link_offset_f ;            /* offset of the values of (x,h) */
+
+  /* Argmins and dirty cells */
+  void** g_bp_f ;                       /* argmins of frame k */
+  size_t* g_bp_mapped_f ;
+  char** g_dirty_f ;                    /* dirty cells of frame k */
+  char g_is_computed ;                  /* have the G values been computed at least once? */
+  int g_last_computed_frame ;           /* last frame whose G values have been computed */
+  int g_check_dirty_frame ;             /* the cells of the frames up to this one are
+                                         * checked before being computed (0: none) */
+
+  /* Minima over z */
+  void** g_zmin_f ;                     /* minima over z of frame p */
+  size_t* g_zmin_row_size_f ;           /* # of values for a point y of frame p */
+
+  /* Layout of the G values */
+#ifdef ASTRE_HAS_NO_HOLES
+  size_t* g_cell_size_f ;               /* # of values for (x,y) in frame k */
+#endif
+#ifdef ASTRE_HAS_HOLES
+  size_t** g_cell_size_fh ;             /* # of values for (x,h,y) */
+  size_t** g_lsj_offset_h ;             /* offset of (l0,s0) in a cell */
+  size_t** g_zmin_slab_offset_fh ;      /* offset of the slab h in g_zmin_f */
+#endif
 
-        Potentially useful precomputations.
+  /* Sliding window */
+  int g_window_size ;
+  int g_window_first_frame ;            /* first frame in the window */
+  g_window_slot* g_window_slots ;
+  int g_window_last_frame ;             /* last frame of the sequence */
+  int** g_reserved_fp ;
+  int g_reserve_stamp ;
+  g_candidates g_cand_pending ;         /* candidates waiting for the next frames */
 
-*******************************************************************************/
+  /* Kernels */
+  g_kernel_fn g_kernel ;
+  g_kernel_zmin_fn g_kernel_zmin ;
 
-/*******************************************************************************
+#ifdef ASTRE_HAS_HOLES
+  /* Wavefront computation of the frames */
+  g_wave_task* g_wave_queue ;           /* ready tasks, from g_wave_head */
+  int g_wave_head, g_wave_tail ;
+  int* g_wave_remaining_f ;             /* # of tasks left in the slabs (resp.
+                                         * the minima) of frame k */
+  int g_wave_n_frames ;                 /* # of frames left */
+  int g_wave_first_k, g_wave_last_k ;
+  char g_wave_check_dirty ;
+  pthread_mutex_t g_wave_lock ;
+  pthread_cond_t g_wave_ready ;
+#endif
 
-        Precompute the combinatorial coefficients of the log NFA.
+  /* Discrete areas */
+  int discrete_area_max_r ;
+  int discrete_area_max_r_sq ;
+  int discrete_area_width ;
+  double* discrete_area_data ;
+} astre_state ;
 
-        array : k => log(k), k = 1..K
+static __thread astre_state* S ;               /* state of the current detection */
 
-*******************************************************************************/
-static double* LOG_k ;
-static void
-precompute_log_k()
+/* New state, with the default values of the parameters */
+static astre_state*
+astre_state_new()
 {
-  LOG_k = combinatorics_log_K_init( K );
+/*{{{*/
+  astre_state* s = (astre_state*)calloc_or_die( 1, sizeof(astre_state) );
+  s->N_THREADS = 1 ;
+  s->INCREMENTAL_LEVEL = 1 ;
+  s->USE_SPATIAL_INDEX = TRUE ;
+  s->SIMD_LEVEL = -1 ;
+  s->G_CODE_BITS = 32 ;
+  s->G_CODE_MAX = 0xFFFFFFFE ;
+  s->discrete_area_max_r = -1 ;
+  s->discrete_area_max_r_sq = -1 ;
+  s->discrete_area_width = -1 ;
+#ifdef ASTRE_HAS_HOLES
+  pthread_mutex_init( &(s->g_wave_lock), NULL );
+  pthread_cond_init( &(s->g_wave_ready), NULL );
+#endif
+  return s ;
+/*}}}*/
 }
 
-/*******************************************************************************
+static void
+astre_state_free( astre_state* s )
+{
+/*{{{*/
+#ifdef ASTRE_HAS_HOLES
+  pthread_cond_destroy( &(s->g_wave_ready) );
+  pthread_mutex_destroy( &(s->g_wave_lock) );
+#endif
+  free( s );
+/*}}}*/
+}
 
-        Precompute the combinatorial coefficients of the log NFA.
+/* Make the state of ctx the current state, for the points of ctx, and return
+ * the former current state */
+static astre_state*
+astre_state_attach( astre_ctx ctx )
+{
+/*{{{*/
+  astre_state* caller_state = S ;
+  astre_state* s = (astre_state*)ctx->state ;
+  s->pd = ctx->pd ;
+  s->tf = ctx->tf ;
+  s->n_fields = ctx->pd->n_fields ;
+  s->n_points_in_frame = ctx->pd->n_points_in_frame ;
+  S = s ;
+  return caller_state ;
+/*}}}*/
+}
 
-        array : n*(K+1)+k => log( comb(n,k) ), n,k = 0..K
+static void
+astre_state_detach( astre_state* caller_state )
+{
+/*{{{*/
+  S->pd = (points_desc)NULL ;
+  S->tf = (trajs_file)NULL ;
+  S = caller_state ;
+/*}}}*/
+}
 
-*******************************************************************************/
-static double* LOG_Cnk ;
+/* Each worker of the thread pool of a detection uses its state */
 static void
-precompute_log_cnk()
+astre_state_bind_worker( void* state, int thread )
 {
-  LOG_Cnk = combinatorics_log_Cnk_init( K );
+  S = (astre_state*)state ;
 }
 
 /*******************************************************************************
 
-        Precompute the LOG_Kfact array.
+        Potentially useful precomputations.
+
+        The values that do not depend on the engine (the image areas and
+        the combinatorial coefficients of the log NFA) are computed once
+        for both engines, see astre_tables_new, and the engine only points
+        to them.
+
+*******************************************************************************/
+
+/*******************************************************************************
+
+        Combinatorial coefficients of the log NFA.
+
+        LOG_k     : k => log(k), k = 1..K
+        LOG_Cnk   : band log( comb(n,k) ), n = 0..MAX_ALLOWED_TRAJECTORY_LENGTH,
+                    k = 0..n
+        LOG_Kfact : k => log(k!), k = 0..K
 
-        array : k => log(k!), k = 0..K
+        the NFA only needs comb(l,s) for s <= l <= MAX_ALLOWED_TRAJECTORY_LENGTH,
+        a dense (K+1)*(K+1) table would not fit in memory for long sequences.
 
 *******************************************************************************/
-static double* LOG_Kfact ;
+
+#define LOG_CNK( n, k ) \
+  combinatorics_log_Cnk_band( S->LOG_Cnk, S->MAX_ALLOWED_TRAJECTORY_LENGTH, n, k )
+
+/* Use the precomputed values of the context */
+static void
+precomputations_attach( astre_ctx ctx )
+{
+/*{{{*/
+  S->IMAGE_AREA = ctx->image_area ;
+  S->LOG_IMAGE_AREA = ctx->log_image_area ;
+  S->LOG_k = ctx->tables->log_k ;
+  S->LOG_Cnk = ctx->tables->log_cnk ;
+  S->LOG_Kfact = ctx->tables->log_kfact ;
+/*}}}*/
+}
+
 static void
-precompute_log_kfact()
+precomputations_detach()
 {
-  LOG_Kfact = combinatorics_log_Kfact_init( K );
+/*{{{*/
+  S->IMAGE_AREA = S->LOG_IMAGE_AREA = (double*)NULL ;
+  S->LOG_k = S->LOG_Cnk = S->LOG_Kfact = (double*)NULL ;
+/*}}}*/
 }
 
 /*******************************************************************************
 
-        Precompute the LOG_Nprod array.
+        Precompute the LOG_Nprod values.
 
-        LOG_Nprod[k][l][s] = max_{k = i_1 < ... < i_s = k+l-1}
+        log_nprod(k,l,s) = max_{k = i_1 < ... < i_s = k+l-1}
                                log(N_{i_1} * ... * N_{i_s}) if l >= 2, s >= 2
 
         this is the maximal possible value of log( N_i1 * ... * N_is ) for a
         trajectory of length l and size s starting at frame k, that we use to
-        compute the upper bound on all these values for the NFA.
+        compute the upper bound on all these values for the NFA, or -1 if
+        there is no such trajectory (a frame has no points).
+
+        The values are built frame by frame, once the number of points of
+        frame f is known, for the trajectories ending at frame f, of length
+        l <= MAX_ALLOWED_TRAJECTORY_LENGTH, or up to the length of the
+        longest trajectory to tag or to restart from (rf), which may be
+        longer.
+
+        Without holes, s = l: the values are the sums of the logs of the
+        numbers of points of the frames k .. k+l-1, which are differences of
+        the prefix sums LOG_Nsum, unless one of these frames has no points
+        (LOG_Nempty counts the frames without points).
+
+        With holes, the N_i of the frames between the two end points are
+        taken by decreasing value: the values of the trajectories starting
+        at frame k are stored in a flat row LOG_Nprod[k].v, by length and
+        size, and the row keeps the numbers of points of these interior
+        frames sorted while its lengths are extended.
 
 *******************************************************************************/
-static double*** LOG_Nprod ;
+#ifdef ASTRE_HAS_NO_HOLES
+
+static inline double
+log_nprod( int k, int l, int s )
+{
+  if( l < 2 || S->LOG_Nempty[k+l] != S->LOG_Nempty[k] ) return -1.0 ;
+  return S->LOG_Nsum[k+l] - S->LOG_Nsum[k] ;
+}
 
 static void
-precompute_log_nprod()
+log_nprod_init_arrays( trajs_file rf )
 {
-  double* sort_array = (double*)calloc_or_die( K, sizeof(double) );
+  S->LOG_Nsum = (double*)calloc_or_die( S->K+1, sizeof(double) );
+  S->LOG_Nempty = (int*)calloc_or_die( S->K+1, sizeof(int) );
+}
 
-  LOG_Nprod = (double***)calloc_or_die( K, sizeof(double**) );
-  for( int k = 0 ; k < K ; k++ )
-  {
-    LOG_Nprod[k] = (double**)calloc_or_die( K-k+1, sizeof(double*) );
-    for( int l = 0 ; l <= K-k ; l++ )
-    {
-      LOG_Nprod[k][l] = (double*)calloc_or_die( l+1, sizeof(double) );
-      double lNprod = -1.0 ;
+static void
+log_nprod_init_frame( int f )
+{
+  const int n = S->n_points_in_frame[f] ;
+  S->LOG_Nsum[f+1] = S->LOG_Nsum[f] + ( n > 0 ? log10(n) : 0.0 ) ;
+  S->LOG_Nempty[f+1] = S->LOG_Nempty[f] + ( n > 0 ? 0 : 1 ) ;
+}
 
-      if( l >= 2 )
-      {
-        if( n_points_in_frame[k] == 0 || n_points_in_frame[k+l-1] == 0 )
-          lNprod = -1.0 ;
-        else
-          lNprod = log10(n_points_in_frame[k]) + log10(n_points_in_frame[k+l-1]) ;
+static void
+log_nprod_free_frame( int k )
+{
+}
 
-        for( int p = k+1 ; p < k+l-1 ; p++ )
-        {
-          sort_array[p-k-1] = n_points_in_frame[p] ;
-        }
-        /* sort in descending order */
-        qsort( sort_array, l-2, sizeof(double), &compar_d_descend );
-      }
+static void
+log_nprod_free()
+{
+  free( S->LOG_Nsum ); S->LOG_Nsum = (double*)NULL ;
+  free( S->LOG_Nempty ); S->LOG_Nempty = (int*)NULL ;
+}
+#endif // ASTRE_HAS_NO_HOLES
 
-      for( int s = 0 ; s <= l ; s++ )
-      {
-        if( s < 2 )
-        {
-          LOG_Nprod[k][l][s] = -1.0 ;
-        }
-        /* lNprod = -1 : frames have no more points, impossible to create a trajectory */
-        else if( lNprod >= -0.5 && s >= 3 )
-        {
-          if( sort_array[s-3] == 0 )
-            lNprod = -1.0 ;
-          else
-            lNprod += log10( sort_array[s-3] );
-        }
+#ifdef ASTRE_HAS_HOLES
+static inline double
+log_nprod( int k, int l, int s )
+{
+  return S->LOG_Nprod[k].v[l*(l+1)/2 + s] ;
+}
 
-        LOG_Nprod[k][l][s] = lNprod ;
-      }
+/* Compute the values of the length l = row->n_l of the trajectories starting
+ * at frame k */
+static void
+log_nprod_row_extend( log_nprod_row* row, int k )
+{
+/*{{{*/
+  const int l = row->n_l ;
+  double* v = &(row->v[l*(l+1)/2]) ;
+  double lNprod = -1.0 ;
+
+  if( l >= 2 )
+  {
+    if( S->n_points_in_frame[k] == 0 || S->n_points_in_frame[k+l-1] == 0 )
+      lNprod = -1.0 ;
+    else
+      lNprod = log10(S->n_points_in_frame[k]) + log10(S->n_points_in_frame[k+l-1]) ;
+
+    /* insert the new interior frame k+l-2, in decreasing order */
+    if( l >= 3 )
+    {
+      const double n = S->n_points_in_frame[k+l-2] ;
+      int i = l-3 ;
+      for( ; i > 0 && row->interior[i-1] < n ; i-- )
+        row->interior[i] = row->interior[i-1] ;
+      row->interior[i] = n ;
+    }
+  }
+
+  for( int s = 0 ; s <= l ; s++ )
+  {
+    if( s < 2 )
+    {
+      v[s] = -1.0 ;
+    }
+    /* lNprod = -1 : frames have no more points, impossible to create a trajectory */
+    else if( lNprod >= -0.5 && s >= 3 )
+    {
+      if( row->interior[s-3] == 0 )
+        lNprod = -1.0 ;
+      else
+        lNprod += log10( row->interior[s-3] );
     }
+
+    v[s] = lNprod ;
+  }
+
+  row->n_l++ ;
+  if( row->n_l > row->max_l )
+  {
+    free( row->interior ); row->interior = (double*)NULL ;
   }
+/*}}}*/
+}
+
+static void
+log_nprod_init_arrays( trajs_file rf )
+{
+/*{{{*/
+  S->LOG_Nprod = (log_nprod_row*)calloc_or_die( S->K, sizeof(log_nprod_row) );
+  S->LOG_Nprod_max_length = S->MAX_ALLOWED_TRAJECTORY_LENGTH ;
+  for( int t = 0 ; rf && t < rf->num_of_trajs ; t++ )
+    S->LOG_Nprod_max_length = max_i( S->LOG_Nprod_max_length, rf->trajs[t].length );
+/*}}}*/
+}
+
+/* The number of points of frame f is known: start the row of frame f, and
+ * extend the rows of the trajectories ending at frame f */
+static void
+log_nprod_init_frame( int f )
+{
+/*{{{*/
+  log_nprod_row* row = &(S->LOG_Nprod[f]) ;
+  row->max_l = min_i( S->LOG_Nprod_max_length, S->K-f ) ;
+  row->v = (double*)calloc_or_die( (size_t)(row->max_l+1)*(row->max_l+2)/2, sizeof(double) );
+  row->interior = (double*)calloc_or_die( max_i( row->max_l-2, 1 ), sizeof(double) );
+  row->n_l = 0 ;
+  log_nprod_row_extend( row, f ); /* l = 0 */
+
+  for( int k = max_i( 0, f - S->LOG_Nprod_max_length + 1 ) ; k <= f ; k++ )
+    log_nprod_row_extend( &(S->LOG_Nprod[k]), k );
+/*}}}*/
+}
 
-  free( sort_array ); sort_array = (double*)NULL ;
+static void
+log_nprod_free_frame( int k )
+{
+  free( S->LOG_Nprod[k].v ); S->LOG_Nprod[k].v = (double*)NULL ;
+  free( S->LOG_Nprod[k].interior ); S->LOG_Nprod[k].interior = (double*)NULL ;
 }
 
 static void
 log_nprod_free()
 {
-  for( int k = 0 ; k < K ; k++ )
-  {
-    for( int l = 0 ; l <= K-k ; l++ )
-    {
-      free( LOG_Nprod[k][l] ); LOG_Nprod[k][l] = (double*)NULL ;
-    }
-    free( LOG_Nprod[k] ); LOG_Nprod[k] = (double**)NULL ;
-  }
-  free( LOG_Nprod ); LOG_Nprod = (double***)NULL ;
+  if( !S->LOG_Nprod ) return ;
+  for( int k = 0 ; k < S->K ; k++ )
+    log_nprod_free_frame( k );
+  free( S->LOG_Nprod ); S->LOG_Nprod = (log_nprod_row*)NULL ;
+}
+#endif // ASTRE_HAS_HOLES
+
+static void
+precompute_log_nprod( trajs_file rf )
+{
+  log_nprod_init_arrays( rf );
+  for( int f = 0 ; f < S->K ; f++ )
+    log_nprod_init_frame( f );
 }
 
 /*******************************************************************************
@@ -239,142 +680,804 @@ log_nprod_free()
         Active points.
         activated_fp[f][j] is TRUE iif point j in frame f is active.
 
+        The computations iterate over the compacted lists of the active
+        points: active_fp[f][0 .. n_active_f[f]-1] are the indices of the
+        active points of frame f, by increasing index. The lists of the
+        frames having deactivated points are rebuilt before each computation
+        of G (see active_points_update()), so that the computations get
+        cheaper as the points are extracted.
+
 *******************************************************************************/
 
-static char **activated_fp ;
+/* Activate all the points of frame k */
+static void
+activated_fp_init_frame( int k )
+{
+  free( S->activated_fp[k] );
+  free( S->active_fp[k] );
+  S->activated_fp[k] =
+    (char*)calloc_or_die( S->n_points_in_frame[k], sizeof(char) );
+  S->active_fp[k] =
+    (int*)calloc_or_die( max_i( S->n_points_in_frame[k], 1 ), sizeof(int) );
+
+  for( int p = 0 ; p < S->n_points_in_frame[k] ; p++ )
+  {
+    S->activated_fp[k][p] = TRUE ;
+    S->active_fp[k][p] = p ;
+  }
+  S->n_active_f[k] = S->n_points_in_frame[k] ;
+  S->active_fp_is_stale_f[k] = FALSE ;
+}
+
+static void
+activated_fp_init_arrays()
+{
+  S->activated_fp = (char**)calloc_or_die( S->K, sizeof(char*) );
+  S->active_fp = (int**)calloc_or_die( S->K, sizeof(int*) );
+  S->n_active_f = (int*)calloc_or_die( S->K, sizeof(int) );
+  S->active_fp_is_stale_f = (char*)calloc_or_die( S->K, sizeof(char) );
+}
 
 static void
 activated_fp_init()
 {
-  activated_fp = (char**)calloc_or_die( K, sizeof(char*) );
-  for( int k = 0 ; k < K ; k++ )
-  {
-    activated_fp[k] =
-      (char*)calloc_or_die( n_points_in_frame[k], sizeof(char) );
+  activated_fp_init_arrays();
+  for( int k = 0 ; k < S->K ; k++ )
+    activated_fp_init_frame( k );
+}
 
-    for( int p = 0 ; p < n_points_in_frame[k] ; p++ )
-      activated_fp[k][p] = TRUE ;
-  }
+/* Rebuild the list of the active points of frame f */
+static void
+active_fp_rebuild( int f )
+{
+  int n = 0 ;
+  for( int p = 0 ; p < S->n_points_in_frame[f] ; p++ )
+    if( S->activated_fp[f][p] ) S->active_fp[f][n++] = p ;
+  S->n_active_f[f] = n ;
+  S->active_fp_is_stale_f[f] = FALSE ;
+}
+
+static inline void
+deactivate_point( int f, int p )
+{
+  S->activated_fp[f][p] = FALSE ;
+  S->active_fp_is_stale_f[f] = TRUE ;
+  if( f < S->g_first_dirty_frame ) S->g_first_dirty_frame = f ;
+}
+
+static void
+activated_fp_free_frame( int k )
+{
+  free( S->activated_fp[k] ); S->activated_fp[k] = (char*)NULL ;
+  free( S->active_fp[k] ); S->active_fp[k] = (int*)NULL ;
+  S->n_active_f[k] = 0 ;
+  S->active_fp_is_stale_f[k] = FALSE ;
 }
 
 static void
 activated_fp_free()
 {
-  for( int k = 0 ; k < K ; k++ )
+  for( int k = 0 ; k < S->K ; k++ )
+    activated_fp_free_frame( k );
+  free( S->activated_fp ); S->activated_fp = (char**)NULL ;
+  free( S->active_fp ); S->active_fp = (int**)NULL ;
+  free( S->n_active_f ); S->n_active_f = (int*)NULL ;
+  free( S->active_fp_is_stale_f ); S->active_fp_is_stale_f = (char*)NULL ;
+}
+
+/*******************************************************************************
+
+        Spatial index of the points.
+
+        The points of each frame f are bucketed in the uniform grid
+        points_grid_f[f], of square cells of side 'size' (about
+        POINTS_GRID_POINTS_PER_CELL points per cell). The points of a cell c
+        are idx[ cell_start[c] .. cell_start[c+1]-1 ], by increasing index,
+        and xy holds their (float) coordinates in the same order. Like the
+        lists of the active points, the grids only hold the active points
+        once they are compacted by active_points_update().
+
+        When computing G, the points z of frame q = k-2 (k-h-h2-2 with holes)
+        are visited by rings of cells of increasing distance around the
+        predicted position of z (where the acceleration is null). Once the
+        distance to the cells that were not visited is large enough for
+        their criterion to be unable to improve any G value of the cell, the
+        remaining points are skipped. See FORALL_z_RINGS.
+
+*******************************************************************************/
+
+static const double POINTS_GRID_POINTS_PER_CELL = 4.0 ;
+
+/* Visit the points z of the grid by rings of cells around the cell (cx,cy).
+ * The body is run for each z of ring __r, and the code between
+ * END_FORALL_z_RING and END_FORALL_z_RINGS once each ring has been visited
+ * (it must break out of the loop, at the latest when the whole grid has been
+ * visited). */
+#define FORALL_z_RINGS(grid,cx,cy) \
+  for( int __r = 0 ; ; __r++ ) \
+  { \
+    for( int __cj = (cy)-__r ; __cj <= (cy)+__r ; __cj++ ) \
+    { \
+      if( __cj < 0 || __cj >= (grid)->ny ) continue ; \
+      const int __di = ( __cj == (cy)-__r || __cj == (cy)+__r ) ? 1 : 2*__r ; \
+      for( int __ci = (cx)-__r ; __ci <= (cx)+__r ; __ci += __di ) \
+      { \
+        if( __ci < 0 || __ci >= (grid)->nx ) continue ; \
+        const int __c = __cj*(grid)->nx + __ci ; \
+        for( int __zi = (grid)->cell_start[__c] ; __zi < (grid)->cell_start[__c+1] ; __zi++ ) \
+        { \
+          const int z = (grid)->idx[__zi] ;
+
+#define END_FORALL_z_RING } } }
+#define END_FORALL_z_RINGS }
+
+/*******************************************************************************
+
+        Coordinates of the points.
+
+        The criterion is computed in float, so the computations read the
+        coordinates from a float copy of the points, made of the arrays
+        points_x_f[k] and points_y_f[k] of each frame (aligned on
+        POINTS_XY_ALIGN bytes, and padded to a multiple of POINTS_XY_PAD
+        points), rather than from the rows of n_fields doubles of
+        pd->points, whose stride grows with each extra column.
+
+*******************************************************************************/
+
+#define POINTS_XY_ALIGN 64
+#define POINTS_XY_PAD 16
+
+static float*
+points_xy_alloc( int n )
+{
+/*{{{*/
+  const size_t size = (size_t)((n + POINTS_XY_PAD-1)/POINTS_XY_PAD + 1)*POINTS_XY_PAD ;
+  void* ptr = (void*)NULL ;
+  if( posix_memalign( &ptr, POINTS_XY_ALIGN, size*sizeof(float) ) != 0 )
   {
-    free( activated_fp[k] ); activated_fp[k] = (char*)NULL ;
+    C_log_error( "[points_xy_alloc] Could not allocate %d points!\n", n );
+    exit(-1);
   }
-  free( activated_fp ); activated_fp = (char**)NULL ;
+  memset( ptr, 0, size*sizeof(float) );
+  return (float*)ptr ;
+/*}}}*/
+}
+
+static void
+points_xy_free_frame( int k )
+{
+  free( S->points_x_f[k] ); S->points_x_f[k] = (float*)NULL ;
+  free( S->points_y_f[k] ); S->points_y_f[k] = (float*)NULL ;
+}
+
+static void
+points_xy_init_frame( int k )
+{
+/*{{{*/
+  points_xy_free_frame( k );
+  S->points_x_f[k] = points_xy_alloc( S->n_points_in_frame[k] );
+  S->points_y_f[k] = points_xy_alloc( S->n_points_in_frame[k] );
+  for( int p = 0 ; p < S->n_points_in_frame[k] ; p++ )
+  {
+    S->points_x_f[k][p] = (float)S->pd->points[k][p*S->n_fields+0] ;
+    S->points_y_f[k][p] = (float)S->pd->points[k][p*S->n_fields+1] ;
+  }
+/*}}}*/
+}
+
+static void
+points_xy_init_arrays()
+{
+  S->points_x_f = (float**)calloc_or_die( S->K, sizeof(float*) );
+  S->points_y_f = (float**)calloc_or_die( S->K, sizeof(float*) );
+}
+
+static void
+points_xy_init()
+{
+/*{{{*/
+  points_xy_init_arrays();
+  for( int k = 0 ; k < S->K ; k++ )
+    points_xy_init_frame( k );
+/*}}}*/
+}
+
+static void
+points_xy_free()
+{
+/*{{{*/
+  if( !S->points_x_f ) return ;
+  for( int k = 0 ; k < S->K ; k++ )
+    points_xy_free_frame( k );
+  free( S->points_x_f ); S->points_x_f = (float**)NULL ;
+  free( S->points_y_f ); S->points_y_f = (float**)NULL ;
+/*}}}*/
 }
 
 /*******************************************************************************
 
-        Image areas.
+        Trajectory store variables.  This maintains a resizable buffer
+        of trajectories.
 
 *******************************************************************************/
-void precompute_image_areas(double defined_image_area, char auto_crop)
+
+static void
+traj_store_init(int ninit)
 {
-  IMAGE_AREA = (double*)calloc_or_die(K, sizeof(double));
-  LOG_IMAGE_AREA = (double*)calloc_or_die(K, sizeof(double));
-  for( int k = 0 ; k < K ; k++ )
+  S->trajectory_store = traj_store_create(ninit);
+}
+
+/*******************************************************************************
+
+        Candidate trajectories.
+
+        While computing G, the threads collect in g_cand_thread the G values
+        whose log(NFA) is at most MAX_ALLOWED_LOG_NFA + LOG_NFA_COMP_EPS, ie.
+        the only ones that can ever be extracted. After the computation, they
+        are merged in the min-heap g_cand_heap (ordered by log(NFA), then by
+        frame and index in G, which is the order of the former scans of G),
+        from which the extraction pops the most significant trajectories.
+
+        The candidates are invalidated lazily: those with a deactivated end
+        point are dropped when they are popped, and those of the cells that
+        are computed again are dropped when the new candidates are merged.
+
+        Each thread also keeps the running minimum of the log(NFA) of its
+        candidates, so that g_cand_min_lNFA, a lower bound of the log(NFA) of
+        the heap, is known as soon as G is computed: the heap is only ordered
+        again (g_cand_heap_make) when the extraction may find a meaningful
+        candidate, which saves a sweep over all the candidates at each frame
+        of a sliding window without any meaningful trajectory.
+
+*******************************************************************************/
+
+/* The log(NFA) only depends on the criterion delta through the term
+ * (s-2).log10(delta) (s = l without holes), the other terms only depending on
+ * (k,l,s,j). Hence, for each (k,l,s,j), the G values that can be candidates
+ * are those whose code is at most a maximal admissible code, precomputed in
+ * g_max_code_f[k] (with the layout of a cell of frame k, for h = 0 when there
+ * are holes): most G values are rejected with a single comparison, and the
+ * log(NFA) is only computed for the others. */
+
+static inline void
+g_candidates_push_back( g_candidates* c, const g_candidate* cand )
+{
+  if( c->n == c->allocated )
+  {
+    c->allocated = c->allocated > 0 ? 2*c->allocated : 256 ;
+    c->data = (g_candidate*)realloc_or_die( c->data, c->allocated*sizeof(g_candidate) );
+  }
+  c->data[c->n++] = *cand ;
+}
+
+static inline char
+g_candidate_less( const g_candidate* a, const g_candidate* b )
+{
+  if( a->lNFA != b->lNFA ) return a->lNFA < b->lNFA ;
+  if( a->k != b->k ) return a->k < b->k ;
+  return a->i < b->i ;
+}
+
+static void
+g_cand_heap_sift_down( size_t i )
+{
+/*{{{*/
+  g_candidate* d = S->g_cand_heap.data ;
+  const size_t n = S->g_cand_heap.n ;
+  g_candidate cur = d[i] ;
+
+  while( 2*i+1 < n )
   {
-    IMAGE_AREA[k] = -1.0 ;
-    LOG_IMAGE_AREA[k] = -1.0 ;
+    size_t c = 2*i+1 ;
+    if( c+1 < n && g_candidate_less( &d[c+1], &d[c] ) ) c++ ;
+    if( !g_candidate_less( &d[c], &cur ) ) break ;
+    d[i] = d[c] ;
+    i = c ;
+  }
+  d[i] = cur ;
+/*}}}*/
+}
+
+static void
+g_cand_heap_heapify()
+{
+  for( size_t i = S->g_cand_heap.n/2 ; i-- > 0 ; )
+    g_cand_heap_sift_down( i );
+}
+
+/* Order the heap, if candidates were added or removed since it was ordered */
+static void
+g_cand_heap_make()
+{
+  if( S->g_cand_heap_is_heap ) return ;
+  g_cand_heap_heapify();
+  S->g_cand_heap_is_heap = TRUE ;
+}
+
+static void
+g_cand_heap_pop()
+{
+  S->g_cand_heap.data[0] = S->g_cand_heap.data[--S->g_cand_heap.n] ;
+  if( S->g_cand_heap.n > 0 ) g_cand_heap_sift_down( 0 );
+}
+
+/*******************************************************************************
+
+        Save partial results
+
+*******************************************************************************/
+
+/*******************************************************************************
+
+        Criterion codes.
+
+        The G function stores unsigned integer codes of the criterion rather
+        than its floating point value, so that the comparisons of the dynamic
+        programming are exact, and the criterion is only normalized by the
+        image area when the NFA is computed:
+
+        - when all the images have the same area (ie. without auto-crop),
+          the code of an acceleration is its discrete area (G_CODES_ARE_AREAS):
+          the number of pixels of the discrete ball for the small radii, and
+          G_AREA_CODE_NEAR_MAX + d^2 - discrete_area_max_r_sq for the larger
+          ones, whose area is pi.d^2 ;
+        - otherwise, the code is the bit pattern of the (positive) float
+          criterion, which compares as the float itself.
+
+        The codes are stored on G_CODE_BITS = 16 bits when they fit, as well
+        as the argmin codes, which halves the memory of G: the area codes are
+        then saturated to G_CODE_MAX, the code of the first area larger than
+        the image area, since a trajectory having such an acceleration cannot
+        be meaningful (its log(NFA) is at least log(K) > MAX_ALLOWED_LOG_NFA).
+
+        G_CODE_INFTY (all ones, whatever the number of bits) denotes
+        impossible paths.
+
+*******************************************************************************/
+
+static const uint32_t G_CODE_INFTY = 0xFFFFFFFF ;
+
+
+/*******************************************************************************
+
+        Memory arenas of the G function.
+
+        The G values of a frame k are stored in a single contiguous arena
+        g_arena_f[k], and the position of a value inside this arena is given
+        by (64 bits) offset tables, see the description of each store below.
+        This replaces the former nested pointer arrays: there is a single
+        allocation per frame, and consecutive cells of a row are contiguous.
+
+        The arenas hold criterion codes of G_CODE_BITS bits, and the G_CELL,
+        G_LSJ, ... macros below give indices of codes inside the arena.
+
+        When G_USE_HUGE_PAGES is set (set as a command line parameter), the
+        large arenas are mapped with mmap and advised to be backed by
+        transparent huge pages, to lower the TLB pressure on large problems.
+
+*******************************************************************************/
+
+static const size_t G_HUGE_PAGE_SIZE = 2*1024*1024 ;
+
+/* Allocate an arena of the given size, *mapped is set to the mmap-ed size,
+ * or 0 if it was malloc-ed */
+static void*
+g_arena_alloc( size_t bytes, size_t* mapped )
+{
+/*{{{*/
+  *mapped = 0 ;
 
-    double area = defined_image_area ;
-    if( auto_crop )
+  if( bytes == 0 ) return NULL ;
+
+#ifdef MAP_ANONYMOUS
+  if( S->G_USE_HUGE_PAGES && bytes >= G_HUGE_PAGE_SIZE )
+  {
+    size_t size = ((bytes + G_HUGE_PAGE_SIZE - 1)/G_HUGE_PAGE_SIZE)*G_HUGE_PAGE_SIZE ;
+    void* arena = mmap( NULL, size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    if( arena != MAP_FAILED )
     {
-      double xmin=-1.0, ymin=-1.0, xmax=-1.0, ymax=-1.0 ;
-      char is_init = FALSE ;
-      for( int p = 0 ; p < n_points_in_frame[k] ; p++ )
-      {
-        double pX = points[k][p*n_fields+0] ;
-        double pY = points[k][p*n_fields+1] ;
-        if( !is_init )
-        {
-          is_init = TRUE ;
-          xmin = xmax = pX ;
-          ymin = ymax = pY ;
-        }
-        else
-        {
-          xmin = min_d(xmin, pX);
-          xmax = max_d(xmax, pX);
-          ymin = min_d(ymin, pY);
-          ymax = max_d(ymax, pY);
-        }
-      }
-      area = max_d( 1.0, (xmax-xmin)*(ymax-ymin) );
+#ifdef MADV_HUGEPAGE
+      madvise( arena, size, MADV_HUGEPAGE );
+#endif
+      *mapped = size ;
+      return arena ;
     }
-    IMAGE_AREA[k] = area;
-    LOG_IMAGE_AREA[k] = log10(area);
+    C_log_warning( "Could not map a huge pages arena, using malloc\n" );
   }
+#endif
+
+  return malloc_or_die( bytes );
+/*}}}*/
 }
 
-void free_image_areas()
+static void
+g_arena_free( void* arena, size_t mapped )
 {
-  free(IMAGE_AREA); IMAGE_AREA = (double*)NULL ;
-  free(LOG_IMAGE_AREA); LOG_IMAGE_AREA = (double*)NULL ;
+/*{{{*/
+  if( !arena ) return ;
+#ifdef MAP_ANONYMOUS
+  if( mapped > 0 )
+    munmap( arena, mapped );
+  else
+#endif
+    free( arena );
+/*}}}*/
 }
 
 /*******************************************************************************
 
-        Trajectory store variables.  This maintains a resizable buffer
-        of trajectories.
+        Links between the points.
+
+        The cells of G are the links (x,h,y) between a point x of frame k and
+        a point y of frame k-h-1 (h = 0 without holes). The links of (x,h)
+        are the cells g_link_start_f[k][xh] .. g_link_start_f[k][xh+1]-1 of
+        frame k, where xh = G_XH(k,x,h), and their values start at offset
+        g_link_offset_f[k][xh] in the arena of frame k.
+
+        Without MAX_DISPLACEMENT, every point y is linked to (x,h), and the
+        cell of y is simply g_link_start_f[k][xh] + y (g_link_y_f[k] is NULL).
+
+        Otherwise, a point y is only linked to (x,h) if |x - y| is at most
+        (h+1).MAX_DISPLACEMENT: the points y of the links, found with the
+        spatial index of frame k-h-1, are stored in increasing order in
+        g_link_y_f[k] (a CSR neighbour list), and the memory and the
+        computations of G are proportional to the number of links rather
+        than to the number of pairs of points. The predecessors z of (x,h,y)
+        are then the points linked to (y,h2).
 
 *******************************************************************************/
 
-static traj_store trajectory_store ;
+static const size_t G_NO_LINK = (size_t)-1 ;
 
-void traj_store_init(int ninit)
+#define G_XH(k,x,h)                    ( (size_t)(x)*S->g_n_h_f[(k)] + (h) )
+
+/* Cell of the link (x,h,y) of frame k, or G_NO_LINK if there is none */
+static inline size_t
+g_link_find( int k, int x, int h, int y )
 {
-  trajectory_store = traj_store_create(ninit);
+/*{{{*/
+  const size_t xh = G_XH(k,x,h) ;
+  size_t first = S->g_link_start_f[k][xh] ;
+  size_t last = S->g_link_start_f[k][xh+1] ;
+
+  if( !S->g_link_y_f[k] ) return first + (size_t)y ;
+
+  const int* link_y = S->g_link_y_f[k] ;
+  while( first < last )
+  {
+    size_t mid = first + (last-first)/2 ;
+    if( link_y[mid] < y ) first = mid+1 ; else last = mid ;
+  }
+  return first < S->g_link_start_f[k][xh+1] && link_y[first] == y ? first : G_NO_LINK ;
+/*}}}*/
 }
 
+/* Loop on the links (x,h,y) of frame k to an active point y, c being the
+ * cell of the link and g_c the offset of its values (of the given size). When
+ * every point y is linked to (x,h), this is a loop on the active points y */
+#define FORALL_LINKS(k,x,h,cell_size,y,c,g_c) \
+  { \
+    const size_t __xh = G_XH((k),(x),(h)) ; \
+    const size_t __c_first = S->g_link_start_f[(k)][__xh] ; \
+    const size_t __g_first = S->g_link_offset_f[(k)][__xh] ; \
+    const int* __link_y = S->g_link_y_f[(k)] ; \
+    const int __p = (k)-(h)-1 ; \
+    const char* __activated = S->activated_fp[__p] ; \
+    const int* __active = S->active_fp[__p] ; \
+    const size_t __n = __link_y ? S->g_link_start_f[(k)][__xh+1] - __c_first \
+                                : (size_t)S->n_active_f[__p] ; \
+    for( size_t __i = 0 ; __i < __n ; __i++ ) \
+    { \
+      const int y = __link_y ? __link_y[__c_first+__i] : __active[__i] ; \
+      if( __link_y && !__activated[y] ) continue ; \
+      const size_t c = __link_y ? __c_first+__i : __c_first+(size_t)y ; \
+      const size_t g_c = __g_first + (c - __c_first)*(cell_size) ;
+
+#define END_FORALL_LINKS } }
+
 /*******************************************************************************
 
-        Save partial results
+        Back-pointers and incremental computations of the G function.
+
+        While computing G, we store in g_bp_f the argmin of each G value, ie.
+        the code G_BP_CODE(h2,z) = h2*N+z+1 of the predecessor (h2,z) of
+        (x,h,y) realizing the minimum (h2 = 0 without holes), or G_BP_NONE if
+        there is none, so that the optimal trajectories can be extracted by
+        following these back-pointers.
+
+        The argmin codes are stored on G_CODE_BITS bits, like the criterion
+        codes, which are only stored on 16 bits when all the argmin codes fit
+        as well, see g_codes_init(). G_BP_NONE being the smallest code, comparing the codes as
+        unsigned integers orders the predecessors as their (h2,z).
+
+        When points are deactivated after an extraction, the G values of the
+        frames before the first frame having a deactivated point do not
+        change (G at frame k only depends on the points of frames 0 .. k-1
+        besides x), so the computation can restart from that frame
+        (INCREMENTAL_LEVEL >= 1).
+
+        Removing points can only increase the G values, so the G values of a
+        cell (x,h,y) do not change as long as their argmins are active and
+        the cells of their argmins did not change. With INCREMENTAL_LEVEL >= 2,
+        the other cells are flagged in g_dirty_f and are the only ones to be
+        computed again.
+
+        g_bp_f[k] and g_dirty_f[k] use the same layout as the G arena
+        (respectively the cells) of frame k.
+
+*******************************************************************************/
+
+#define G_BP_NONE                      0
+#define G_BP_CODE(h2,z)                ( (uint32_t)((h2)*S->N + (z)) + 1 )
+
+/* Argmin code of the i-th value of the arena of frame k */
+static inline uint32_t
+g_bp_at( int k, size_t i )
+{
+  if( S->G_CODE_BITS == 16 ) return ((uint16_t*)S->g_bp_f[k])[i] ;
+  return ((uint32_t*)S->g_bp_f[k])[i] ;
+}
+
+/* Is the value new_g of argmin new_bp better than the value g of argmin bp?
+ * The ties are broken by the smallest argmin, ie. the first predecessor (h2,z)
+ * in the order of the frames and of the points, so that the G values and
+ * their argmins do not depend on the order in which the points z are
+ * visited. */
+#define G_IS_BETTER(g,bp,new_g,new_bp) \
+  ( (g) > (new_g) || ( (g) == (new_g) && (new_bp) < (bp) ) )
+
+/*******************************************************************************
+
+        Minima of the G function over the points z.
+
+        When USE_SPATIAL_INDEX is set, g_zmin_f[p] holds for each point y of
+        frame p the minimum over the active points z of the G values of the
+        cells (y,z) of frame p, with the layout of a single cell (of one cell
+        per hole length h2, at offset g_zmin_slab_offset_fh[p][h2], when there
+        are holes). It is computed right after the G values of frame p.
+
+        Extending a cell (y,z) cannot give a value lower than this minimum,
+        which bounds what the points z that were not visited by the ring
+        search can bring.
+
+*******************************************************************************/
+
+/* Code of the i-th value of the arena of frame k (G_CODE_INFTY if none) */
+static inline uint32_t
+g_code_at( int k, size_t i )
+{
+  if( S->G_CODE_BITS == 16 )
+  {
+    uint16_t code = ((uint16_t*)S->g_arena_f[k])[i] ;
+    return code == (uint16_t)G_CODE_INFTY ? G_CODE_INFTY : code ;
+  }
+  return ((uint32_t*)S->g_arena_f[k])[i] ;
+}
+
+/* Criterion (delta) of the i-th value of the arena of frame k */
+#define G_DELTA(k,i)                   g_code_to_delta( g_code_at((k),(i)) )
+
+/*******************************************************************************
+
+        Sliding window over the frames.
+
+        With SLIDING_WINDOW, the frames enter the window one after the other
+        (see do_detect_windowed), and only the G values of the last
+        g_window_size frames are kept in memory: frame k uses the slot
+        k % g_window_size of a ring buffer, and a slot is reused (its buffers
+        are only grown) when a new frame enters it. The arrays g_arena_f,
+        g_bp_f, g_dirty_f and g_zmin_f of the frames that left the window
+        (before g_window_first_frame) are NULL.
+
+        The window holds 3L + MAX_ALLOWED_HOLE_LENGTH frames (L being the
+        maximal trajectory length), so that the trajectories waiting to be
+        extracted, and the G values they depend upon, are still in the window.
 
 *******************************************************************************/
 
-char* partial_results_fname = (char*)NULL ;
+/* Buffer b, grown to at least the given size */
+static void*
+g_window_buffer_reserve( g_window_buffer* b, size_t bytes )
+{
+/*{{{*/
+  if( bytes > b->size )
+  {
+    g_arena_free( b->data, b->mapped );
+    b->data = g_arena_alloc( bytes, &(b->mapped) );
+    b->size = bytes ;
+  }
+  return b->data ;
+/*}}}*/
+}
+
+static void
+g_window_slots_init( int size )
+{
+  S->g_window_size = size ;
+  S->g_window_first_frame = 0 ;
+  S->g_window_slots = (g_window_slot*)calloc_or_die( size, sizeof(g_window_slot) );
+}
+
+static void
+g_window_slots_free()
+{
+/*{{{*/
+  if( !S->g_window_slots ) return ;
+  for( int i = 0 ; i < S->g_window_size ; i++ )
+  {
+    g_window_slot* slot = &(S->g_window_slots[i]) ;
+    g_arena_free( slot->arena.data, slot->arena.mapped );
+    g_arena_free( slot->bp.data, slot->bp.mapped );
+    g_arena_free( slot->dirty.data, slot->dirty.mapped );
+    g_arena_free( slot->zmin.data, slot->zmin.mapped );
+  }
+  free( S->g_window_slots ); S->g_window_slots = (g_window_slot*)NULL ;
+  S->g_window_size = 0 ;
+/*}}}*/
+}
+
+/* Frame k enters the window, in the slot of frame k - g_window_size */
+static void
+g_window_slot_attach( int k )
+{
+/*{{{*/
+  g_window_slot* slot = &(S->g_window_slots[k % S->g_window_size]) ;
+
+  S->g_arena_f[k] = g_window_buffer_reserve( &(slot->arena),
+                                          S->g_n_values_f[k]*(S->G_CODE_BITS/8) );
+  S->g_bp_f[k] = g_window_buffer_reserve( &(slot->bp),
+                                       S->g_n_values_f[k]*(S->G_CODE_BITS/8) );
+
+  if( S->INCREMENTAL_LEVEL >= 2 )
+  {
+    S->g_dirty_f[k] = (char*)g_window_buffer_reserve( &(slot->dirty), S->g_n_cells_f[k]+1 );
+    memset( S->g_dirty_f[k], 0, S->g_n_cells_f[k]+1 );
+  }
+
+  if( S->USE_SPATIAL_INDEX )
+    S->g_zmin_f[k] = g_window_buffer_reserve( &(slot->zmin),
+        ((size_t)S->n_points_in_frame[k]*S->g_zmin_row_size_f[k]+1)*(S->G_CODE_BITS/8) );
+/*}}}*/
+}
+
+/* Frame k leaves the window */
+static void
+g_window_slot_detach( int k )
+{
+  S->g_arena_f[k] = NULL ;
+  S->g_bp_f[k] = NULL ;
+  S->g_dirty_f[k] = (char*)NULL ;
+  S->g_zmin_f[k] = NULL ;
+}
+
+/* Allocate the store of frame k, once its links and their offsets are known */
+static void
+g_store_alloc_frame( int k )
+{
+/*{{{*/
+  S->g_arena_f[k] = g_arena_alloc(
+      S->g_n_values_f[k]*(S->G_CODE_BITS/8), &(S->g_arena_mapped_f[k]) );
+  S->g_bp_f[k] = g_arena_alloc(
+      S->g_n_values_f[k]*(S->G_CODE_BITS/8), &(S->g_bp_mapped_f[k]) );
+
+  if( S->INCREMENTAL_LEVEL >= 2 )
+    S->g_dirty_f[k] = (char*)calloc_or_die( S->g_n_cells_f[k]+1, sizeof(char) );
+
+  if( S->USE_SPATIAL_INDEX )
+    S->g_zmin_f[k] = malloc_or_die(
+        ((size_t)S->n_points_in_frame[k]*S->g_zmin_row_size_f[k]+1)*(S->G_CODE_BITS/8) );
+/*}}}*/
+}
+
+static void
+g_store_alloc_frames_arrays()
+{
+/*{{{*/
+  S->g_arena_f = (void**)calloc_or_die( S->K, sizeof(void*) );
+  S->g_arena_mapped_f = (size_t*)calloc_or_die( S->K, sizeof(size_t) );
+  S->g_n_values_f = (size_t*)calloc_or_die( S->K, sizeof(size_t) );
+  S->g_n_cells_f = (size_t*)calloc_or_die( S->K, sizeof(size_t) );
+  S->g_link_offset_f = (size_t**)calloc_or_die( S->K, sizeof(size_t*) );
+  S->g_bp_f = (void**)calloc_or_die( S->K, sizeof(void*) );
+  S->g_bp_mapped_f = (size_t*)calloc_or_die( S->K, sizeof(size_t) );
+  S->g_dirty_f = (char**)calloc_or_die( S->K, sizeof(char*) );
+  S->g_zmin_f = (void**)calloc_or_die( S->K, sizeof(void*) );
+  S->g_zmin_row_size_f = (size_t*)calloc_or_die( S->K, sizeof(size_t) );
+  S->g_is_computed = FALSE ;
+  S->g_last_computed_frame = 0 ;
+/*}}}*/
+}
+
+/* Free the values of frame k and their offsets */
+static void
+g_store_free_frame_values( int k )
+{
+/*{{{*/
+  /* The slots of the sliding window own the arrays of the frames */
+  if( !S->SLIDING_WINDOW )
+  {
+    g_arena_free( S->g_arena_f[k], S->g_arena_mapped_f[k] );
+    g_arena_free( S->g_bp_f[k], S->g_bp_mapped_f[k] );
+    free( S->g_dirty_f[k] );
+    free( S->g_zmin_f[k] );
+  }
+  S->g_arena_f[k] = NULL ; S->g_arena_mapped_f[k] = 0 ;
+  S->g_bp_f[k] = NULL ; S->g_bp_mapped_f[k] = 0 ;
+  S->g_dirty_f[k] = (char*)NULL ;
+  S->g_zmin_f[k] = NULL ;
+  free( S->g_link_offset_f[k] ); S->g_link_offset_f[k] = (size_t*)NULL ;
+  S->g_n_values_f[k] = 0 ;
+  S->g_n_cells_f[k] = 0 ;
+/*}}}*/
+}
+
+static void
+g_store_free_frames()
+{
+/*{{{*/
+  for( int k = 0 ; k < S->K ; k++ )
+    g_store_free_frame_values( k );
+  free( S->g_arena_f ); S->g_arena_f = (void**)NULL ;
+  free( S->g_arena_mapped_f ); S->g_arena_mapped_f = (size_t*)NULL ;
+  free( S->g_n_values_f ); S->g_n_values_f = (size_t*)NULL ;
+  free( S->g_n_cells_f ); S->g_n_cells_f = (size_t*)NULL ;
+  free( S->g_link_offset_f ); S->g_link_offset_f = (size_t**)NULL ;
+  free( S->g_bp_f ); S->g_bp_f = (void**)NULL ;
+  free( S->g_bp_mapped_f ); S->g_bp_mapped_f = (size_t*)NULL ;
+  free( S->g_dirty_f ); S->g_dirty_f = (char**)NULL ;
+  free( S->g_zmin_f ); S->g_zmin_f = (void**)NULL ;
+  free( S->g_zmin_row_size_f ); S->g_zmin_row_size_f = (size_t*)NULL ;
+/*}}}*/
+}
 
 #ifdef ASTRE_HAS_NO_HOLES
   /*******************************************************************************
   
           Store for the G function computations.
   
-          g_fxl[k][idx(x,y)][l0] = G( x^k, y^k-1, l )
-  
-          The stored value is either the value of the G function if such a path
-          exists, or INFTY if none exists.
+          G( x^k, y^k-1, l ) = g_arena_f[k][ g_link_offset_f[k][x]
+                                             + (c - g_link_start_f[k][x])*g_cell_size_f[k] + l0 ]
+
+          where c is the cell of the link (x,y), see the description of the
+          links between the points.
   
-          NMAX = maximal index of a point = N-1
-          HMAX = maximal length of a hole starting from image k
-          idx(x,y) = x*(NMAX+1) + y
+          The stored value is either the code of the value of the G function
+          if such a path exists, or G_CODE_INFTY if none exists.
   
           n{k} = # of points in frame k (where frames = 0 .. K-1)
   
           k    = 1 .. K-1                                 Current frame of x
           x    = 0 .. n{k} - 1                            Index of x
           y    = 0 .. n{k-1} - 1                          Index of y
-          l    = 2 .. k+1
+          l    = 3 .. k+1
   
-  *******************************************************************************/
-  static float*** g_fxl ;
+          l0 = l - l_min = l - 3
+
+          g_cell_size_f[k] = # of lengths l in frame k
+
+          Without MAX_DISPLACEMENT, the cell (x,y) of frame k has index
+          x*n{k-1} + y.
   
+  *******************************************************************************/
   /* Macros to ease the access to the G array */
 
-  #define VDEFINE_MAX_points(max_x,k)  const int max_x = n_points_in_frame[(k)] - 1 ;
+  #define G_CELL_IDX(k,x,y)            g_link_find( (k), (x), 0, (y) )
+  #define G_CELL(k,x,y)                ( S->g_link_offset_f[(k)][(x)] \
+                                           + (G_CELL_IDX((k),(x),(y)) - S->g_link_start_f[(k)][(x)]) \
+                                             *S->g_cell_size_f[(k)] )
+
+
+  #define VDEFINE_MAX_points(max_x,k)  const int max_x = S->n_points_in_frame[(k)] - 1 ;
 
-  #define VDEFINE_MAX_l(max_l,k)       const int max_l = min_i( MAX_ALLOWED_TRAJECTORY_LENGTH, (k)+1 );
+  #define VDEFINE_MAX_l(max_l,k)       const int max_l = min_i( S->MAX_ALLOWED_TRAJECTORY_LENGTH, (k)+1 );
   #define VDEFINE_MIN_l(min_l,k)       const int min_l = 3 ;
   #define VDEFINE_BOUNDS_l(max_l,min_l,size_l0,k) \
                                        VDEFINE_MAX_l(max_l,(k)); \
                                        VDEFINE_MIN_l(min_l,(k)); \
                                        const int size_l0 = max_l - min_l + 1 ;
   
-  #define DEFINE_MAX_k                 const int __max_k = K-1 ;
+  #define DEFINE_MAX_k                 const int __max_k = S->K-1 ;
   
   #define DEFINE_MAX_x(k)              VDEFINE_MAX_points(__max_x,(k));
   #define DEFINE_MAX_y(p)              VDEFINE_MAX_points(__max_y,(p));
@@ -398,39 +1501,93 @@ char* partial_results_fname = (char*)NULL ;
   
   #define FORALL_x \
       DEFINE_MAX_x(k); \
-      char* activatedX = activated_fp[k] ; \
-      float** g_xl = g_fxl[k]; \
+      char* activatedX = S->activated_fp[k] ; \
       \
       for( int x = 0 ; x <= __max_x ; x++ ) \
       { \
-        if( !activatedX[x] ) continue ; \
-        const int x_idx = x*N ;
+        if( !activatedX[x] ) continue ;
   
   #define FORALL_y \
         const int p = k-1; \
-        DEFINE_MAX_y(p); \
         DEFINE_BOUNDS_l(k); \
-        char* activatedY = activated_fp[p] ; \
         \
-        for( int y = 0 ; y <= __max_y ; y++ ) \
-        { \
-          if( !activatedY[y] ) continue ; \
-          int xy_idx = x_idx + y ;
+        FORALL_LINKS(k,x,0,__size_l0,y,c,g_c)
 
   #define FORALL_l \
-          float* g_l = g_xl[xy_idx] ; \
+          const size_t g_l = g_c ; \
           \
           int l = __min_l ; \
-          float* g_l_first = &(g_l[0]); \
-          float* g_l_last = &(g_l[__size_l0]); \
+          const size_t g_l_last = g_l + __size_l0 ; \
           \
-          for( float* g_l_cur = g_l_first ; g_l_cur != g_l_last ; g_l_cur++, l++ ) \
+          for( size_t g_l_cur = g_l ; g_l_cur != g_l_last ; g_l_cur++, l++ ) \
           {
   
   #define END_FORALL_k }
   #define END_FORALL_x }
-  #define END_FORALL_y }
+  #define END_FORALL_y END_FORALL_LINKS
   #define END_FORALL_l }
+
+  /* Allocate the arena of G of frame k >= 1 once its links are known (the
+   * values are initialized by the computation), or only its size with a
+   * sliding window */
+  static void
+  g_store_init_frame( int k )
+  {
+  /*{{{*/
+    DEFINE_BOUNDS_l(k);
+
+    S->g_cell_size_f[k] = (size_t)max_i( __size_l0, 0 );
+    S->g_zmin_row_size_f[k] = S->g_cell_size_f[k] ;
+
+    /* The values of the links of x follow those of x-1 */
+    const int n_x = S->n_points_in_frame[k] ;
+    S->g_link_offset_f[k] = (size_t*)calloc_or_die( n_x+1, sizeof(size_t) );
+    for( int x = 0 ; x < n_x ; x++ )
+      S->g_link_offset_f[k][x+1] = S->g_link_offset_f[k][x]
+        + (S->g_link_start_f[k][x+1] - S->g_link_start_f[k][x])*S->g_cell_size_f[k] ;
+
+    S->g_n_cells_f[k] = S->g_link_start_f[k][n_x] ;
+    S->g_n_values_f[k] = S->g_link_offset_f[k][n_x] ;
+    if( !S->SLIDING_WINDOW ) g_store_alloc_frame( k );
+  /*}}}*/
+  }
+
+  static void
+  g_store_free_frame( int k )
+  {
+    g_store_free_frame_values( k );
+    S->g_cell_size_f[k] = 0 ;
+  }
+
+  /* Allocate the arrays of the frames */
+  static void
+  g_store_init_arrays()
+  {
+    g_store_alloc_frames_arrays();
+    S->g_cell_size_f = (size_t*)calloc_or_die( S->K, sizeof(size_t) );
+  }
+
+  static void
+  g_store_init()
+  {
+  /*{{{*/
+    g_store_init_arrays();
+
+    DEFINE_MAX_k ;
+    for( int k = 1 ; k <= __max_k ; k++ )
+      g_store_init_frame( k );
+  /*}}}*/
+  }
+
+  static void
+  g_store_free()
+  {
+  /*{{{*/
+    if( !S->g_arena_f ) return ;
+    g_store_free_frames();
+    free( S->g_cell_size_f ); S->g_cell_size_f = (size_t*)NULL ;
+  /*}}}*/
+  }
 #endif // ASTRE_HAS_NO_HOLES
 
 #ifdef ASTRE_HAS_HOLES
@@ -438,14 +1595,16 @@ char* partial_results_fname = (char*)NULL ;
   
           Store for the G function computations.
   
-          g_fxlsj[k][idx(x,y,h)][l0][s0][j0] = G( x^k, h, y^k-h-1, l, s, j )
-  
-          The stored value is either the value of the G function if such a path
-          exists, or INFTY if none exists.
+          G( x^k, h, y^k-h-1, l, s, j ) =
+            g_arena_f[k][ g_link_offset_f[k][xh]
+                          + (c - g_link_start_f[k][xh])*g_cell_size_fh[k][h]
+                          + g_lsj_offset_h[h][l0*(l0+1)/2 + s0] + j0 ]
+
+          where xh = G_XH(k,x,h) and c is the cell of the link (x,h,y), see
+          the description of the links between the points.
   
-          NMAX = maximal index of a point = N-1
-          HMAX = maximal length of a hole starting from image k
-          idx(x,y,h) = x*(NMAX+1)*(HMAX+1) + h*(NMAX+1) + y
+          The stored value is either the code of the value of the G function
+          if such a path exists, or G_CODE_INFTY if none exists.
   
           n{k} = # of points in frame k (where frames = 0 .. K-1)
   
@@ -453,27 +1612,44 @@ char* partial_results_fname = (char*)NULL ;
           h    = 0 .. min( MAX_ALLOWED_HOLE_LENGTH, k-1 )
           x    = 0 .. n{k} - 1                            Index of x
           y    = 0 .. n{k-h-1} - 1                        Index of y
-          l    = 2+h .. k+1
-          s    = 2 .. (l-h)                Size (number of present points) of traj
+          l    = 3+h .. k+1
+          s    = 3 .. (l-h)                Size (number of present points) of traj
           j    = eps_j .. min( l-s+1, s )
                                       Number of runs of consecutive present points
                                       where eps_j = 1 if h = 0
                                             eps_j = 2 otherwise
   
-          l0 = l - l_min = l - (2+h)
-          s0 = s - s_min = s - 2
+          l0 = l - l_min = l - (3+h)
+          s0 = s - s_min = s - 3
           j0 = j - j_min = j - eps_j
   
+          The values of a point x of frame k are made of one slab per hole
+          length h, each slab holding the cells of the points y linked to
+          (x,h), and a cell holds all the (l,s,j) values of (x,h,y).
+  
+          Since l0 = 0 .. size_l0-1, s0 = 0 .. l0 and the number of j only
+          depend on (h,l0,s0), the position of the (l0,s0) values inside a cell
+          is given by the triangular table g_lsj_offset_h[h], which does not
+          depend on the frame: a frame with fewer lengths simply uses a prefix
+          of the table.
+  
   *******************************************************************************/
-  static float***** g_fxlsj ;
   
   /* Macros to ease the access to the G array */
+
+  #define G_LS_IDX(l0,s0)              ( ((l0)*((l0)+1))/2 + (s0) )
+  #define G_CELL_IDX(k,x,h,y)          g_link_find( (k), (x), (h), (y) )
+  #define G_CELL(k,x,h,y)              ( S->g_link_offset_f[(k)][G_XH((k),(x),(h))] \
+                                           + (G_CELL_IDX((k),(x),(h),(y)) \
+                                              - S->g_link_start_f[(k)][G_XH((k),(x),(h))]) \
+                                             *S->g_cell_size_fh[(k)][(h)] )
+  #define G_LSJ(cell,h,l0,s0,j0)       ( (cell) + S->g_lsj_offset_h[(h)][G_LS_IDX((l0),(s0))] + (j0) )
   
-  #define VDEFINE_MAX_points(max_x,k)  const int max_x = n_points_in_frame[(k)] - 1 ;
+  #define VDEFINE_MAX_points(max_x,k)  const int max_x = S->n_points_in_frame[(k)] - 1 ;
 
-  #define VDEFINE_MAX_h(max_h,k)       const int max_h = min_i( (k)-1, MAX_ALLOWED_HOLE_LENGTH );
+  #define VDEFINE_MAX_h(max_h,k)       const int max_h = min_i( (k)-1, S->MAX_ALLOWED_HOLE_LENGTH );
 
-  #define VDEFINE_MAX_l(max_l,k,h)     const int max_l = min_i( MAX_ALLOWED_TRAJECTORY_LENGTH, (k)+1 );
+  #define VDEFINE_MAX_l(max_l,k,h)     const int max_l = min_i( S->MAX_ALLOWED_TRAJECTORY_LENGTH, (k)+1 );
   #define VDEFINE_MIN_l(min_l,k,h)     const int min_l = (h)+3 ;
   #define VDEFINE_BOUNDS_l(max_l,min_l,size_l0,k,h) \
                                        VDEFINE_MAX_l(max_l,(k),(h)); \
@@ -494,7 +1670,7 @@ char* partial_results_fname = (char*)NULL ;
                                        VDEFINE_MIN_j(min_j,(k),(h),(l),(s)); \
                                        const int size_j0 = max_j - min_j + 1 ;
   
-  #define DEFINE_MAX_k                 const int __max_k = K-1 ;
+  #define DEFINE_MAX_k                 const int __max_k = S->K-1 ;
   
   #define DEFINE_MAX_x(k)              VDEFINE_MAX_points(__max_x,(k));
   #define DEFINE_MAX_h(k)              VDEFINE_MAX_h(__max_h,(k));
@@ -542,61 +1718,170 @@ char* partial_results_fname = (char*)NULL ;
   #define FORALL_x \
       DEFINE_MAX_x(k); \
       DEFINE_MAX_h(k); \
-      char* activatedX = activated_fp[k] ; \
-      float**** g_xlsj = g_fxlsj[k]; \
+      char* activatedX = S->activated_fp[k] ; \
       \
       for( int x = 0 ; x <= __max_x ; x++ ) \
       { \
-        if( !activatedX[x] ) continue ; \
-        const int x_idx = x*N*(__max_h+1) ;
+        if( !activatedX[x] ) continue ;
   
   #define FORALL_h \
         for( int h = 0 ; h <= __max_h ; h++ ) \
         { \
-          const int xh_idx = x_idx + h*N ; \
+          const size_t g_cell_size = S->g_cell_size_fh[k][h] ; \
+          const size_t* g_ls_offset = S->g_lsj_offset_h[h] ; \
           const int p = k-h-1 ;
   
   #define FORALL_y \
-          DEFINE_MAX_y(p); \
           DEFINE_BOUNDS_l(k,h); \
-          char* activatedY = activated_fp[p] ; \
           \
-          for( int y = 0 ; y <= __max_y ; y++ ) \
-          { \
-            if( !activatedY[y] ) continue ; \
-            const int xhy_idx = xh_idx + y ;
+          FORALL_LINKS(k,x,h,g_cell_size,y,c,g_c)
   
   #define FORALL_l \
-            float*** g_lsj = g_xlsj[xhy_idx] ; \
+            const size_t g_lsj = g_c ; \
             \
             for( int l0 = 0, l = __min_l ; l0 < __size_l0 ; l0++, l++ ) \
             {
   
   #define FORALL_s \
               DEFINE_BOUNDS_s( k, h, l ); \
-              float** g_sj = g_lsj[l0] ; \
+              const size_t* g_s_offset = &(g_ls_offset[G_LS_IDX(l0,0)]) ; \
               \
               for( int s0 = 0, s = __min_s ; s0 < __size_s0 ; s0++, s++ ) \
               {
   
   #define FORALL_j \
                 DEFINE_BOUNDS_j( k, h, l, s ); \
-                float* g_j = g_sj[s0]; \
+                const size_t g_j = g_lsj + g_s_offset[s0]; \
                 \
                 int j = __min_j ; \
-                float* g_j_first = &(g_j[0]); \
-                float* g_j_after_last = &(g_j[__size_j0]); \
+                const size_t g_j_after_last = g_j + __size_j0 ; \
                 \
-                for( float* g_j_cur = g_j_first ; g_j_cur != g_j_after_last ; g_j_cur++, j++ ) \
+                for( size_t g_j_cur = g_j ; g_j_cur != g_j_after_last ; g_j_cur++, j++ ) \
                 {
   
   #define END_FORALL_k }
   #define END_FORALL_x }
   #define END_FORALL_h }
-  #define END_FORALL_y }
+  #define END_FORALL_y END_FORALL_LINKS
   #define END_FORALL_l }
   #define END_FORALL_s }
   #define END_FORALL_j }
+
+  /* Allocate the arrays of the frames and the offsets of the values inside
+   * the cells, which do not depend on the frames */
+  static void
+  g_store_init_arrays()
+  {
+  /*{{{*/
+    g_store_alloc_frames_arrays();
+    S->g_cell_size_fh = (size_t**)calloc_or_die( S->K, sizeof(size_t*) );
+    S->g_zmin_slab_offset_fh = (size_t**)calloc_or_die( S->K, sizeof(size_t*) );
+
+    /* Offsets of the (l0,s0) values inside a cell, for the longest lengths */
+    const int max_l = min_i( S->MAX_ALLOWED_TRAJECTORY_LENGTH, S->K );
+    const int max_h = max_i( 0, min_i( S->K-2, S->MAX_ALLOWED_HOLE_LENGTH ) );
+    S->g_lsj_offset_h = (size_t**)calloc_or_die( max_h+1, sizeof(size_t*) );
+    for( int h = 0 ; h <= max_h ; h++ )
+    {
+      DEFINE_MIN_l(0,h);
+      const int size_l0 = max_i( max_l - __min_l + 1, 0 );
+
+      S->g_lsj_offset_h[h] =
+        (size_t*)calloc_or_die( G_LS_IDX(size_l0,0)+1, sizeof(size_t) );
+
+      size_t offset = 0 ;
+      for( int l0 = 0, l = __min_l ; l0 < size_l0 ; l0++, l++ )
+      {
+        DEFINE_BOUNDS_s( 0, h, l );
+        for( int s0 = 0, s = __min_s ; s0 < __size_s0 ; s0++, s++ )
+        {
+          DEFINE_BOUNDS_j( 0, h, l, s );
+          S->g_lsj_offset_h[h][G_LS_IDX(l0,s0)] = offset ;
+          offset += __size_j0 ;
+        }
+      }
+      /* G_LS_IDX(size_l0,0) is the size of a cell having size_l0 lengths */
+      S->g_lsj_offset_h[h][G_LS_IDX(size_l0,0)] = offset ;
+    }
+  /*}}}*/
+  }
+
+  /* Allocate the arena of G of frame k >= 1 once its links are known (the
+   * values are initialized by the computation), or only its size with a
+   * sliding window */
+  static void
+  g_store_init_frame( int k )
+  {
+  /*{{{*/
+    DEFINE_MAX_h(k);
+
+    S->g_cell_size_fh[k] = (size_t*)calloc_or_die( __max_h+1, sizeof(size_t) );
+    S->g_zmin_slab_offset_fh[k] = (size_t*)calloc_or_die( __max_h+1, sizeof(size_t) );
+
+    size_t zmin_row_size = 0 ;
+    for( int h = 0 ; h <= __max_h ; h++ )
+    {
+      DEFINE_BOUNDS_l(k,h);
+
+      S->g_cell_size_fh[k][h] = S->g_lsj_offset_h[h][G_LS_IDX(max_i(__size_l0,0),0)] ;
+      S->g_zmin_slab_offset_fh[k][h] = zmin_row_size ;
+      zmin_row_size += S->g_cell_size_fh[k][h] ;
+    }
+    S->g_zmin_row_size_f[k] = zmin_row_size ;
+
+    /* The values of the links of (x,h) follow those of (x,h-1), and those
+     * of (x,0) follow those of (x-1,__max_h) */
+    const size_t n_xh = (size_t)S->n_points_in_frame[k]*(__max_h+1) ;
+    S->g_link_offset_f[k] = (size_t*)calloc_or_die( n_xh+1, sizeof(size_t) );
+    for( size_t xh = 0 ; xh < n_xh ; xh++ )
+      S->g_link_offset_f[k][xh+1] = S->g_link_offset_f[k][xh]
+        + (S->g_link_start_f[k][xh+1] - S->g_link_start_f[k][xh])
+          *S->g_cell_size_fh[k][xh % (__max_h+1)] ;
+
+    S->g_n_cells_f[k] = S->g_link_start_f[k][n_xh] ;
+    S->g_n_values_f[k] = S->g_link_offset_f[k][n_xh] ;
+    if( !S->SLIDING_WINDOW ) g_store_alloc_frame( k );
+  /*}}}*/
+  }
+
+  static void
+  g_store_free_frame( int k )
+  {
+    g_store_free_frame_values( k );
+    free( S->g_cell_size_fh[k] ); S->g_cell_size_fh[k] = (size_t*)NULL ;
+    free( S->g_zmin_slab_offset_fh[k] ); S->g_zmin_slab_offset_fh[k] = (size_t*)NULL ;
+  }
+
+  static void
+  g_store_init()
+  {
+  /*{{{*/
+    g_store_init_arrays();
+
+    DEFINE_MAX_k ;
+    for( int k = 1 ; k <= __max_k ; k++ )
+      g_store_init_frame( k );
+  /*}}}*/
+  }
+
+  static void
+  g_store_free()
+  {
+  /*{{{*/
+    if( !S->g_arena_f ) return ;
+    for( int k = 0 ; k < S->K ; k++ )
+    {
+      free( S->g_cell_size_fh[k] );
+      free( S->g_zmin_slab_offset_fh[k] );
+    }
+    g_store_free_frames();
+    const int max_h = max_i( 0, min_i( S->K-2, S->MAX_ALLOWED_HOLE_LENGTH ) );
+    for( int h = 0 ; h <= max_h ; h++ ) free( S->g_lsj_offset_h[h] );
+    free( S->g_lsj_offset_h ); S->g_lsj_offset_h = (size_t**)NULL ;
+    free( S->g_cell_size_fh ); S->g_cell_size_fh = (size_t**)NULL ;
+    free( S->g_zmin_slab_offset_fh ); S->g_zmin_slab_offset_fh = (size_t**)NULL ;
+  /*}}}*/
+  }
 #endif // ASTRE_HAS_HOLES
 
 /* Forward declarations */
@@ -604,24 +1889,16 @@ char* partial_results_fname = (char*)NULL ;
 #endif
 
 
-double find_minimal_NFA();
-#ifdef ASTRE_HAS_NO_HOLES
-char extract_trajectory_if_possible( int k, int x, int y, int l, double info_logNFA );
-#endif
-#ifdef ASTRE_HAS_HOLES
-char
-extract_trajectory_if_possible( int k,
-                                int x, int h, int y,
-                                int l, int s, int j,
-                                double info_logNFA );
-#endif
+static char extract_trajectory_if_possible( int n, const int* frames, const int* points,
+                                           double info_logNFA );
 
-char extract_and_disable_most_significant_trajectories ();
-void compute_most_significant_trajectories();
-void do_detect();
-void compute_caracteristics_of_trajectory( int starting_frame, int length, int* type, union u_ref_point* points, float* o_delta, int* o_s, int* o_j );
-double compute_log_NFA_of_trajectory( int starting_frame, int length, int* type, union u_ref_point* points );
-void info_on_traj( char* str );
+static char extract_and_disable_most_significant_trajectories( int last_k );
+static void compute_most_significant_trajectories( int last_k );
+static void do_detect();
+static void do_detect_windowed();
+static void do_detect_stream( points_desc_stream stream, FILE* out );
+static void compute_caracteristics_of_trajectory( int starting_frame, int length, int* type, union u_ref_point* points, float* o_delta, int* o_s, int* o_j );
+static double compute_log_NFA_of_trajectory( int starting_frame, int length, int* type, union u_ref_point* points );
 
 /* Discrete area
  *
@@ -673,10 +1950,6 @@ void info_on_traj( char* str );
  **********************************************************/
 
 static const double discrete_area_EPS = 1E-5 ;
-static int discrete_area_max_r = -1 ;
-static int discrete_area_max_r_sq = -1 ;
-static int discrete_area_width = -1 ;
-static double* discrete_area_data = (double*)NULL ;
 
 typedef struct
 {
@@ -698,3 +1971,6 @@ static void discrete_area_init(int max_r);
 static void discrete_area_free();
 static double discrete_area(int x, int y);
 
+
+static inline uint32_t criterion_code(int x, int y, int q);
+static inline float g_code_to_delta(uint32_t code);
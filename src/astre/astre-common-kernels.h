@@ -0,0 +1,604 @@
+/*
+    ASTRE a-contrario single trajectory extraction
+    Copyright (C) 2011 Mael Primet (mael.primet AT gmail.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*******************************************************************************
+
+        Kernels computing the G function.
+
+        This file is included once for each type of the G codes and each
+        instruction set, with:
+
+          G_KERNEL_CODE_T       the type of the codes (uint16_t or uint32_t)
+          G_KERNEL_CODE_BITS    the number of bits of this type
+          G_KERNEL_BP_T         the type of the argmin codes, of the same size
+          G_KERNEL_SIMD         the instruction set of the kernels (G_SIMD_*)
+          G_KERNEL(name)        the name of the kernel for this type and set
+
+        The codes are compared as unsigned integers, G_KERNEL_CODE_T being
+        able to hold all the codes up to G_CODE_MAX, and all ones meaning
+        INFTY, see the description of the criterion codes.
+
+        The kernels are compiled for the target of their instruction set, and
+        the runs of values relaxed by a point z are vectorized, see
+        astre-common-simd.h. The kernel used is selected at run time by
+        g_kernels_init(), depending on the processor and on SIMD_LEVEL, and
+        with holes on the maximal hole length, the AVX2 and AVX-512 kernels
+        being also specialised for the lengths 1 and 2.
+
+*******************************************************************************/
+
+#ifndef G_KERNEL_CODE_T
+  #error "Please define G_KERNEL_CODE_T and G_KERNEL before including this file"
+#endif
+
+#if G_KERNEL_SIMD == G_SIMD_AVX512
+  #define G_KERNEL_TARGET __attribute__((target("avx512f,avx512bw")))
+#elif G_KERNEL_SIMD == G_SIMD_AVX2
+  #define G_KERNEL_TARGET __attribute__((target("avx2")))
+#elif G_KERNEL_SIMD == G_SIMD_SSE41
+  #define G_KERNEL_TARGET __attribute__((target("sse4.1")))
+#else
+  #define G_KERNEL_TARGET
+#endif
+
+#include "astre-common-simd.h"
+
+#ifdef ASTRE_HAS_NO_HOLES
+/* Is one of the argmins bp_l of the cell (x,y) of frame k inactive or dirty? */
+G_KERNEL_TARGET static char
+G_KERNEL(cell_is_dirty)( int k, int y, const G_KERNEL_BP_T* bp_l, int size_l0 )
+{
+/*{{{*/
+  if( size_l0 <= 0 ) return FALSE ;
+
+  const int p = k-1 ;
+  char* activatedZ = S->activated_fp[k-2] ;
+  G_KERNEL_BP_T last_code = G_BP_NONE ;
+
+  for( int l0 = 0 ; l0 < size_l0 ; l0++ )
+  {
+    const G_KERNEL_BP_T code = bp_l[l0] ;
+    if( code == G_BP_NONE || code == last_code ) continue ;
+    last_code = code ;
+
+    const int z = (int)code-1 ;
+    if( !activatedZ[z] || S->g_dirty_f[p][G_CELL_IDX(p,y,z)] ) return TRUE ;
+  }
+
+  return FALSE ;
+/*}}}*/
+}
+
+/* Relax the values g_l (of argmins bp_l) of G( x^k, y^k-1, . ) with the point
+ * z of frame k-2, of argmin code bp_code, having the given criterion code and
+ * the size_l0_prev first values g_l_prev of G( y^k-1, z^k-2, . ). Returns TRUE
+ * if one of the values is improved.
+ *
+ * When check_only is set, the values are left unchanged, and the function
+ * tells whether they would be improved (bp_code = G_BP_NONE then stands for
+ * any point). */
+G_KERNEL_TARGET static inline char
+G_KERNEL(relax__z)( G_KERNEL_CODE_T* g_l, G_KERNEL_BP_T* bp_l,
+                    const G_KERNEL_CODE_T* g_l_prev, int size_l0_prev,
+                    G_KERNEL_CODE_T criterion, G_KERNEL_BP_T bp_code, const char check_only )
+{
+/*{{{*/
+  char is_improved = FALSE ;
+
+  /* The iteration here looks a bit cumbersome, because it was written
+   * in a way similar to that for the case with holes, where the
+   * iteration is more complex. This actually simply loops on all
+   * length len from 3 to (k+1), and the check whether the
+   * corresponding best trajectory of length len-1 ending on (z,y) and
+   * extended by (y,x) is better than the other extensions of length
+   * len ending on (y,x). */
+
+  /* Len == 3 */
+  if( G_IS_BETTER( g_l[0], bp_l[0], criterion, bp_code ) )
+  {
+    if( check_only ) return TRUE ;
+    g_l[0] = criterion ;
+    bp_l[0] = bp_code ;
+    is_improved = TRUE ;
+  }
+
+  /* Len > 3: G(x,y,k,l) is relaxed with G(y,z,k-1,l-1) */
+  if( G_KERNEL(relax_run)( g_l+1, bp_l+1, g_l_prev, size_l0_prev,
+                           criterion, bp_code, check_only ) )
+    is_improved = TRUE ;
+
+  return is_improved ;
+/*}}}*/
+}
+
+/* Compute G( x^k, y^k-1, l ) for all y and l, and collect the candidates */
+G_KERNEL_TARGET static void
+G_KERNEL(compute_most_significant_trajectories__x)( int k, int x, int thread )
+{
+/*{{{*/
+  char* activatedX = S->activated_fp[k] ;
+  if( !activatedX[x] ) return ;
+
+  const G_KERNEL_CODE_T G_INFTY = (G_KERNEL_CODE_T)G_CODE_INFTY ;
+
+  const float px_X = S->points_x_f[k][x] ;
+  const float px_Y = S->points_y_f[k][x] ;
+
+  const float* pointsY_X = S->points_x_f[k-1] ;
+  const float* pointsY_Y = S->points_y_f[k-1] ;
+
+  FORALL_y
+
+    const float py_X = pointsY_X[y] ;
+    const float py_Y = pointsY_Y[y] ;
+
+    G_KERNEL_CODE_T* g_l = (G_KERNEL_CODE_T*)S->g_arena_f[k] + g_c ;
+
+    /* Argmins of G(x,y,k,l) */
+    G_KERNEL_BP_T* bp_l = (G_KERNEL_BP_T*)S->g_bp_f[k] + g_c ;
+
+    /* Skip the cells that did not change since the last computation */
+    if( k <= S->g_check_dirty_frame )
+    {
+      char* dirty = &(S->g_dirty_f[k][c]) ;
+      *dirty = G_KERNEL(cell_is_dirty)( k, y, bp_l, __size_l0 );
+      if( !*dirty ) continue ;
+    }
+
+    /* Reinit the values for (x,y) */
+    for( int l0 = 0 ; l0 < __size_l0 ; l0++ )
+    {
+      g_l[l0] = G_INFTY ;
+      bp_l[l0] = G_BP_NONE ;
+    }
+
+    if( k <= 1 ) continue ;
+
+    DEFINE_BOUNDS_l_prev( p );
+    const G_KERNEL_CODE_T* g_arena_prev = (G_KERNEL_CODE_T*)S->g_arena_f[p] ;
+
+    /* The lengths of (y,z) that can be extended, ie. all of them unless the
+     * maximal trajectory length is reached */
+    const int __ext_l0_prev = min_i( __size_l0_prev, __size_l0-1 );
+
+    const int q = k-2 ;
+
+    if( !S->USE_SPATIAL_INDEX )
+    {
+      const float* pointsZ_X = S->points_x_f[q] ;
+      const float* pointsZ_Y = S->points_y_f[q] ;
+
+      /* The active points z linked to y */
+      FORALL_LINKS(p,y,0,__size_l0_prev,z,c_prev,g_c_prev)
+
+        const float pz_X = pointsZ_X[z] ;
+        const float pz_Y = pointsZ_Y[z] ;
+
+        ASTRE_DEFINE_CRITERION_CODE ;
+
+        G_KERNEL(relax__z)( g_l, bp_l, g_arena_prev + g_c_prev,
+                            __ext_l0_prev, criterion, (G_KERNEL_BP_T)G_BP_CODE(0,z), FALSE );
+
+      END_FORALL_LINKS /* END foreach( POINT z IN FRAME q ) */
+    }
+    else
+    {
+      /* All the points z are linked to y */
+      const G_KERNEL_CODE_T* g_y_prev = g_arena_prev + S->g_link_offset_f[p][G_XH(p,y,0)] ;
+
+      /* Visit the points z by rings around the position where the
+       * acceleration is null, until the points that are left can no longer
+       * improve any value of the cell */
+      const points_grid* grid = &(S->points_grid_f[q]) ;
+      const double pred_X = 2.0*py_X - px_X ;
+      const double pred_Y = 2.0*py_Y - px_Y ;
+      int cx, cy ;
+      points_grid_cell( grid, pred_X, pred_Y, &cx, &cy );
+
+      const G_KERNEL_CODE_T* zmin_l =
+        (G_KERNEL_CODE_T*)S->g_zmin_f[p] + (size_t)y*S->g_zmin_row_size_f[p] ;
+      int last_m = -1 ;
+
+      /* The grid only holds the active points */
+      FORALL_z_RINGS(grid,cx,cy)
+
+        const float pz_X = grid->xy[2*__zi+0] ;
+        const float pz_Y = grid->xy[2*__zi+1] ;
+
+        ASTRE_DEFINE_CRITERION_CODE ;
+
+        G_KERNEL(relax__z)( g_l, bp_l, g_y_prev + (size_t)z*__size_l0_prev,
+                            __ext_l0_prev, criterion, (G_KERNEL_BP_T)G_BP_CODE(0,z), FALSE );
+
+      END_FORALL_z_RING
+
+        const double d = points_grid_ring_distance( grid, pred_X, pred_Y, cx, cy, __r );
+        if( d < 0.0 ) break ;
+
+        /* The rounded accelerations of the points left are at least m (we
+         * keep one pixel for the rounding errors) */
+        const int m = (int)d - 1 ;
+        if( m > last_m )
+        {
+          last_m = m ;
+          const G_KERNEL_CODE_T lb = (G_KERNEL_CODE_T)criterion_code_lower_bound( m, q );
+          if( !G_KERNEL(relax__z)( g_l, bp_l, zmin_l, __ext_l0_prev, lb, G_BP_NONE, TRUE ) )
+            break ;
+        }
+
+      END_FORALL_z_RINGS
+    }
+
+    g_candidates_collect( k, x, y, thread );
+
+  END_FORALL_y
+/*}}}*/
+}
+
+/* Compute the minima over the active points z of G( y^p, z^p-1, . ) */
+G_KERNEL_TARGET static void
+G_KERNEL(compute_zmin__y)( int p, int y )
+{
+/*{{{*/
+  const G_KERNEL_CODE_T G_INFTY = (G_KERNEL_CODE_T)G_CODE_INFTY ;
+  DEFINE_BOUNDS_l(p);
+
+  G_KERNEL_CODE_T* zmin_l = (G_KERNEL_CODE_T*)S->g_zmin_f[p] + (size_t)y*S->g_zmin_row_size_f[p] ;
+  for( int l0 = 0 ; l0 < __size_l0 ; l0++ )
+    zmin_l[l0] = G_INFTY ;
+
+  if( !S->activated_fp[p][y] ) return ;
+
+  const int* activeZ = S->active_fp[p-1] ;
+  /* The spatial index is only used when all the points z are linked to y */
+  const G_KERNEL_CODE_T* g_y = (G_KERNEL_CODE_T*)S->g_arena_f[p] + S->g_link_offset_f[p][G_XH(p,y,0)] ;
+
+  for( int i = 0 ; i < S->n_active_f[p-1] ; i++ )
+  {
+    const int z = activeZ[i] ;
+    const G_KERNEL_CODE_T* g_l = g_y + (size_t)z*__size_l0 ;
+    for( int l0 = 0 ; l0 < __size_l0 ; l0++ )
+      if( g_l[l0] < zmin_l[l0] ) zmin_l[l0] = g_l[l0] ;
+  }
+/*}}}*/
+}
+#endif
+#ifdef ASTRE_HAS_HOLES
+/* Is one of the argmins bp_lsj of the cell (x,h,y) of frame k inactive or dirty? */
+G_KERNEL_TARGET static char
+G_KERNEL(cell_is_dirty)( int k, int h, int y, const G_KERNEL_BP_T* bp_lsj, size_t cell_size )
+{
+/*{{{*/
+  const int p = k-h-1 ;
+  G_KERNEL_BP_T last_code = G_BP_NONE ;
+
+  for( size_t i = 0 ; i < cell_size ; i++ )
+  {
+    const G_KERNEL_BP_T code = bp_lsj[i] ;
+    if( code == G_BP_NONE || code == last_code ) continue ;
+    last_code = code ;
+
+    const int h2 = (int)((code-1) / (uint32_t)S->N) ;
+    const int z = (int)((code-1) % (uint32_t)S->N) ;
+    if( !S->activated_fp[p-1-h2][z] || S->g_dirty_f[p][G_CELL_IDX(p,y,h2,z)] )
+      return TRUE ;
+  }
+
+  return FALSE ;
+/*}}}*/
+}
+
+/* Relax the values g_lsj (of argmins bp_lsj) of G( x^k, h, y^k-h-1, . ) with
+ * the point z of frame q = k-h-h2-2, having the given criterion code and the
+ * values g_lsj_prev of G( y^k-h-1, h2, z^q, . ). Returns TRUE if one of the
+ * values is improved.
+ *
+ * When check_only is set, the values are left unchanged, and the function
+ * tells whether they would be improved (bp_code = G_BP_NONE then stands for
+ * any point). */
+G_KERNEL_TARGET static inline __attribute__((always_inline)) char
+G_KERNEL(relax__h2z)( G_KERNEL_CODE_T* g_lsj, G_KERNEL_BP_T* bp_lsj, int k, int h, int h2,
+                      const G_KERNEL_CODE_T* g_lsj_prev,
+                      G_KERNEL_CODE_T criterion, G_KERNEL_BP_T bp_code, const char check_only )
+{
+/*{{{*/
+  char is_improved = FALSE ;
+  const int p = k-h-1 ;
+  const int q = p-1-h2 ;
+
+  /* if there is a hole (h > 0), the next j we are looking for is cur_j - eps_j */
+  const int eps_j = h == 0 ? 0 : 1 ;
+
+  /* the next l we are looking for is cur_l - delta_l */
+  const int delta_l = h+1 ;
+
+  DEFINE_BOUNDS_l_prev( p, h2 );
+  DEFINE_MAX_l( k, h );
+
+  /* Criterion initialization, unless it exceeds the maximal length */
+  if( k-q+1 <= __max_l )
+  {
+    int l = k-q+1 ;
+    int s = 3 ;
+    int j = 1+(h==0?0:1)+(h2==0?0:1) ;
+
+    DEFINE_MIN_l(k,h);
+    DEFINE_MIN_s(k,h,l);
+    DEFINE_MIN_j(k,h,l,s);
+
+#ifdef ALL_CHECKS
+    C_assert( l >= __min_l );
+    C_assert( s >= __min_s );
+    C_assert( j >= __min_j );
+#endif
+
+    const size_t init = G_LSJ( 0, h, l-__min_l, s-__min_s, j-__min_j );
+    if( G_IS_BETTER( g_lsj[init], bp_lsj[init], criterion, bp_code ) )
+    {
+      if( check_only ) return TRUE ;
+      g_lsj[init] = criterion ;
+      bp_lsj[init] = bp_code ;
+      is_improved = TRUE ;
+    }
+  }
+
+  for( int l0_prev = 0, l_prev = __min_l_prev ; l0_prev < __size_l0_prev ; l0_prev++, l_prev++ )
+  {
+    const size_t* g_s_offset_prev = &(S->g_lsj_offset_h[h2][G_LS_IDX(l0_prev,0)]) ;
+
+    DEFINE_BOUNDS_s_prev( p, h2, l_prev );
+
+    const int l = l_prev + delta_l ;
+    if( l > __max_l ) break ;
+    DEFINE_MIN_l(k,h);
+    const size_t* g_s_offset = &(S->g_lsj_offset_h[h][G_LS_IDX(l-__min_l,0)]) ;
+
+    DEFINE_MIN_s( k, h1, l );
+
+    for( int s0_prev = 0, s_prev = __min_s_prev ; s0_prev < __size_s0_prev ; s0_prev++, s_prev++ )
+    {
+      const G_KERNEL_CODE_T* g_j_prev = g_lsj_prev + g_s_offset_prev[s0_prev];
+
+      DEFINE_BOUNDS_j_prev( p, h2, l_prev, s_prev );
+
+      const int s = s_prev + 1 ;
+      DEFINE_MIN_j( k, h, l, s );
+
+      int j_fst = __min_j_prev + eps_j ; /* eps_j = 1 if there is a hole (h > 0) */
+      const size_t g_j_cur = g_s_offset[s-__min_s] + (j_fst-__min_j) ;
+
+      /* The runs j of (l,s) are relaxed with the runs j-eps_j of (l_prev,s_prev) */
+      if( G_KERNEL(relax_run)( g_lsj + g_j_cur, bp_lsj + g_j_cur, g_j_prev, __size_j0_prev,
+                               criterion, bp_code, check_only ) )
+      {
+        if( check_only ) return TRUE ;
+        is_improved = TRUE ;
+      }
+    } /* END foreach( SIZE s ) */
+  } /* END foreach( LENGTH l ) */
+
+  return is_improved ;
+/*}}}*/
+}
+
+/* Compute G( x^k, h, y^k-h-1, l, s, j ) for all y, l, s, j, and collect the
+ * candidates. max_h is the maximal hole length when the kernel is specialised
+ * for it (h and max_h being then constants), -1 otherwise. */
+G_KERNEL_TARGET static inline __attribute__((always_inline)) void
+G_KERNEL(compute_xh)( int k, int x, int h, int thread, const int max_h )
+{
+/*{{{*/
+  char* activatedX = S->activated_fp[k] ;
+  if( !activatedX[x] ) return ;
+
+  const G_KERNEL_CODE_T G_INFTY = (G_KERNEL_CODE_T)G_CODE_INFTY ;
+
+  const size_t g_cell_size = S->g_cell_size_fh[k][h] ;
+  const int p = k-h-1 ;
+
+  const float px_X = S->points_x_f[k][x] ;
+  const float px_Y = S->points_y_f[k][x] ;
+
+  const float* pointsY_X = S->points_x_f[p] ;
+  const float* pointsY_Y = S->points_y_f[p] ;
+
+  /* constants initialization */
+  const float f_h1_p1 = (float)h+1.0 ;
+
+  const int __max_h_prev = min_i( p-1, max_h < 0 ? S->MAX_ALLOWED_HOLE_LENGTH : max_h ) ;
+
+  FORALL_y
+
+    const float py_X = pointsY_X[y] ;
+    const float py_Y = pointsY_Y[y] ;
+
+    G_KERNEL_CODE_T* g_lsj = (G_KERNEL_CODE_T*)S->g_arena_f[k] + g_c ;
+
+    /* Argmins of G(x,h,y,k,l,s,j) */
+    G_KERNEL_BP_T* bp_lsj = (G_KERNEL_BP_T*)S->g_bp_f[k] + g_c ;
+
+    /* Skip the cells that did not change since the last computation */
+    if( k <= S->g_check_dirty_frame )
+    {
+      char* dirty = &(S->g_dirty_f[k][c]) ;
+      *dirty = G_KERNEL(cell_is_dirty)( k, h, y, bp_lsj, g_cell_size );
+      if( !*dirty ) continue ;
+    }
+
+    /* Reinit the values for (x,h,y), which are contiguous in the cell */
+    for( size_t i = 0 ; i < g_cell_size ; i++ )
+    {
+      g_lsj[i] = G_INFTY ;
+      bp_lsj[i] = G_BP_NONE ;
+    }
+
+    #pragma GCC unroll 4
+    for( int h2 = 0 ; h2 <= __max_h_prev ; h2++ )
+    {
+      const G_KERNEL_CODE_T* g_arena_prev = (G_KERNEL_CODE_T*)S->g_arena_f[p] ;
+      const size_t g_cell_size_prev = S->g_cell_size_fh[p][h2] ;
+      const float f_h2_p1 = (float)h2+1.0 ;
+
+      const int q = p-1-h2 ;
+
+      if( !S->USE_SPATIAL_INDEX )
+      {
+        const float* pointsZ_X = S->points_x_f[q] ;
+        const float* pointsZ_Y = S->points_y_f[q] ;
+
+        /* The active points z linked to (y,h2) */
+        FORALL_LINKS(p,y,h2,g_cell_size_prev,z,c_prev,g_c_prev)
+
+          const float pz_X = pointsZ_X[z] ;
+          const float pz_Y = pointsZ_Y[z] ;
+
+          ASTRE_DEFINE_CRITERION_CODE ;
+
+          /* Code of the predecessor (h2,z) stored in the argmins */
+          const G_KERNEL_BP_T bp_code = (G_KERNEL_BP_T)G_BP_CODE(h2,z) ;
+
+          G_KERNEL(relax__h2z)( g_lsj, bp_lsj, k, h, h2, g_arena_prev + g_c_prev,
+                                criterion, bp_code, FALSE );
+
+        END_FORALL_LINKS /* END foreach( POINT z IN FRAME q ) */
+      }
+      else
+      {
+        /* All the points z are linked to (y,h2) */
+        const G_KERNEL_CODE_T* g_yh2_prev = g_arena_prev + S->g_link_offset_f[p][G_XH(p,y,h2)] ;
+
+        /* Visit the points z by rings around the position where the
+         * acceleration is null, until the points that are left can no longer
+         * improve any value of the cell */
+        const points_grid* grid = &(S->points_grid_f[q]) ;
+        const double pred_X = py_X - (double)f_h2_p1*(px_X-py_X)/(double)f_h1_p1 ;
+        const double pred_Y = py_Y - (double)f_h2_p1*(px_Y-py_Y)/(double)f_h1_p1 ;
+        int cx, cy ;
+        points_grid_cell( grid, pred_X, pred_Y, &cx, &cy );
+
+        const G_KERNEL_CODE_T* zmin_lsj = (G_KERNEL_CODE_T*)S->g_zmin_f[p]
+          + (size_t)y*S->g_zmin_row_size_f[p] + S->g_zmin_slab_offset_fh[p][h2] ;
+        int last_m = -1 ;
+
+        /* The grid only holds the active points */
+        FORALL_z_RINGS(grid,cx,cy)
+
+          const float pz_X = grid->xy[2*__zi+0] ;
+          const float pz_Y = grid->xy[2*__zi+1] ;
+
+          ASTRE_DEFINE_CRITERION_CODE ;
+
+          /* Code of the predecessor (h2,z) stored in the argmins */
+          const G_KERNEL_BP_T bp_code = (G_KERNEL_BP_T)G_BP_CODE(h2,z) ;
+
+          G_KERNEL(relax__h2z)( g_lsj, bp_lsj, k, h, h2,
+                                g_yh2_prev + (size_t)z*g_cell_size_prev,
+                                criterion, bp_code, FALSE );
+
+        END_FORALL_z_RING
+
+          const double d = points_grid_ring_distance( grid, pred_X, pred_Y, cx, cy, __r );
+          if( d < 0.0 ) break ;
+
+          /* The rounded accelerations of the points left are at least m (we
+           * keep one unit for the rounding errors) */
+          const int m = (int)(d/(double)f_h2_p1) - 1 ;
+          if( m > last_m )
+          {
+            last_m = m ;
+            const G_KERNEL_CODE_T lb = (G_KERNEL_CODE_T)criterion_code_lower_bound( m, q );
+            if( !G_KERNEL(relax__h2z)( g_lsj, bp_lsj, k, h, h2, zmin_lsj, lb, G_BP_NONE, TRUE ) )
+              break ;
+          }
+
+        END_FORALL_z_RINGS
+      }
+    } /* END foreach( HOLE LENGTH h2 ) */
+
+    g_candidates_collect( k, x, h, y, thread );
+
+  END_FORALL_y
+/*}}}*/
+}
+
+G_KERNEL_TARGET static void
+G_KERNEL(compute_most_significant_trajectories__xh)( int k, int x, int h, int thread )
+{
+  G_KERNEL(compute_xh)( k, x, h, thread, -1 );
+}
+
+/* Kernels specialised for the usual maximal hole lengths max_h = 1 and 2:
+ * the hole lengths h and h2 are constants, the loops over h2 are unrolled and
+ * the bounds of l, s and j depending on them are folded. Each specialisation
+ * inlines max_h+1 copies of compute_xh, hence only these two, and only for
+ * the instruction sets of the current processors */
+#if G_KERNEL_SIMD >= G_SIMD_AVX2
+#define G_KERNEL_COMPUTE_XH_MAX_h(max_h) \
+  G_KERNEL_TARGET static void \
+  G_KERNEL(compute_most_significant_trajectories__xh__h##max_h)( int k, int x, int h, int thread ) \
+  { \
+    switch( h ) \
+    { \
+      case 0 : G_KERNEL(compute_xh)( k, x, 0, thread, max_h ); break ; \
+      case 1 : G_KERNEL(compute_xh)( k, x, 1, thread, max_h ); break ; \
+      case 2 : if( max_h >= 2 ) G_KERNEL(compute_xh)( k, x, 2, thread, max_h ); break ; \
+    } \
+  }
+
+G_KERNEL_COMPUTE_XH_MAX_h(1)
+G_KERNEL_COMPUTE_XH_MAX_h(2)
+
+#undef G_KERNEL_COMPUTE_XH_MAX_h
+#endif
+
+/* Compute the minima over the active points z of G( y^p, h2, z^p-h2-1, . ) */
+G_KERNEL_TARGET static void
+G_KERNEL(compute_zmin__y)( int p, int y )
+{
+/*{{{*/
+  const G_KERNEL_CODE_T G_INFTY = (G_KERNEL_CODE_T)G_CODE_INFTY ;
+
+  G_KERNEL_CODE_T* zmin_y = (G_KERNEL_CODE_T*)S->g_zmin_f[p] + (size_t)y*S->g_zmin_row_size_f[p] ;
+  for( size_t i = 0 ; i < S->g_zmin_row_size_f[p] ; i++ )
+    zmin_y[i] = G_INFTY ;
+
+  if( !S->activated_fp[p][y] ) return ;
+
+  DEFINE_MAX_h( p );
+  for( int h2 = 0 ; h2 <= __max_h ; h2++ )
+  {
+    const int q = p-1-h2 ;
+    const int* activeZ = S->active_fp[q] ;
+    const size_t g_cell_size = S->g_cell_size_fh[p][h2] ;
+    /* The spatial index is only used when all the points z are linked to (y,h2) */
+    const G_KERNEL_CODE_T* g_yh2 = (G_KERNEL_CODE_T*)S->g_arena_f[p] + S->g_link_offset_f[p][G_XH(p,y,h2)] ;
+    G_KERNEL_CODE_T* zmin_lsj = zmin_y + S->g_zmin_slab_offset_fh[p][h2] ;
+
+    for( int i = 0 ; i < S->n_active_f[q] ; i++ )
+    {
+      const int z = activeZ[i] ;
+      const G_KERNEL_CODE_T* g_lsj = g_yh2 + (size_t)z*g_cell_size ;
+      for( size_t i = 0 ; i < g_cell_size ; i++ )
+        if( g_lsj[i] < zmin_lsj[i] ) zmin_lsj[i] = g_lsj[i] ;
+    }
+  }
+/*}}}*/
+}
+#endif
+
+#undef G_KERNEL_TARGET
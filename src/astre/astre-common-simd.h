@@ -0,0 +1,250 @@
+/*
+    ASTRE a-contrario single trajectory extraction
+    Copyright (C) 2011 Mael Primet (mael.primet AT gmail.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*******************************************************************************
+
+        Relaxation of a run of G values.
+
+        This file is included by astre-common-kernels.h, once for each type
+        of the G codes and of the argmin codes (both of G_KERNEL_CODE_BITS
+        bits) and each instruction set G_KERNEL_SIMD, and defines
+        G_KERNEL(relax_run), which relaxes n contiguous values of G:
+
+          g[i] = max( criterion, g_prev[i] ),  bp[i] = bp_code
+
+        for all the i such that the new value is better (see G_IS_BETTER).
+        Every i is independent of the others, so the vector versions give
+        exactly the same results as the scalar one.
+
+        The vector versions compare the codes as unsigned integers of the
+        size of G_KERNEL_CODE_T, and the 16 bits argmins as unsigned integers
+        (the 32 bits ones, which are lower than 2^31, as signed integers).
+
+*******************************************************************************/
+
+#ifndef G_KERNEL_SIMD
+  #error "Please define G_KERNEL_SIMD before including this file"
+#endif
+
+/* Scalar relaxation of the values i0 .. n-1 of the run */
+G_KERNEL_TARGET static inline char
+G_KERNEL(relax_run_scalar)( G_KERNEL_CODE_T* restrict g, G_KERNEL_BP_T* restrict bp,
+                            const G_KERNEL_CODE_T* restrict g_prev, int i0, int n,
+                            G_KERNEL_CODE_T criterion, G_KERNEL_BP_T bp_code, const char check_only )
+{
+/*{{{*/
+  char is_improved = FALSE ;
+
+  for( int i = i0 ; i < n ; i++ )
+  {
+    G_KERNEL_CODE_T delta_prev = g_prev[i] ;
+    G_KERNEL_CODE_T updated_criterion = criterion > delta_prev ? criterion : delta_prev ;
+
+    if( G_IS_BETTER( g[i], bp[i], updated_criterion, bp_code ) )
+    {
+      if( check_only ) return TRUE ;
+      g[i] = updated_criterion ;
+      bp[i] = bp_code ;
+      is_improved = TRUE ;
+    }
+  }
+
+  return is_improved ;
+/*}}}*/
+}
+
+/* Relax the n values g (of argmins bp) with the values g_prev, extended by a
+ * point of criterion code criterion and of argmin code bp_code. Returns TRUE
+ * if one of the values is improved. When check_only is set, the values are
+ * left unchanged, and the function tells whether they would be improved. */
+G_KERNEL_TARGET static inline char
+G_KERNEL(relax_run)( G_KERNEL_CODE_T* restrict g, G_KERNEL_BP_T* restrict bp,
+                     const G_KERNEL_CODE_T* restrict g_prev, int n,
+                     G_KERNEL_CODE_T criterion, G_KERNEL_BP_T bp_code, const char check_only )
+{
+/*{{{*/
+  /* The short runs (as the runs j of the holes version often are) are
+   * relaxed by the scalar version: less than a vector for SSE4.1 and AVX2,
+   * and less than half a vector for AVX-512 */
+#if G_KERNEL_SIMD == G_SIMD_SCALAR
+  return G_KERNEL(relax_run_scalar)( g, bp, g_prev, 0, n, criterion, bp_code, check_only );
+#else
+  const int min_run = G_KERNEL_SIMD == G_SIMD_SSE41 ? 128/G_KERNEL_CODE_BITS : 256/G_KERNEL_CODE_BITS ;
+  if( n < min_run )
+    return G_KERNEL(relax_run_scalar)( g, bp, g_prev, 0, n, criterion, bp_code, check_only );
+#endif
+
+#if G_KERNEL_SIMD == G_SIMD_SSE41
+  char is_improved = FALSE ;
+  int i = 0 ;
+  const __m128i v_ones = _mm_set1_epi32( -1 );
+
+ #if G_KERNEL_CODE_BITS == 16
+  const __m128i v_bp = _mm_set1_epi16( (short)bp_code );
+  const __m128i v_crit = _mm_set1_epi16( (short)criterion );
+  for( ; i+8 <= n ; i += 8 )
+  {
+    __m128i cur = _mm_loadu_si128( (const __m128i*)(g+i) );
+    __m128i upd = _mm_max_epu16( v_crit, _mm_loadu_si128( (const __m128i*)(g_prev+i) ) );
+
+    /* cur > upd, or cur == upd and bp_code < bp */
+    __m128i is_le = _mm_cmpeq_epi16( _mm_max_epu16( cur, upd ), upd );
+    __m128i is_eq = _mm_cmpeq_epi16( cur, upd );
+    __m128i bp0 = _mm_loadu_si128( (const __m128i*)(bp+i) );
+    __m128i bp_le = _mm_cmpeq_epi16( _mm_max_epu16( bp0, v_bp ), v_bp );
+    __m128i better = _mm_or_si128( _mm_andnot_si128( bp_le, is_eq ), _mm_xor_si128( is_le, v_ones ) );
+    if( !_mm_movemask_epi8( better ) ) continue ;
+    if( check_only ) return TRUE ;
+
+    _mm_storeu_si128( (__m128i*)(g+i), _mm_blendv_epi8( cur, upd, better ) );
+    _mm_storeu_si128( (__m128i*)(bp+i), _mm_blendv_epi8( bp0, v_bp, better ) );
+    is_improved = TRUE ;
+  }
+ #else
+  const __m128i v_bp = _mm_set1_epi32( (int)bp_code );
+  const __m128i v_crit = _mm_set1_epi32( (int)criterion );
+  for( ; i+4 <= n ; i += 4 )
+  {
+    __m128i cur = _mm_loadu_si128( (const __m128i*)(g+i) );
+    __m128i upd = _mm_max_epu32( v_crit, _mm_loadu_si128( (const __m128i*)(g_prev+i) ) );
+
+    /* cur > upd, or cur == upd and bp_code < bp */
+    __m128i is_le = _mm_cmpeq_epi32( _mm_max_epu32( cur, upd ), upd );
+    __m128i is_eq = _mm_cmpeq_epi32( cur, upd );
+    __m128i bp0 = _mm_loadu_si128( (const __m128i*)(bp+i) );
+    __m128i bp_gt = _mm_cmpgt_epi32( bp0, v_bp );
+    __m128i better = _mm_or_si128( _mm_and_si128( is_eq, bp_gt ), _mm_xor_si128( is_le, v_ones ) );
+    if( !_mm_movemask_epi8( better ) ) continue ;
+    if( check_only ) return TRUE ;
+
+    _mm_storeu_si128( (__m128i*)(g+i), _mm_blendv_epi8( cur, upd, better ) );
+    _mm_storeu_si128( (__m128i*)(bp+i), _mm_blendv_epi8( bp0, v_bp, better ) );
+    is_improved = TRUE ;
+  }
+ #endif
+
+  if( G_KERNEL(relax_run_scalar)( g, bp, g_prev, i, n, criterion, bp_code, check_only ) )
+    is_improved = TRUE ;
+  return is_improved ;
+#endif
+
+#if G_KERNEL_SIMD == G_SIMD_AVX2
+  char is_improved = FALSE ;
+  int i = 0 ;
+  const __m256i v_ones = _mm256_set1_epi32( -1 );
+
+ #if G_KERNEL_CODE_BITS == 16
+  const __m256i v_bp = _mm256_set1_epi16( (short)bp_code );
+  const __m256i v_crit = _mm256_set1_epi16( (short)criterion );
+  for( ; i+16 <= n ; i += 16 )
+  {
+    __m256i cur = _mm256_loadu_si256( (const __m256i*)(g+i) );
+    __m256i upd = _mm256_max_epu16( v_crit, _mm256_loadu_si256( (const __m256i*)(g_prev+i) ) );
+
+    /* cur > upd, or cur == upd and bp_code < bp */
+    __m256i is_le = _mm256_cmpeq_epi16( _mm256_max_epu16( cur, upd ), upd );
+    __m256i is_eq = _mm256_cmpeq_epi16( cur, upd );
+    __m256i bp0 = _mm256_loadu_si256( (const __m256i*)(bp+i) );
+    __m256i bp_le = _mm256_cmpeq_epi16( _mm256_max_epu16( bp0, v_bp ), v_bp );
+    __m256i better = _mm256_or_si256( _mm256_andnot_si256( bp_le, is_eq ),
+                                      _mm256_xor_si256( is_le, v_ones ) );
+    if( !_mm256_movemask_epi8( better ) ) continue ;
+    if( check_only ) return TRUE ;
+
+    _mm256_storeu_si256( (__m256i*)(g+i), _mm256_blendv_epi8( cur, upd, better ) );
+    _mm256_storeu_si256( (__m256i*)(bp+i), _mm256_blendv_epi8( bp0, v_bp, better ) );
+    is_improved = TRUE ;
+  }
+ #else
+  const __m256i v_bp = _mm256_set1_epi32( (int)bp_code );
+  const __m256i v_crit = _mm256_set1_epi32( (int)criterion );
+  for( ; i+8 <= n ; i += 8 )
+  {
+    __m256i cur = _mm256_loadu_si256( (const __m256i*)(g+i) );
+    __m256i upd = _mm256_max_epu32( v_crit, _mm256_loadu_si256( (const __m256i*)(g_prev+i) ) );
+
+    /* cur > upd, or cur == upd and bp_code < bp */
+    __m256i is_le = _mm256_cmpeq_epi32( _mm256_max_epu32( cur, upd ), upd );
+    __m256i is_eq = _mm256_cmpeq_epi32( cur, upd );
+    __m256i bp0 = _mm256_loadu_si256( (const __m256i*)(bp+i) );
+    __m256i bp_gt = _mm256_cmpgt_epi32( bp0, v_bp );
+    __m256i better = _mm256_or_si256( _mm256_and_si256( is_eq, bp_gt ), _mm256_xor_si256( is_le, v_ones ) );
+    if( !_mm256_movemask_epi8( better ) ) continue ;
+    if( check_only ) return TRUE ;
+
+    _mm256_storeu_si256( (__m256i*)(g+i), _mm256_blendv_epi8( cur, upd, better ) );
+    _mm256_storeu_si256( (__m256i*)(bp+i), _mm256_blendv_epi8( bp0, v_bp, better ) );
+    is_improved = TRUE ;
+  }
+ #endif
+
+  if( G_KERNEL(relax_run_scalar)( g, bp, g_prev, i, n, criterion, bp_code, check_only ) )
+    is_improved = TRUE ;
+  return is_improved ;
+#endif
+
+#if G_KERNEL_SIMD == G_SIMD_AVX512
+  /* The masked loads and stores also handle the last values of the run */
+  char is_improved = FALSE ;
+
+ #if G_KERNEL_CODE_BITS == 16
+  const __m512i v_bp = _mm512_set1_epi16( (short)bp_code );
+  const __m512i v_crit = _mm512_set1_epi16( (short)criterion );
+  for( int i = 0 ; i < n ; i += 32 )
+  {
+    const __mmask32 m = n-i >= 32 ? (__mmask32)0xFFFFFFFF : (__mmask32)((1U << (n-i)) - 1) ;
+    __m512i cur = _mm512_maskz_loadu_epi16( m, g+i );
+    __m512i upd = _mm512_max_epu16( v_crit, _mm512_maskz_loadu_epi16( m, g_prev+i ) );
+
+    /* cur > upd, or cur == upd and bp_code < bp */
+    const __mmask32 bp_gt = _mm512_cmpgt_epu16_mask( _mm512_maskz_loadu_epi16( m, bp+i ), v_bp );
+    const __mmask32 better = m & ( _mm512_cmpgt_epu16_mask( cur, upd )
+                                 | (_mm512_cmpeq_epi16_mask( cur, upd ) & bp_gt) );
+    if( !better ) continue ;
+    if( check_only ) return TRUE ;
+
+    _mm512_mask_storeu_epi16( g+i, better, upd );
+    _mm512_mask_storeu_epi16( bp+i, better, v_bp );
+    is_improved = TRUE ;
+  }
+ #else
+  const __m512i v_bp = _mm512_set1_epi32( (int)bp_code );
+  const __m512i v_crit = _mm512_set1_epi32( (int)criterion );
+  for( int i = 0 ; i < n ; i += 16 )
+  {
+    const __mmask16 m = n-i >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1U << (n-i)) - 1) ;
+    __m512i cur = _mm512_maskz_loadu_epi32( m, g+i );
+    __m512i upd = _mm512_max_epu32( v_crit, _mm512_maskz_loadu_epi32( m, g_prev+i ) );
+
+    /* cur > upd, or cur == upd and bp_code < bp */
+    const __mmask16 bp_gt = _mm512_cmpgt_epi32_mask( _mm512_maskz_loadu_epi32( m, bp+i ), v_bp );
+    const __mmask16 better = m & ( _mm512_cmpgt_epu32_mask( cur, upd )
+                                 | (_mm512_cmpeq_epi32_mask( cur, upd ) & bp_gt) );
+    if( !better ) continue ;
+    if( check_only ) return TRUE ;
+
+    _mm512_mask_storeu_epi32( g+i, better, upd );
+    _mm512_mask_storeu_epi32( bp+i, better, v_bp );
+    is_improved = TRUE ;
+  }
+ #endif
+
+  return is_improved ;
+#endif
+/*}}}*/
+}
@@ -0,0 +1,688 @@
+/*
+    ASTRE a-contrario single trajectory extraction
+    Copyright (C) 2011 Mael Primet (mael.primet AT gmail.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <vision/core.h>
+#include <vision/math/combinatorics.h>
+#include <vision/trajs/pointsdesc.h>
+#include <vision/trajs/trajs.h>
+#include <vision/utils/threadpool.h>
+#include <astre/astre.h>
+#include <cbase/util.h>
+#include <pthread.h>
+
+#define P printf
+
+/*******************************************************************************
+
+        Engines
+
+*******************************************************************************/
+
+static const astre_engine* astre_engines[] = {
+  &astre_engine_noholes,
+  &astre_engine_holes,
+} ;
+
+const astre_engine*
+astre_engine_find( const char* name )
+{
+/*{{{*/
+  for( int i = 0 ; i < sizeof(astre_engines)/sizeof(astre_engines[0]) ; i++ )
+    if( strcmp( astre_engines[i]->name, name ) == 0 )
+      return astre_engines[i] ;
+  return (const astre_engine*)NULL ;
+/*}}}*/
+}
+
+/*******************************************************************************
+
+        Parameters
+
+*******************************************************************************/
+
+astre_options
+astre_options_default()
+{
+/*{{{*/
+  astre_options o ;
+  memset( &o, 0, sizeof(astre_options) );
+  o.e = 0 ;
+  o.h = -1 ;
+  o.l = 0 ;
+  o.latency = -1 ;
+  o.threads = 1 ;
+  o.incremental = 1 ;
+  o.spatial_index = TRUE ;
+  o.max_displacement = 0 ;
+  o.simd = -1 ;
+  o.partial_fname = (char*)NULL ;
+  return o ;
+/*}}}*/
+}
+
+int
+astre_options_resolve( const astre_engine* e, astre_options* o, int n_frames )
+{
+/*{{{*/
+  if( n_frames < 3 )
+  {
+    C_log_error("Not enough frames available for a trajectory search!\n");
+    return -1 ;
+  }
+
+  if( o->sliding_window && o->l == 0 )
+  {
+    C_log_error( "The sliding window requires a maximal trajectory length!\n" );
+    return -1 ;
+  }
+  if( o->l == 0 || o->l > n_frames )
+    o->l = n_frames ;
+
+  /* The G values of a trajectory leave the window 2L frames after its end */
+  if( o->latency < 0 || o->latency > 2*o->l-1 )
+    o->latency = 2*o->l-1 ;
+
+  if( !e->has_holes )
+    o->h = 0 ;
+  else if( o->h < 0 )
+    o->h = n_frames-3 ;
+
+  if( o->threads <= 0 )
+    o->threads = thread_pool_n_cpus() ;
+
+  /* The frames that left the window cannot be computed again */
+  if( o->sliding_window && o->incremental < 1 )
+    o->incremental = 1 ;
+
+  /* The points z are then those linked to y, there is no ring search */
+  if( o->max_displacement > 0 )
+    o->spatial_index = FALSE ;
+
+  return 0 ;
+/*}}}*/
+}
+
+/*******************************************************************************
+
+        Combinatorial coefficients of the log(NFA), shared by the contexts.
+
+        log(k) and log(k!) for k <= K, and the band of log( comb(n,k) ) for
+        n <= max_length, a dense (K+1)*(K+1) table would not fit in memory
+        for long sequences.
+
+*******************************************************************************/
+
+astre_tables
+astre_tables_new( int K, int max_length )
+{
+/*{{{*/
+  astre_tables t = (astre_tables)calloc_or_die( 1, sizeof(struct st_astre_tables) );
+  t->K = K ;
+  t->max_length = max_length ;
+  t->log_k = combinatorics_log_K_init( K );
+  t->log_cnk = combinatorics_log_Cnk_band_init( max_length );
+  t->log_kfact = combinatorics_log_Kfact_init( K );
+  return t ;
+/*}}}*/
+}
+
+void
+astre_tables_free_all( astre_tables* pt )
+{
+/*{{{*/
+  astre_tables t = *pt ;
+  if( !t ) return ;
+  free( t->log_k );
+  free( t->log_cnk );
+  free( t->log_kfact );
+  free( t );
+  *pt = (astre_tables)NULL ;
+/*}}}*/
+}
+
+/*******************************************************************************
+
+        Output
+
+*******************************************************************************/
+
+void
+astre_points_desc_save_with_trajs( Rawdata raw_out, points_desc pd, trajs_file tf )
+{
+/*{{{*/
+  points_desc pn = points_desc_copy( pd, 1 );
+
+  int n_field = pn->n_fields-1 ;
+  pn->tags[n_field] = C_string_dup("t");
+
+  /* Tag trajectories */
+  points_desc_set_traj_tags( pn, tf, n_field );
+
+  char **captions = (char**)realloc_or_die(pn->header_captions, (pn->n_headers+tf->num_of_trajs)*sizeof(char*));
+  pn->header_captions = captions;
+  char **contents =  (char**)realloc_or_die(pn->header_contents, (pn->n_headers+tf->num_of_trajs)*sizeof(char*));
+  pn->header_contents = contents;
+
+  for( int i = 0 ; i < tf->num_of_trajs ; i++ )
+  {
+      char buf[256]; sprintf(buf, "traj:%d:lNFA", i);
+      pn->header_captions[pn->n_headers + i] = C_string_dup(buf);
+      pn->header_contents[pn->n_headers + i] = C_string_dup(tf->trajs[i].data);
+  }
+  pn->n_headers += tf->num_of_trajs;
+
+  /* Save points_desc */
+  points_desc_save( raw_out, pn );
+
+  /* Free memory */
+  points_desc_free_all( &pn );
+/*}}}*/
+}
+
+void
+astre_stream_write_traj( FILE* out, points_desc pd, const traj* tt, int t )
+{
+/*{{{*/
+  fprintf( out, "# traj:%d:lNFA = %s\n", t, (char*)tt->data );
+  for( int p = 0 ; p < tt->length ; p++ )
+    if( tt->type[p] == PRTYPE_REF )
+      points_desc_write_point( out, pd, tt->starting_frame+p, tt->points[p].r, "t", t );
+/*}}}*/
+}
+
+/*******************************************************************************
+
+        Contexts.
+
+        A context holds the resolved parameters of a detection, the areas of
+        its images, and the state of its engine: the contexts are
+        independent, and may run at the same time in different threads.
+
+*******************************************************************************/
+
+/* Areas of the images, cropped to the bounding-box of their points with
+ * auto-crop */
+static void
+astre_ctx_init_image_areas( astre_ctx ctx )
+{
+/*{{{*/
+  points_desc pd = ctx->pd ;
+  const int K = pd->n_frames ;
+  ctx->image_area = (double*)calloc_or_die( K, sizeof(double) );
+  ctx->log_image_area = (double*)calloc_or_die( K, sizeof(double) );
+  for( int k = 0 ; k < K ; k++ )
+  {
+    double area = pd->height*pd->width ;
+    if( ctx->o.auto_crop )
+    {
+      double xmin=-1.0, ymin=-1.0, xmax=-1.0, ymax=-1.0 ;
+      char is_init = FALSE ;
+      for( int p = 0 ; p < pd->n_points_in_frame[k] ; p++ )
+      {
+        double pX = pd->points[k][p*pd->n_fields+0] ;
+        double pY = pd->points[k][p*pd->n_fields+1] ;
+        if( !is_init )
+        {
+          is_init = TRUE ;
+          xmin = xmax = pX ;
+          ymin = ymax = pY ;
+        }
+        else
+        {
+          xmin = min_d(xmin, pX);
+          xmax = max_d(xmax, pX);
+          ymin = min_d(ymin, pY);
+          ymax = max_d(ymax, pY);
+        }
+      }
+      area = max_d( 1.0, (xmax-xmin)*(ymax-ymin) );
+    }
+    ctx->image_area[k] = area ;
+    ctx->log_image_area[k] = log10(area) ;
+  }
+/*}}}*/
+}
+
+astre_ctx
+astre_ctx_new( const astre_engine* e, points_desc pd, const astre_options* o,
+               astre_tables t )
+{
+/*{{{*/
+  astre_ctx ctx = (astre_ctx)calloc_or_die( 1, sizeof(struct st_astre_ctx) );
+  ctx->engine = e ;
+  ctx->pd = pd ;
+  ctx->o = *o ;
+  if( astre_options_resolve( e, &(ctx->o), pd->n_frames ) != 0 )
+  {
+    free( ctx );
+    return (astre_ctx)NULL ;
+  }
+
+  if( t )
+  {
+    if( t->K < pd->n_frames || t->max_length < ctx->o.l )
+    {
+      C_log_error( "The shared tables are too small for this sequence!\n" );
+      free( ctx );
+      return (astre_ctx)NULL ;
+    }
+    ctx->tables = t ;
+    ctx->owns_tables = FALSE ;
+  }
+  else
+  {
+    ctx->tables = astre_tables_new( pd->n_frames, ctx->o.l );
+    ctx->owns_tables = TRUE ;
+  }
+
+  astre_ctx_init_image_areas( ctx );
+  ctx->tf = trajs_file_new();
+  ctx->state = e->state_new();
+  return ctx ;
+/*}}}*/
+}
+
+astre_ctx
+astre_ctx_new_stream( const astre_engine* e, points_desc_stream stream,
+                      const astre_options* o, astre_tables t )
+{
+/*{{{*/
+  /* The points of the frames are not known yet */
+  astre_options so = *o ;
+  so.streaming = TRUE ;
+  so.sliding_window = TRUE ;
+  so.auto_crop = FALSE ;
+  return astre_ctx_new( e, stream->pd, &so, t );
+/*}}}*/
+}
+
+/* Free the trajectories of tf and their log(NFA) */
+static void
+astre_trajs_free_all( trajs_file* ptf )
+{
+/*{{{*/
+  trajs_file tf = *ptf ;
+  for( int i = 0 ; i < tf->num_of_trajs ; i++ )
+  {
+      free( tf->trajs[i].data );
+  }
+  trajs_file_free_all( ptf );
+/*}}}*/
+}
+
+void
+astre_ctx_free_all( astre_ctx* pctx )
+{
+/*{{{*/
+  astre_ctx ctx = *pctx ;
+  if( !ctx ) return ;
+  ctx->engine->state_free( ctx->state );
+  astre_trajs_free_all( &(ctx->tf) );
+  if( ctx->owns_tables ) astre_tables_free_all( &(ctx->tables) );
+  free( ctx->image_area );
+  free( ctx->log_image_area );
+  free( ctx );
+  *pctx = (astre_ctx)NULL ;
+/*}}}*/
+}
+
+/* Check that the trajectories tagged in the last field of tagged, whose
+ * points are those of ctx->pd, can be restarted from or tagged by the engine:
+ * their tags are integers, they have one point per frame, two points at
+ * least, and no holes without the holes engine */
+static int
+astre_check_trajs( astre_ctx ctx, points_desc tagged, const char* name )
+{
+/*{{{*/
+  points_desc pd = ctx->pd ;
+  if( tagged->n_frames != pd->n_frames )
+  {
+    C_log_error( "%s does not have the frames of the Pointsdesc file!\n", name );
+    return -1 ;
+  }
+  for( int k = 0 ; k < pd->n_frames ; k++ )
+    if( tagged->n_points_in_frame[k] != pd->n_points_in_frame[k] )
+    {
+      C_log_error( "%s does not have the points of the Pointsdesc file!\n", name );
+      return -1 ;
+    }
+
+  /* Tags, as in points_desc_extract_trajs */
+  const int n_field = tagged->n_fields-1 ;
+  int max_traj = -1 ;
+  for( int k = 0 ; k < tagged->n_frames ; k++ )
+    for( int p = 0 ; p < tagged->n_points_in_frame[k] ; p++ )
+    {
+      double dt = tagged->points[k][p*tagged->n_fields + n_field] ;
+      if( dt - (int)dt >= 1E-10 )
+      {
+        C_log_error( "%s: point %d in frame %d has a non-integer trajectory tag (%g)!\n",
+            name, p, k, dt );
+        return -1 ;
+      }
+      max_traj = max_i( max_traj, (int)dt );
+    }
+
+  /* Number of frames of each trajectory having a point, and their range */
+  int* first = (int*)malloc_or_die( (max_traj+1)*sizeof(int) );
+  int* last = (int*)malloc_or_die( (max_traj+1)*sizeof(int) );
+  int* n_frames = (int*)calloc_or_die( max_traj+1, sizeof(int) );
+  int err = 0 ;
+  for( int k = 0 ; k < tagged->n_frames && !err ; k++ )
+    for( int p = 0 ; p < tagged->n_points_in_frame[k] && !err ; p++ )
+    {
+      int it = (int)tagged->points[k][p*tagged->n_fields + n_field] ;
+      if( it < 0 ) continue ;
+      if( n_frames[it] == 0 ) first[it] = k ;
+      else if( last[it] == k )
+      {
+        C_log_error( "%s: several points of frame %d have the trajectory tag %d!\n",
+            name, k, it );
+        err = -1 ;
+      }
+      last[it] = k ;
+      n_frames[it]++ ;
+    }
+
+  for( int it = 0 ; it <= max_traj && !err ; it++ )
+  {
+    if( n_frames[it] == 1 )
+    {
+      C_log_error( "%s: trajectory %d has a single point!\n", name, it );
+      err = -1 ;
+    }
+    else if( n_frames[it] > 0 && !ctx->engine->has_holes
+          && n_frames[it] != last[it]-first[it]+1 )
+    {
+      C_log_error( "%s: trajectory %d has holes, which the %s engine cannot detect!\n",
+          name, it, ctx->engine->name );
+      err = -1 ;
+    }
+  }
+
+  free( first );
+  free( last );
+  free( n_frames );
+  return err ;
+/*}}}*/
+}
+
+int
+astre_run( astre_ctx ctx, points_desc restart )
+{
+/*{{{*/
+  if( restart && restart->uid != ctx->pd->uid )
+  {
+    C_log_error( "Restart file UID does not match Pointsdesc file UID!\n" );
+    return -1 ;
+  }
+  if( restart && restart->n_fields < 3 )
+  {
+    C_log_error( "Restart file has no trajectory field!\n" );
+    return -1 ;
+  }
+  if( ctx->o.just_tag_trajectories && ctx->pd->n_fields < 3 )
+  {
+    C_log_error( "Restart file has no trajectory field!\n" );
+    return -1 ;
+  }
+  if( restart && astre_check_trajs( ctx, restart, "Restart file" ) != 0 )
+    return -1 ;
+  if( ctx->o.just_tag_trajectories
+   && astre_check_trajs( ctx, ctx->pd, "Pointsdesc file" ) != 0 )
+    return -1 ;
+
+  /* The trajectories of a former run are replaced */
+  if( ctx->tf->num_of_trajs > 0 )
+  {
+    astre_trajs_free_all( &(ctx->tf) );
+    ctx->tf = trajs_file_new();
+  }
+
+  return ctx->engine->detect( ctx, restart );
+/*}}}*/
+}
+
+int
+astre_run_stream( astre_ctx ctx, points_desc_stream stream, FILE* out )
+{
+/*{{{*/
+  if( stream->pd != ctx->pd || !ctx->o.streaming )
+  {
+    C_log_error( "The context was not created for this stream!\n" );
+    return -1 ;
+  }
+  if( ctx->engine->detect_stream( ctx, stream, out ) != 0 ) return -1 ;
+  return stream->error ? -1 : 0 ;
+/*}}}*/
+}
+
+trajs_file
+astre_extract( astre_ctx ctx )
+{
+/*{{{*/
+  trajs_file tf = ctx->tf ;
+  ctx->tf = trajs_file_new();
+  return tf ;
+/*}}}*/
+}
+
+/*******************************************************************************
+
+        Detection
+
+*******************************************************************************/
+
+/* Detect the trajectories of pd, see astre */
+static int
+astre_detect_points_desc( const astre_engine* e, points_desc pd, Rawdata o_pd,
+                          Rawdata r_pd, astre_options o )
+{
+/*{{{*/
+  astre_ctx ctx = astre_ctx_new( e, pd, &o, (astre_tables)NULL );
+  if( !ctx ) return -1 ;
+
+  points_desc restart = (points_desc)NULL ;
+  if( r_pd )
+    restart = points_desc_load( r_pd );
+
+  int err = r_pd && !restart ? -1 : astre_run( ctx, restart );
+
+  if( restart ) points_desc_free_all( &restart );
+
+  /*                                  Save the trajectories */
+  /* ------------------------------------------------------ */
+  if( !err )
+    astre_points_desc_save_with_trajs( o_pd, pd, ctx->tf );
+
+  /*                                            Free memory */
+  /* ------------------------------------------------------ */
+  astre_ctx_free_all( &ctx );
+  return err ;
+/*}}}*/
+}
+
+int
+astre( const astre_engine* e, Rawdata i_pd, Rawdata o_pd, Rawdata r_pd,
+       astre_options o )
+{
+/*{{{*/
+  points_desc pd = points_desc_load( i_pd ) ;
+  if( !pd ) return -1 ;
+  int err = astre_detect_points_desc( e, pd, o_pd, r_pd, o );
+  points_desc_free_all( &pd );
+  return err ;
+/*}}}*/
+}
+
+int
+astre_file( const astre_engine* e, char* i_fname, Rawdata o_pd, Rawdata r_pd,
+            astre_options o )
+{
+/*{{{*/
+  points_desc pd = points_desc_load_file( i_fname ) ;
+  if( !pd ) return -1 ;
+  int err = astre_detect_points_desc( e, pd, o_pd, r_pd, o );
+  points_desc_free_all( &pd );
+  return err ;
+/*}}}*/
+}
+
+int
+astre_stream( const astre_engine* e, FILE* in, FILE* out, int n_frames,
+              astre_options o )
+{
+/*{{{*/
+  points_desc_stream stream = points_desc_stream_open( in, n_frames );
+  if( !stream ) return -1 ;
+  astre_ctx ctx = astre_ctx_new_stream( e, stream, &o, (astre_tables)NULL );
+
+  int err = ctx ? astre_run_stream( ctx, stream, out ) : -1 ;
+
+  astre_ctx_free_all( &ctx );
+  points_desc_stream_free_all( &stream );
+  return err ;
+/*}}}*/
+}
+
+/*******************************************************************************
+
+        Batch detection.
+
+        The sequences are the jobs of a thread pool, each one being detected
+        in its own context and saved as soon as it is done, so that many
+        small sequences keep all the processors busy. The tables are cached
+        by (number of frames, maximal trajectory length), and shared by the
+        contexts of the sequences having the same values.
+
+*******************************************************************************/
+
+typedef struct
+{
+  const astre_engine* e ;
+  char** inputs ;
+  char** outputs ;
+  int n ;
+  astre_options o ;
+
+  pthread_mutex_t lock ;        /* protects the fields below */
+  astre_tables* tables ;        /* cached tables */
+  int n_tables ;
+  int n_done ;
+  int n_failed ;
+} astre_batch_data ;
+
+/* Tables of the sequences of K frames, computed by the first of them */
+static astre_tables
+astre_batch_tables( astre_batch_data* b, int K )
+{
+/*{{{*/
+  /* Resolved as in astre_options_resolve */
+  int l = b->o.l == 0 || b->o.l > K ? K : b->o.l ;
+
+  pthread_mutex_lock( &(b->lock) );
+  astre_tables t = (astre_tables)NULL ;
+  for( int i = 0 ; i < b->n_tables && !t ; i++ )
+    if( b->tables[i]->K == K && b->tables[i]->max_length == l )
+      t = b->tables[i] ;
+  if( !t )
+  {
+    t = astre_tables_new( K, l );
+    b->tables = (astre_tables*)realloc_or_die( b->tables,
+        (b->n_tables+1)*sizeof(astre_tables) );
+    b->tables[b->n_tables++] = t ;
+  }
+  pthread_mutex_unlock( &(b->lock) );
+  return t ;
+/*}}}*/
+}
+
+static void
+astre_batch_job( void* data, int i, int thread )
+{
+/*{{{*/
+  astre_batch_data* b = (astre_batch_data*)data ;
+
+  /* A sequence that cannot be loaded or detected is counted, and the other
+   * ones go on */
+  int n_trajs = 0 ;
+  char failed = TRUE ;
+  points_desc pd = points_desc_load_file( b->inputs[i] );
+  if( pd && pd->n_frames >= 3 )
+  {
+    astre_ctx ctx = astre_ctx_new( b->e, pd, &(b->o), astre_batch_tables( b, pd->n_frames ) );
+    if( ctx && astre_run( ctx, (points_desc)NULL ) == 0 )
+    {
+      n_trajs = ctx->tf->num_of_trajs ;
+
+      Rawdata rd_out = new_rawdata_or_die();
+      astre_points_desc_save_with_trajs( rd_out, pd, ctx->tf );
+      failed = save_rawdata( rd_out, b->outputs[i] ) != 0 ;
+      mw_delete_rawdata( rd_out );
+    }
+    astre_ctx_free_all( &ctx );
+  }
+  else if( pd )
+    C_log_error( "%s: not enough frames available for a trajectory search!\n", b->inputs[i] );
+  points_desc_free_all( &pd );
+
+  pthread_mutex_lock( &(b->lock) );
+  b->n_done++ ;
+  if( failed )
+  {
+    b->n_failed++ ;
+    C_log_error( "[%d/%d] %s: failed!\n", b->n_done, b->n, b->inputs[i] );
+  }
+  else P( " > [%d/%d] %s: %d trajectories, saved to %s\n", b->n_done, b->n,
+          b->inputs[i], n_trajs, b->outputs[i] );
+  pthread_mutex_unlock( &(b->lock) );
+/*}}}*/
+}
+
+int
+astre_batch( const astre_engine* e, int n, char** inputs, char** outputs,
+             astre_options o, int n_jobs )
+{
+/*{{{*/
+  astre_batch_data b ;
+  memset( &b, 0, sizeof(astre_batch_data) );
+  b.e = e ;
+  b.inputs = inputs ;
+  b.outputs = outputs ;
+  b.n = n ;
+  b.o = o ;
+  pthread_mutex_init( &(b.lock), NULL );
+
+  if( n_jobs <= 0 )
+    n_jobs = thread_pool_n_cpus() ;
+  thread_pool tp = thread_pool_new( min_i( n_jobs, max_i( n, 1 ) ) );
+  if( !tp )
+  {
+    pthread_mutex_destroy( &(b.lock) );
+    return n ;
+  }
+  thread_pool_run( tp, n, &astre_batch_job, &b );
+  thread_pool_free_all( &tp );
+
+  for( int i = 0 ; i < b.n_tables ; i++ )
+    astre_tables_free_all( &(b.tables[i]) );
+  free( b.tables );
+  pthread_mutex_destroy( &(b.lock) );
+  return b.n_failed ;
+/*}}}*/
+}
@@ -0,0 +1,526 @@
+/*
+    ASTRE a-contrario single trajectory extraction
+    Copyright (C) 2011 Mael Primet (mael.primet AT gmail.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <vision/core.h>
+#include <vision/utils/argparser.h>
+#include <vision/trajs/pointsdesc.h>
+#include <astre/astre.h>
+#include <cbase/util.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#define P printf
+
+/*******************************************************************************
+
+        Main function
+
+*******************************************************************************/
+char *main__help_msg =
+    "ASTRE\n"
+"Detect trajectories in a noise point clouds sequence.\n" ;
+
+#define MAIN__DEFINE_ARGUMENTS \
+  // Define command-line arguments
+
+#define MAIN__VERIFY_ARGUMENTS \
+  // Verify the values of your command-line arguments
+  // Store them in the parameter struct
+
+#define MAIN__AFTER_PROCESSING \
+  // Save files if needed
+  // Clean-up memory
+
+/* The engine is given by --engine, or by the name of the program
+ * (astre-noholes or astre-holes, which are links to astre), otherwise the
+ * engine with holes is used when a maximal hole length is given */
+static const astre_engine*
+main__engine( const char* program, struct arg_str* p_engine, struct arg_int* p_h )
+{
+/*{{{*/
+  const astre_engine* engine = (const astre_engine*)NULL ;
+  if( p_engine->count > 0 )
+  {
+    engine = astre_engine_find( p_engine->sval[0] );
+    if( !engine )
+    {
+      C_log_error( "Unknown engine %s!\n", p_engine->sval[0] );
+      exit(-1);
+    }
+  }
+  else
+  {
+    const char* name = strrchr( program, '/' );
+    name = name ? name+1 : program ;
+    if( strcmp( name, "astre-noholes" ) == 0 )
+      engine = &astre_engine_noholes ;
+    else if( strcmp( name, "astre-holes" ) == 0 || p_h->count > 0 )
+      engine = &astre_engine_holes ;
+    else
+      engine = &astre_engine_noholes ;
+  }
+
+  if( !engine->has_holes && p_h->count > 0 )
+  {
+    C_log_error( "The %s engine has no maximal hole length!\n", engine->name );
+    exit(-1);
+  }
+  return engine ;
+/*}}}*/
+}
+
+/* Show the parameters of a detection, once they are resolved */
+static void
+main__show_options( const astre_engine* e, const astre_options* o )
+{
+/*{{{*/
+  P( " ------------------------------------------------\n");
+  P( "  ENGINE = %s\n", e->name );
+  P( "  MAXIMAL log(NFA) = %g\n", o->e );
+  P( "  MAXIMAL TRAJECTORY LENGTH = %d\n", o->l );
+  P( "  SLIDING WINDOW = %s\n", o->sliding_window ? "yes" : "no" );
+  if( o->sliding_window )
+    P( "  LATENCY = %d\n", o->latency );
+  P( "  STREAMING = %s\n", o->streaming ? "yes" : "no" );
+  if( e->has_holes )
+    P( "  MAXIMAL HOLE LENGTH = %d\n", o->h );
+  P( "  THREADS = %d\n", o->threads );
+  P( "  INCREMENTAL LEVEL = %d\n", o->incremental );
+  P( "  SPATIAL INDEX = %s\n", o->spatial_index ? "yes" : "no" );
+  if( o->max_displacement > 0 )
+    P( "  MAXIMAL DISPLACEMENT = %g\n", o->max_displacement );
+  else
+    P( "  MAXIMAL DISPLACEMENT = any\n" );
+  P( "  EXTRACT PAST CONFLICTS = %s\n", o->past_conflicts ? "yes" : "no" );
+  P( " ------------------------------------------------\n");
+/*}}}*/
+}
+
+/*******************************************************************************
+
+        Batch of sequences.
+
+        <in> is either a directory, whose files are all detected, or a
+        manifest, whose lines are "<input> [<output>]" (empty lines and
+        lines starting with # are skipped). The outputs are written to the
+        directory <out>, with the name of their input by default, relative
+        output paths being relative to <out>.
+
+*******************************************************************************/
+
+static int
+main__compare_strings( const void* a, const void* b )
+{
+  return strcmp( *(char* const*)a, *(char* const*)b );
+}
+
+/* Are a and b the same existing file? */
+static char
+main__same_file( const char* a, const char* b )
+{
+/*{{{*/
+  struct stat st_a, st_b ;
+  return stat( a, &st_a ) == 0 && stat( b, &st_b ) == 0
+      && st_a.st_dev == st_b.st_dev && st_a.st_ino == st_b.st_ino ;
+/*}}}*/
+}
+
+/* Path of the output of input, given by name (or NULL) in directory out_dir */
+static char*
+main__batch_output( const char* out_dir, const char* input, const char* name )
+{
+/*{{{*/
+  if( !name )
+  {
+    name = strrchr( input, '/' );
+    name = name ? name+1 : input ;
+  }
+  if( name[0] == '/' )
+    return C_string_dup( (char*)name );
+  char* path = (char*)malloc_or_die( strlen(out_dir)+strlen(name)+2 );
+  sprintf( path, "%s/%s", out_dir, name );
+  return path ;
+/*}}}*/
+}
+
+/* Sequences of the batch in (see above), returns their number */
+static int
+main__batch_sequences( const char* in, const char* out_dir, char*** p_inputs, char*** p_outputs )
+{
+/*{{{*/
+  int n = 0, allocated = 16 ;
+  char** inputs = (char**)malloc_or_die( allocated*sizeof(char*) );
+  char** outputs = (char**)malloc_or_die( allocated*sizeof(char*) );
+
+  struct stat st ;
+  if( stat( in, &st ) != 0 )
+  {
+    C_log_error( "Cannot open %s!\n", in );
+    exit(-1);
+  }
+
+  if( S_ISDIR( st.st_mode ) )
+  {
+    DIR* dir = opendir( in );
+    if( !dir ) { C_log_error( "Cannot open %s!\n", in ); exit(-1); }
+    struct dirent* entry ;
+    while( (entry = readdir( dir )) )
+    {
+      if( entry->d_name[0] == '.' ) continue ;
+      char* input = (char*)malloc_or_die( strlen(in)+strlen(entry->d_name)+2 );
+      sprintf( input, "%s/%s", in, entry->d_name );
+      if( stat( input, &st ) != 0 || !S_ISREG( st.st_mode ) ) { free( input ); continue ; }
+      if( n == allocated )
+      {
+        allocated *= 2 ;
+        inputs = (char**)realloc_or_die( inputs, allocated*sizeof(char*) );
+      }
+      inputs[n++] = input ;
+    }
+    closedir( dir );
+
+    /* Detect the files in a reproducible order */
+    qsort( inputs, n, sizeof(char*), &main__compare_strings );
+    outputs = (char**)realloc_or_die( outputs, max_i( n, 1 )*sizeof(char*) );
+    for( int i = 0 ; i < n ; i++ )
+      outputs[i] = main__batch_output( out_dir, inputs[i], (char*)NULL );
+  }
+  else
+  {
+    FILE* f = fopen( in, "r" );
+    if( !f ) { C_log_error( "Cannot open %s!\n", in ); exit(-1); }
+    char line[4096], input[4096], output[4096] ;
+    while( fgets( line, sizeof(line), f ) )
+    {
+      int n_fields = sscanf( line, "%4095s %4095s", input, output );
+      if( n_fields < 1 || input[0] == '#' ) continue ;
+      if( n == allocated )
+      {
+        allocated *= 2 ;
+        inputs = (char**)realloc_or_die( inputs, allocated*sizeof(char*) );
+        outputs = (char**)realloc_or_die( outputs, allocated*sizeof(char*) );
+      }
+      inputs[n] = C_string_dup( input );
+      outputs[n] = main__batch_output( out_dir, input, n_fields == 2 ? output : (char*)NULL );
+      n++ ;
+    }
+    fclose( f );
+  }
+
+  /* The inputs are read by the jobs while the outputs are written */
+  for( int i = 0 ; i < n ; i++ )
+    if( main__same_file( inputs[i], outputs[i] ) )
+    {
+      C_log_error( "The output of %s would overwrite it!\n", inputs[i] );
+      exit(-1);
+    }
+
+  *p_inputs = inputs ;
+  *p_outputs = outputs ;
+  return n ;
+/*}}}*/
+}
+
+/*******************************************************************************
+
+        Command-line parsing
+
+*******************************************************************************/
+int main( int ARGC, char** ARGV )
+{
+  arg_parser ap = arg_parser_new();
+
+  arg_parser_set_info( ap, main__help_msg );
+
+  struct arg_str *p_in = arg_str1( NULL, NULL, "in", "Input points file" );
+  arg_parser_add( ap, p_in );
+
+  struct arg_str *p_out = arg_str1( NULL, NULL, "out", "Output points file" );
+  arg_parser_add( ap, p_out );
+
+  struct arg_dbl *p_e = arg_dbl0( "e", "epsilon", "<e>",
+      "Maximal allowed log(NFA) (default: 0)" );
+  if( p_e ) p_e->dval[0] = 0.0 ;
+  arg_parser_add( ap, p_e );
+
+  astre_options o = astre_options_default();
+
+  struct arg_str *p_engine = arg_str0( NULL, "engine", "<name>",
+      "Detection engine, noholes or holes (default: astre-noholes and "
+      "astre-holes use their engine, astre uses holes if -h is given, else noholes)" );
+  arg_parser_add( ap, p_engine );
+
+  struct arg_int *p_h = arg_int0( "h", "max-hole-length", "<h>",
+      "Maximal allowed hole length, with holes (default: -1, any length)" );
+  if( p_h ) p_h->ival[0] = -1 ;
+  arg_parser_add( ap, p_h );
+
+  struct arg_int *p_L = arg_int0( "L", "max-length", "<L>",
+      "Maximal allowed trajectory length (default: 0, any length)" );
+  if( p_L ) p_L->ival[0] = 0 ;
+  arg_parser_add( ap, p_L );
+
+  struct arg_lit *p_w = arg_lit0( NULL, "sliding-window",
+      "Compute the frames one after the other, keeping only the last 3L frames "
+      "in memory, and extract the trajectories as soon as they are settled. The "
+      "trajectories may differ from those extracted without a window, at any latency" );
+  arg_parser_add( ap, p_w );
+
+  struct arg_int *p_lat = arg_int0( NULL, "latency", "<d>",
+      "With a sliding window, extract the trajectories at most <d> frames after "
+      "their last frame, in 0 .. 2L-1 (default: -1, 2L-1). Below L-1, a trajectory "
+      "may be extracted before all its competitors are known. At any latency, the "
+      "extracted trajectories may differ from those extracted without a window" );
+  if( p_lat ) p_lat->ival[0] = -1 ;
+  arg_parser_add( ap, p_lat );
+
+  struct arg_int *p_st = arg_int0( NULL, "stream", "<K>",
+      "Read the frames one after the other from <in> (a FIFO, or - for the "
+      "standard input) and write the trajectories to <out> as soon as they are "
+      "extracted, with a sliding window over a sequence of at most <K> frames "
+      "(requires -L). As with --sliding-window, the trajectories may differ from "
+      "those extracted from the whole sequence" );
+  arg_parser_add( ap, p_st );
+
+  struct arg_lit *p_b = arg_lit0( NULL, "batch",
+      "Detect a batch of sequences: <in> is a directory, or a manifest whose lines "
+      "are \"<input> [<output>]\", and the outputs are written to the directory <out>" );
+  arg_parser_add( ap, p_b );
+
+  struct arg_int *p_j = arg_int0( NULL, "jobs", "<n>",
+      "With --batch, number of sequences detected at the same time "
+      "(default: 0, one per processor)" );
+  if( p_j ) p_j->ival[0] = 0 ;
+  arg_parser_add( ap, p_j );
+
+  struct arg_int *p_t = arg_int0( NULL, "threads", "<n>",
+      "Number of threads used to compute the trajectories (default: 1, 0: one per processor)" );
+  if( p_t ) p_t->ival[0] = 1 ;
+  arg_parser_add( ap, p_t );
+
+  struct arg_lit *p_hp = arg_lit0( NULL, "huge-pages",
+      "Back the large arrays of the dynamic programming with huge pages" );
+  arg_parser_add( ap, p_hp );
+
+  struct arg_int *p_i = arg_int0( NULL, "incremental", "<level>",
+      "Incremental recomputations after an extraction "
+      "(0: none, 1: from the first modified frame, 2: only the modified cells, default: 1)" );
+  if( p_i ) p_i->ival[0] = 1 ;
+  arg_parser_add( ap, p_i );
+
+  struct arg_lit *p_ns = arg_lit0( NULL, "no-spatial-index",
+      "Scan all the points of the previous frames instead of searching them "
+      "around their predicted positions" );
+  arg_parser_add( ap, p_ns );
+
+  struct arg_dbl *p_d = arg_dbl0( NULL, "max-displacement", "<d>",
+      "Maximal displacement of a point between two consecutive frames, "
+      "only the pairs of close points are stored (default: 0, any)" );
+  if( p_d ) p_d->dval[0] = 0.0 ;
+  arg_parser_add( ap, p_d );
+
+  struct arg_int *p_simd = arg_int0( NULL, "simd", "<level>",
+      "Instruction set of the kernels "
+      "(0: scalar, 1: SSE4.1, 2: AVX2, 3: AVX-512, default: -1, the best available)" );
+  if( p_simd ) p_simd->ival[0] = -1 ;
+  arg_parser_add( ap, p_simd );
+
+  struct arg_lit *p_pc = arg_lit0( NULL, "extract-past-conflicts",
+      "Go on extracting the trajectories after two of them shared a point, "
+      "which needs fewer recomputations but is not exactly the greedy extraction" );
+  arg_parser_add( ap, p_pc );
+
+  struct arg_str *p_r = arg_str0( "r", "restart", "<r>",
+      "Restart trajectory detection from partial detections "
+      "(trajectories are assumed to be in the last column)" );
+  arg_parser_add( ap, p_r );
+
+  struct arg_str *p_s = arg_str0( "s", "save-partial", "<s>", "Save partial detections" );
+  arg_parser_add( ap, p_s );
+
+
+  struct arg_lit *p_N = arg_lit0( NULL, "tag-NFA",
+      "Tag the trajectories in file <in> with their NFA and quit" );
+  arg_parser_add( ap, p_N );
+
+  struct arg_lit *p_c = arg_lit0( NULL, "auto-crop", "Auto-crop images to their bounding-box" );
+  arg_parser_add( ap, p_c );
+
+  MAIN__DEFINE_ARGUMENTS ;
+
+  /* Handle arguments */
+  arg_parser_handle( ap, ARGC, ARGV );
+
+  /* Check arguments */
+  char* in = (char*)p_in->sval[0]; C_assert( in && strlen(in) > 0 );
+  char* out = (char*)p_out->sval[0]; C_assert( out && strlen(out) > 0 );
+  const astre_engine* engine = main__engine( ARGV[0], p_engine, p_h );
+  o.e = p_e->dval[0];
+  o.h = p_h->ival[0];
+  o.l = p_L->ival[0];
+  C_assert( o.l == 0 || o.l >= 3 );
+  o.sliding_window = p_w->count > 0 ;
+  o.latency = p_lat->ival[0];
+  C_assert( o.latency >= -1 );
+  o.threads = p_t->ival[0];
+  C_assert( o.threads >= 0 );
+  o.huge_pages = p_hp->count > 0 ;
+  o.incremental = p_i->ival[0];
+  C_assert( o.incremental >= 0 && o.incremental <= 2 );
+  o.spatial_index = p_ns->count == 0 ;
+  o.max_displacement = p_d->dval[0];
+  C_assert( o.max_displacement >= 0 );
+  o.simd = p_simd->ival[0];
+  C_assert( o.simd >= -1 && o.simd <= G_SIMD_AVX512 );
+  o.past_conflicts = p_pc->count > 0 ;
+
+  if( p_b->count > 0 )
+  {
+    C_assert( p_j->ival[0] >= 0 );
+    if( p_st->count > 0 || p_r->count > 0 || p_s->count > 0 )
+    {
+      C_log_error( "A batch cannot be streamed, restarted or saved!\n" );
+      exit(-1);
+    }
+    struct stat st ;
+    if( stat( out, &st ) != 0 || !S_ISDIR( st.st_mode ) )
+    {
+      C_log_error( "The outputs of a batch are written to a directory!\n" );
+      exit(-1);
+    }
+    if( main__same_file( in, out ) )
+    {
+      C_log_error( "The outputs of a batch cannot be written to its input directory!\n" );
+      exit(-1);
+    }
+    o.just_tag_trajectories = p_N->count > 0 ;
+    o.auto_crop = p_c->count > 0 ;
+    /* The sequences are detected at the same time: only their results are
+     * shown */
+    o.quiet = TRUE ;
+
+    MAIN__VERIFY_ARGUMENTS ;
+
+    char **inputs, **outputs ;
+    int n = main__batch_sequences( in, out, &inputs, &outputs );
+    int n_failed = astre_batch( engine, n, inputs, outputs, o, p_j->ival[0] );
+    if( n_failed > 0 )
+      C_log_error( "%d of the %d sequences could not be detected!\n", n_failed, n );
+
+    for( int i = 0 ; i < n ; i++ )
+    {
+      free( inputs[i] );
+      free( outputs[i] );
+    }
+    free( inputs );
+    free( outputs );
+    arg_parser_free_all( &ap );
+    return n_failed > 0 ;
+  }
+
+  if( p_st->count > 0 )
+  {
+    int n_frames = p_st->ival[0];
+    C_assert( n_frames >= 3 );
+    if( o.l == 0 )
+    {
+      C_log_error( "The stream requires a maximal trajectory length!\n" );
+      exit(-1);
+    }
+    if( p_r->count > 0 || p_s->count > 0 || p_N->count > 0 || p_c->count > 0 )
+    {
+      C_log_error( "The stream cannot be restarted, saved, tagged or cropped!\n" );
+      exit(-1);
+    }
+    /* The standard output receives the logs */
+    if( strcmp( out, "-" ) == 0 )
+    {
+      C_log_error( "The stream must be written to a file or a FIFO!\n" );
+      exit(-1);
+    }
+
+    FILE* f_in = strcmp( in, "-" ) == 0 ? stdin : fopen( in, "r" );
+    if( !f_in ) { C_log_error( "Cannot open %s!\n", in ); exit(-1); }
+    FILE* f_out = fopen( out, "w" );
+    if( !f_out ) { C_log_error( "Cannot open %s!\n", out ); exit(-1); }
+
+    MAIN__VERIFY_ARGUMENTS ;
+
+    points_desc_stream stream = points_desc_stream_open( f_in, n_frames );
+    if( !stream ) exit(-1);
+    astre_ctx ctx = astre_ctx_new_stream( engine, stream, &o, (astre_tables)NULL );
+    if( !ctx ) exit(-1);
+    main__show_options( engine, &(ctx->o) );
+
+    if( astre_run_stream( ctx, stream, f_out ) != 0 ) exit(-1);
+
+    astre_ctx_free_all( &ctx );
+    points_desc_stream_free_all( &stream );
+    if( f_in != stdin ) fclose( f_in );
+    fclose( f_out );
+    arg_parser_free_all( &ap );
+    return 0 ;
+  }
+
+  Rawdata rd_out = new_rawdata_or_die();
+
+  Rawdata rd_restart = (Rawdata)NULL ;
+  if( p_r->count > 0 )
+  {
+    rd_restart = load_rawdata( (char*)p_r->sval[0] );
+    if( !rd_restart ) exit(-1);
+  }
+
+  o.just_tag_trajectories = p_N->count > 0 ;
+  o.auto_crop = p_c->count > 0 ;
+
+  if( p_s->count > 0 )
+    o.partial_fname = (char*)p_s->sval[0] ;
+  C_assert( !o.partial_fname || strlen(o.partial_fname) > 0 );
+
+  MAIN__VERIFY_ARGUMENTS ;
+
+  points_desc pd = points_desc_load_file( in );
+  if( !pd ) exit(-1);
+  astre_ctx ctx = astre_ctx_new( engine, pd, &o, (astre_tables)NULL );
+  if( !ctx ) exit(-1);
+  main__show_options( engine, &(ctx->o) );
+
+  points_desc restart = (points_desc)NULL ;
+  if( rd_restart )
+  {
+    restart = points_desc_load( rd_restart );
+    if( !restart ) exit(-1);
+  }
+
+  if( astre_run( ctx, restart ) != 0 ) exit(-1);
+
+  astre_points_desc_save_with_trajs( rd_out, pd, ctx->tf );
+  save_rawdata( rd_out, out );
+
+  MAIN__AFTER_PROCESSING ;
+
+  astre_ctx_free_all( &ctx );
+  if( restart ) points_desc_free_all( &restart );
+  points_desc_free_all( &pd );
+  mw_delete_rawdata( rd_out );
+  if( rd_restart ) mw_delete_rawdata( rd_restart );
+
+  /* Clean memory */
+  arg_parser_free_all( &ap );
+}
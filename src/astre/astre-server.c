@@ -0,0 +1,683 @@
+/*
+    ASTRE a-contrario single trajectory extraction
+    Copyright (C) 2011 Mael Primet (mael.primet AT gmail.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <vision/core.h>
+#include <vision/trajs/pointsdesc.h>
+#include <vision/trajs/trajs.h>
+#include <vision/utils/threadpool.h>
+#include <astre/astre.h>
+#include <cbase/util.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+
+#define P printf
+
+/*******************************************************************************
+
+        Protocol.
+
+        A job is a request, a header of "<key> <value>" lines ended by an
+        empty line, followed by <size> bytes of PointsFile:
+
+          engine <noholes|holes>
+          epsilon <e>
+          max-hole-length <h>
+          max-length <L>
+          auto-crop <0|1>
+          size <size>
+
+        All the keys but size are optional, the default parameters being
+        those of the server. The response is either
+
+          OK <n> <size>
+          traj:<i>:lNFA = <lNFA>          (n lines, i = 0 .. n-1)
+          <size bytes of the tagged PointsFile, see astre()>
+
+        or a single line "ERROR <message>".
+
+*******************************************************************************/
+
+#define ASTRE_SERVER_MAX_LINE 256
+
+/* Write the n bytes of buf, without SIGPIPE if the peer is gone */
+static int
+astre_server_write_all( int fd, const void* buf, size_t n )
+{
+/*{{{*/
+  const char* p = (const char*)buf ;
+  while( n > 0 )
+  {
+    ssize_t w = send( fd, p, n, MSG_NOSIGNAL );
+    if( w < 0 && errno == EINTR ) continue ;
+    if( w <= 0 ) return -1 ;
+    p += w ; n -= w ;
+  }
+  return 0 ;
+/*}}}*/
+}
+
+/* Elapsed seconds since t0, negative if t0 is to come */
+static double
+astre_server_elapsed( const struct timespec* t0 )
+{
+  struct timespec t ;
+  clock_gettime( CLOCK_MONOTONIC, &t );
+  return (t.tv_sec-t0->tv_sec) + 1E-9*(t.tv_nsec-t0->tv_nsec) ;
+}
+
+/* Wait until fd can be read, returns -1 if the deadline (if not NULL) is
+ * passed before */
+static int
+astre_server_wait( int fd, const struct timespec* deadline )
+{
+/*{{{*/
+  if( !deadline ) return 0 ;
+  while( TRUE )
+  {
+    double left = -astre_server_elapsed( deadline );
+    if( left <= 0 ) return -1 ;
+    struct pollfd pfd = { fd, POLLIN, 0 } ;
+    int r = poll( &pfd, 1, (int)( 1E3*left )+1 );
+    if( r < 0 && errno == EINTR ) continue ;
+    return r > 0 ? 0 : -1 ;
+  }
+/*}}}*/
+}
+
+/* Read the n bytes of buf before the deadline, if it is not NULL */
+static int
+astre_server_read_all( int fd, void* buf, size_t n, const struct timespec* deadline )
+{
+/*{{{*/
+  char* p = (char*)buf ;
+  while( n > 0 )
+  {
+    if( astre_server_wait( fd, deadline ) != 0 ) return -1 ;
+    ssize_t r = recv( fd, p, n, 0 );
+    if( r < 0 && errno == EINTR ) continue ;
+    if( r <= 0 ) return -1 ;
+    p += r ; n -= r ;
+  }
+  return 0 ;
+/*}}}*/
+}
+
+/* Read a line of at most n-1 characters, without its end of line, before
+ * the deadline if it is not NULL */
+static int
+astre_server_read_line( int fd, char* line, int n, const struct timespec* deadline )
+{
+/*{{{*/
+  int l = 0 ;
+  while( TRUE )
+  {
+    char c ;
+    if( astre_server_read_all( fd, &c, 1, deadline ) != 0 ) return -1 ;
+    if( c == '\n' ) break ;
+    if( l == n-1 ) return -1 ;
+    line[l++] = c ;
+  }
+  line[l] = '\0' ;
+  return 0 ;
+/*}}}*/
+}
+
+static void
+astre_server_write_error( int fd, const char* msg )
+{
+  char line[ASTRE_SERVER_MAX_LINE] ;
+  snprintf( line, sizeof(line), "ERROR %s\n", msg );
+  astre_server_write_all( fd, line, strlen(line) );
+}
+
+/*******************************************************************************
+
+        Jobs.
+
+        The parameters and the points of a job are read by its worker, which
+        must receive them before the timeout and at most so->max_size bytes
+        of points, and the job is loaded and detected in child processes
+        forked by the worker: the children share the warm state of the
+        server, and the server survives the malformed points, the failures
+        of the engine and the jobs running for longer than their timeout,
+        whose child is killed.
+
+        The combinatorial tables of the log(NFA) are kept by the server (see
+        astre_server_tables), grown to the largest sequence served so far:
+        the children inherit them instead of computing them.
+
+*******************************************************************************/
+
+typedef struct
+{
+  const astre_engine* e ;
+  astre_options o ;
+  Rawdata rd ;                  /* points of the job */
+} astre_server_job ;
+
+typedef struct
+{
+  pthread_mutex_t lock ;        /* held from the growth of the tables to the fork */
+  astre_tables tables ;         /* tables of the largest sequence, or NULL */
+} astre_server_tables ;
+
+/* Read the request of fd before the deadline (if not NULL), returns an
+ * error message or NULL */
+static const char*
+astre_server_read_job( int fd, const astre_server_options* so, astre_server_job* job,
+                       const struct timespec* deadline )
+{
+/*{{{*/
+  job->e = so->e ;
+  job->o = so->o ;
+  job->rd = (Rawdata)NULL ;
+
+  long size = -1 ;
+  char line[ASTRE_SERVER_MAX_LINE], key[ASTRE_SERVER_MAX_LINE], value[ASTRE_SERVER_MAX_LINE] ;
+  while( TRUE )
+  {
+    if( astre_server_read_line( fd, line, sizeof(line), deadline ) != 0 )
+      return "incomplete request" ;
+    if( line[0] == '\0' ) break ;
+    if( sscanf( line, "%255s %255s", key, value ) != 2 )
+      return "malformed request" ;
+
+    if( strcmp( key, "engine" ) == 0 )
+    {
+      job->e = astre_engine_find( value );
+      if( !job->e ) return "unknown engine" ;
+    }
+    else if( strcmp( key, "epsilon" ) == 0 )
+      job->o.e = atof( value );
+    else if( strcmp( key, "max-hole-length" ) == 0 )
+      job->o.h = atoi( value );
+    else if( strcmp( key, "max-length" ) == 0 )
+      job->o.l = atoi( value );
+    else if( strcmp( key, "auto-crop" ) == 0 )
+      job->o.auto_crop = atoi( value ) != 0 ;
+    else if( strcmp( key, "size" ) == 0 )
+      size = atol( value );
+    else
+      return "unknown parameter" ;
+  }
+
+  if( size <= 0 || size > INT_MAX ) return "missing or invalid size" ;
+  if( so->max_size > 0 && size > so->max_size ) return "too large points" ;
+  if( job->o.l != 0 && job->o.l < 3 ) return "invalid max-length" ;
+
+  job->rd = mw_change_rawdata( (Rawdata)NULL, (int)size );
+  if( !job->rd ) return "not enough memory" ;
+  if( astre_server_read_all( fd, job->rd->data, size, deadline ) != 0 )
+    return "incomplete points" ;
+  return (const char*)NULL ;
+/*}}}*/
+}
+
+/* Load the points of the job to pd, and its parameters to o, in a child
+ * process: returns an error message or NULL */
+static const char*
+astre_server_load_job( const astre_server_job* job, points_desc* pd, astre_options* o )
+{
+/*{{{*/
+  *o = job->o ;
+  *pd = points_desc_load( job->rd );
+  if( !*pd ) return "malformed points" ;
+  if( (*pd)->n_frames < 3 ) return "not enough frames" ;
+  if( astre_options_resolve( job->e, o, (*pd)->n_frames ) != 0 ) return "invalid parameters" ;
+  return (const char*)NULL ;
+/*}}}*/
+}
+
+/* Detect the points of the job with the tables t, and write the response to
+ * fd, in the child process */
+static void
+astre_server_run_job( int fd, astre_server_job* job, astre_tables t )
+{
+/*{{{*/
+  points_desc pd ;
+  astre_options o ;
+  const char* error = astre_server_load_job( job, &pd, &o );
+  if( error )
+  {
+    astre_server_write_error( fd, error );
+    _exit( 0 );
+  }
+
+  astre_ctx ctx = astre_ctx_new( job->e, pd, &o, t );
+  if( !ctx || astre_run( ctx, (points_desc)NULL ) != 0 )
+  {
+    astre_server_write_error( fd, "invalid parameters" );
+    _exit( 0 );
+  }
+
+  Rawdata rd_out = new_rawdata_or_die();
+  astre_points_desc_save_with_trajs( rd_out, pd, ctx->tf );
+
+  char line[ASTRE_SERVER_MAX_LINE] ;
+  snprintf( line, sizeof(line), "OK %d %d\n", ctx->tf->num_of_trajs, rd_out->size );
+  int err = astre_server_write_all( fd, line, strlen(line) );
+  for( int i = 0 ; i < ctx->tf->num_of_trajs && !err ; i++ )
+  {
+    snprintf( line, sizeof(line), "traj:%d:lNFA = %s\n", i, (char*)ctx->tf->trajs[i].data );
+    err = astre_server_write_all( fd, line, strlen(line) );
+  }
+  if( !err ) err = astre_server_write_all( fd, rd_out->data, rd_out->size );
+  fflush( stdout );
+  _exit( err ? 2 : 0 );
+/*}}}*/
+}
+
+/* Size of the tables of the job, sent to the pipe p by the child process,
+ * which writes the error of the job to fd itself if it cannot be loaded */
+static void
+astre_server_size_job( int fd, astre_server_job* job, int p )
+{
+/*{{{*/
+  points_desc pd ;
+  astre_options o ;
+  const char* error = astre_server_load_job( job, &pd, &o );
+  if( error )
+  {
+    astre_server_write_error( fd, error );
+    _exit( 1 );
+  }
+  int size[2] = { pd->n_frames, o.l } ;
+  _exit( write( p, size, sizeof(size) ) == sizeof(size) ? 0 : 2 );
+/*}}}*/
+}
+
+/* Start a child process of a job, whose logs are shown if so->verbose */
+static pid_t
+astre_server_fork( const astre_server_options* so )
+{
+/*{{{*/
+  fflush( stdout );
+  pid_t pid = fork();
+  if( pid == 0 && !so->verbose )
+  {
+    int null_fd = open( "/dev/null", O_WRONLY );
+    if( null_fd >= 0 ) dup2( null_fd, STDOUT_FILENO );
+  }
+  return pid ;
+/*}}}*/
+}
+
+/* Wait for the child pid of a job started at t0, polling its state until the
+ * timeout of the job, every millisecond at first, then every 50 ms at most.
+ * The child is killed at the timeout. Returns TRUE on timeout, the exit
+ * status of the child being stored in status otherwise */
+static char
+astre_server_wait_child( pid_t pid, const astre_server_options* so,
+                         const struct timespec* t0, int* status )
+{
+/*{{{*/
+  if( so->timeout <= 0 )
+  {
+    while( waitpid( pid, status, 0 ) < 0 && errno == EINTR ) ;
+    return FALSE ;
+  }
+
+  double period = 1E-3 ;
+  while( waitpid( pid, status, WNOHANG ) == 0 )
+  {
+    double left = so->timeout - astre_server_elapsed( t0 );
+    if( left <= 0 )
+    {
+      kill( pid, SIGKILL );
+      waitpid( pid, status, 0 );
+      return TRUE ;
+    }
+    double d = min_d( period, left );
+    struct timespec ts = { (time_t)d, (long)( 1E9*(d-(time_t)d) ) } ;
+    nanosleep( &ts, NULL );
+    period = min_d( 2*period, 50E-3 );
+  }
+  return FALSE ;
+/*}}}*/
+}
+
+/* Tables of a sequence of K frames, whose trajectories have at most l
+ * points: the tables of the server are grown if they are too small. The lock
+ * of the tables is then held, until the job is forked. */
+static astre_tables
+astre_server_lock_tables( astre_server_tables* st, int K, int l )
+{
+/*{{{*/
+  pthread_mutex_lock( &(st->lock) );
+  astre_tables t = st->tables ;
+  if( !t || t->K < K || t->max_length < l )
+  {
+    /* The children of the former tables have their own copy */
+    st->tables = astre_tables_new( t ? max_i( t->K, K ) : K,
+                                   t ? max_i( t->max_length, l ) : l );
+    astre_tables_free_all( &t );
+  }
+  return st->tables ;
+/*}}}*/
+}
+
+static void
+astre_server_handle( int fd, const astre_server_options* so, astre_server_tables* st )
+{
+/*{{{*/
+  /* A client cannot hold a worker for longer than a job, neither by a slow
+   * request, nor by a slow reading of the response */
+  struct timespec deadline ;
+  if( so->timeout > 0 )
+  {
+    clock_gettime( CLOCK_MONOTONIC, &deadline );
+    double end = deadline.tv_sec + 1E-9*deadline.tv_nsec + so->timeout ;
+    deadline.tv_sec = (time_t)end ;
+    deadline.tv_nsec = (long)( 1E9*(end-deadline.tv_sec) );
+
+    struct timeval tv ;
+    tv.tv_sec = (time_t)so->timeout ;
+    tv.tv_usec = (suseconds_t)( 1E6*(so->timeout-tv.tv_sec) );
+    setsockopt( fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv) );
+  }
+
+  astre_server_job job ;
+  const char* error = astre_server_read_job( fd, so, &job,
+      so->timeout > 0 ? &deadline : (const struct timespec*)NULL );
+  if( error )
+  {
+    astre_server_write_error( fd, error );
+    if( job.rd ) mw_delete_rawdata( job.rd );
+    return ;
+  }
+
+  /* The points are untrusted, and are only loaded by the children: a first
+   * child sends the size of the tables of the job through a pipe, the
+   * tables are grown, then the job is detected by a second child */
+  struct timespec t0 ;
+  clock_gettime( CLOCK_MONOTONIC, &t0 );
+  int status = 0, size[2], p[2] ;
+  char timed_out = FALSE, sized = FALSE ;
+  pid_t pid = -1 ;
+  if( pipe( p ) == 0 )
+  {
+    pid = astre_server_fork( so );
+    if( pid == 0 )
+    {
+      close( p[0] );
+      astre_server_size_job( fd, &job, p[1] );
+    }
+    close( p[1] );
+    if( pid > 0 )
+    {
+      timed_out = astre_server_wait_child( pid, so, &t0, &status );
+      sized = !timed_out && WIFEXITED( status ) && WEXITSTATUS( status ) == 0
+              && read( p[0], size, sizeof(size) ) == sizeof(size) ;
+    }
+    close( p[0] );
+  }
+
+  if( sized )
+  {
+    astre_tables t = astre_server_lock_tables( st, size[0], size[1] );
+    pid = astre_server_fork( so );
+    if( pid == 0 ) astre_server_run_job( fd, &job, t );
+    pthread_mutex_unlock( &(st->lock) );
+    if( pid > 0 ) timed_out = astre_server_wait_child( pid, so, &t0, &status );
+  }
+  mw_delete_rawdata( job.rd );
+
+  /* The loading child writes its own errors (exit status 1), and is only
+   * stopped by the malformed points otherwise */
+  if( pid < 0 )
+    error = "cannot start the job" ;
+  else if( timed_out )
+    error = "timeout" ;
+  else if( !WIFEXITED( status ) || WEXITSTATUS( status ) == 255 )
+    error = sized ? "detection failed" : "malformed points" ;
+  else if( !sized && WEXITSTATUS( status ) != 1 )
+    error = "malformed points" ;
+  if( error ) astre_server_write_error( fd, error );
+  P( " > job done in %.3f s%s\n", astre_server_elapsed( &t0 ),
+     timed_out ? " (timeout)" : error || !sized ? " (failed)" : "" );
+/*}}}*/
+}
+
+/*******************************************************************************
+
+        Server.
+
+        The connections are accepted by the calling thread and queued, at
+        most so->max_queue of them waiting for a worker: the others are
+        refused at once. The so->workers workers take the oldest queued
+        connection.
+
+*******************************************************************************/
+
+typedef struct
+{
+  const astre_server_options* so ;
+  pthread_mutex_t lock ;
+  pthread_cond_t ready ;
+  int* queue ;                  /* queued connections, from head */
+  int head, n_queued ;
+  char shutdown ;
+  astre_server_tables tables ;
+} astre_server ;
+
+static void*
+astre_server_worker( void* arg )
+{
+/*{{{*/
+  astre_server* s = (astre_server*)arg ;
+  while( TRUE )
+  {
+    pthread_mutex_lock( &(s->lock) );
+    while( s->n_queued == 0 && !s->shutdown )
+      pthread_cond_wait( &(s->ready), &(s->lock) );
+    if( s->n_queued == 0 )
+    {
+      pthread_mutex_unlock( &(s->lock) );
+      break ;
+    }
+    int fd = s->queue[s->head] ;
+    s->head = (s->head+1) % s->so->max_queue ;
+    s->n_queued-- ;
+    pthread_mutex_unlock( &(s->lock) );
+
+    astre_server_handle( fd, s->so, &(s->tables) );
+    close( fd );
+  }
+  return NULL ;
+/*}}}*/
+}
+
+int
+astre_serve( const char* socket_path, const astre_server_options* so,
+             volatile sig_atomic_t* stop )
+{
+/*{{{*/
+  struct sockaddr_un addr ;
+  memset( &addr, 0, sizeof(addr) );
+  addr.sun_family = AF_UNIX ;
+  if( strlen( socket_path ) >= sizeof(addr.sun_path) )
+  {
+    C_log_error( "Socket path %s is too long!\n", socket_path );
+    return -1 ;
+  }
+  strcpy( addr.sun_path, socket_path );
+
+  int listen_fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+  unlink( socket_path );
+  if( listen_fd < 0
+      || bind( listen_fd, (struct sockaddr*)&addr, sizeof(addr) ) != 0
+      || listen( listen_fd, so->max_queue+so->workers ) != 0 )
+  {
+    C_log_error( "Cannot listen on %s!\n", socket_path );
+    return -1 ;
+  }
+
+  astre_server s ;
+  s.so = so ;
+  pthread_mutex_init( &(s.lock), NULL );
+  pthread_cond_init( &(s.ready), NULL );
+  s.queue = (int*)calloc_or_die( so->max_queue, sizeof(int) );
+  s.head = s.n_queued = 0 ;
+  s.shutdown = FALSE ;
+  pthread_mutex_init( &(s.tables.lock), NULL );
+  s.tables.tables = (astre_tables)NULL ;
+
+  /* If a worker cannot be created, the others are stopped at once */
+  pthread_t* workers = (pthread_t*)calloc_or_die( so->workers, sizeof(pthread_t) );
+  int n_workers = 0 ;
+  for( ; n_workers < so->workers ; n_workers++ )
+    if( pthread_create( &(workers[n_workers]), NULL, &astre_server_worker, &s ) != 0 )
+    {
+      C_log_error( "Could not create worker thread %d!\n", n_workers );
+      break ;
+    }
+  char failed = n_workers < so->workers ;
+
+  if( !failed )
+  {
+    P( " > serving on %s: %d workers, %d queued jobs at most", socket_path,
+       so->workers, so->max_queue );
+    if( so->timeout > 0 ) P( ", timeout %g s\n", so->timeout );
+    else                  P( ", no timeout\n" );
+    fflush( stdout );
+  }
+
+  while( !failed && (!stop || !*stop) )
+  {
+    struct pollfd pfd = { listen_fd, POLLIN, 0 } ;
+    if( poll( &pfd, 1, 200 ) <= 0 ) continue ;
+    int fd = accept( listen_fd, NULL, NULL );
+    if( fd < 0 ) continue ;
+
+    pthread_mutex_lock( &(s.lock) );
+    char queued = s.n_queued < so->max_queue ;
+    if( queued )
+    {
+      s.queue[(s.head+s.n_queued) % so->max_queue] = fd ;
+      s.n_queued++ ;
+      pthread_cond_signal( &(s.ready) );
+    }
+    pthread_mutex_unlock( &(s.lock) );
+
+    if( !queued )
+    {
+      astre_server_write_error( fd, "busy" );
+      close( fd );
+    }
+  }
+
+  /* The queued jobs are still detected */
+  pthread_mutex_lock( &(s.lock) );
+  s.shutdown = TRUE ;
+  pthread_cond_broadcast( &(s.ready) );
+  pthread_mutex_unlock( &(s.lock) );
+  for( int w = 0 ; w < n_workers ; w++ )
+    pthread_join( workers[w], NULL );
+
+  close( listen_fd );
+  unlink( socket_path );
+  free( workers );
+  free( s.queue );
+  astre_tables_free_all( &(s.tables.tables) );
+  pthread_mutex_destroy( &(s.tables.lock) );
+  pthread_cond_destroy( &(s.ready) );
+  pthread_mutex_destroy( &(s.lock) );
+  return failed ? -1 : 0 ;
+/*}}}*/
+}
+
+/*******************************************************************************
+
+        Client.
+
+*******************************************************************************/
+
+int
+astre_submit( const char* socket_path, const astre_engine* e, const astre_options* o,
+              int keys, Rawdata in, Rawdata out, FILE* lnfa_out )
+{
+/*{{{*/
+  struct sockaddr_un addr ;
+  memset( &addr, 0, sizeof(addr) );
+  addr.sun_family = AF_UNIX ;
+  strncpy( addr.sun_path, socket_path, sizeof(addr.sun_path)-1 );
+
+  int fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+  if( fd < 0 || connect( fd, (struct sockaddr*)&addr, sizeof(addr) ) != 0 )
+  {
+    C_log_error( "Cannot connect to %s!\n", socket_path );
+    if( fd >= 0 ) close( fd );
+    return -1 ;
+  }
+
+  char header[1024] ;
+  int n = 0 ;
+  if( e )
+    n += snprintf( header+n, sizeof(header)-n, "engine %s\n", e->name );
+  if( keys & ASTRE_SUBMIT_EPSILON )
+    n += snprintf( header+n, sizeof(header)-n, "epsilon %.17g\n", o->e );
+  if( keys & ASTRE_SUBMIT_MAX_HOLE_LENGTH )
+    n += snprintf( header+n, sizeof(header)-n, "max-hole-length %d\n", o->h );
+  if( keys & ASTRE_SUBMIT_MAX_LENGTH )
+    n += snprintf( header+n, sizeof(header)-n, "max-length %d\n", o->l );
+  if( keys & ASTRE_SUBMIT_AUTO_CROP )
+    n += snprintf( header+n, sizeof(header)-n, "auto-crop %d\n", o->auto_crop ? 1 : 0 );
+  n += snprintf( header+n, sizeof(header)-n, "size %d\n\n", in->size );
+
+  /* The server may refuse the job before reading it: its answer is read
+   * even if the job could not be sent */
+  int sent = !( astre_server_write_all( fd, header, n )
+             || astre_server_write_all( fd, in->data, in->size ) );
+
+  char line[ASTRE_SERVER_MAX_LINE] ;
+  int n_trajs = 0, size = 0 ;
+  int err = astre_server_read_line( fd, line, sizeof(line), (const struct timespec*)NULL );
+  if( err )
+    C_log_error( sent ? "No answer from %s!\n" : "Cannot send the job to %s!\n", socket_path );
+  else if( strncmp( line, "OK ", 3 ) != 0 )
+  {
+    C_log_error( "%s\n", line );
+    err = -1 ;
+  }
+  else if( !err && sscanf( line, "OK %d %d", &n_trajs, &size ) != 2 )
+    err = -1 ;
+
+  for( int i = 0 ; i < n_trajs && !err ; i++ )
+  {
+    err = astre_server_read_line( fd, line, sizeof(line), (const struct timespec*)NULL );
+    if( !err && lnfa_out ) fprintf( lnfa_out, "%s\n", line );
+  }
+  if( !err )
+  {
+    change_rawdata_or_die( out, size );
+    err = astre_server_read_all( fd, out->data, size, (const struct timespec*)NULL );
+  }
+
+  close( fd );
+  return err ? -1 : 0 ;
+/*}}}*/
+}
@@ -0,0 +1,122 @@
+/*
+    ASTRE a-contrario single trajectory extraction
+    Copyright (C) 2011 Mael Primet (mael.primet AT gmail.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <vision/core.h>
+#include <vision/utils/argparser.h>
+#include <astre/astre.h>
+#include <cbase/util.h>
+
+/*******************************************************************************
+
+        Main function
+
+*******************************************************************************/
+char *main__help_msg =
+    "ASTRE-SUBMIT\n"
+"Send a trajectory detection job to an astred server, and save the tagged points.\n" ;
+
+int main( int ARGC, char** ARGV )
+{
+  arg_parser ap = arg_parser_new();
+
+  arg_parser_set_info( ap, main__help_msg );
+
+  struct arg_str *p_socket = arg_str1( NULL, NULL, "socket", "Path of the Unix socket of the server" );
+  arg_parser_add( ap, p_socket );
+
+  struct arg_str *p_in = arg_str1( NULL, NULL, "in", "Input points file" );
+  arg_parser_add( ap, p_in );
+
+  struct arg_str *p_out = arg_str1( NULL, NULL, "out", "Output points file" );
+  arg_parser_add( ap, p_out );
+
+  struct arg_str *p_engine = arg_str0( NULL, "engine", "<name>",
+      "Detection engine, noholes or holes (default: the engine of the server)" );
+  arg_parser_add( ap, p_engine );
+
+  struct arg_dbl *p_e = arg_dbl0( "e", "epsilon", "<e>",
+      "Maximal allowed log(NFA) (default: the one of the server)" );
+  if( p_e ) p_e->dval[0] = 0.0 ;
+  arg_parser_add( ap, p_e );
+
+  struct arg_int *p_h = arg_int0( "h", "max-hole-length", "<h>",
+      "Maximal allowed hole length, with holes (default: the one of the server, -1: any length)" );
+  if( p_h ) p_h->ival[0] = -1 ;
+  arg_parser_add( ap, p_h );
+
+  struct arg_int *p_L = arg_int0( "L", "max-length", "<L>",
+      "Maximal allowed trajectory length (default: the one of the server, 0: any length)" );
+  if( p_L ) p_L->ival[0] = 0 ;
+  arg_parser_add( ap, p_L );
+
+  struct arg_lit *p_c = arg_lit0( NULL, "auto-crop",
+      "Auto-crop images to their bounding-box (default: the choice of the server)" );
+  arg_parser_add( ap, p_c );
+
+  /* Handle arguments */
+  arg_parser_handle( ap, ARGC, ARGV );
+
+  /* Check arguments */
+  char* socket_path = (char*)p_socket->sval[0]; C_assert( socket_path && strlen(socket_path) > 0 );
+  char* in = (char*)p_in->sval[0]; C_assert( in && strlen(in) > 0 );
+  char* out = (char*)p_out->sval[0]; C_assert( out && strlen(out) > 0 );
+
+  const astre_engine* engine = (const astre_engine*)NULL ;
+  if( p_engine->count > 0 )
+  {
+    engine = astre_engine_find( p_engine->sval[0] );
+    if( !engine )
+    {
+      C_log_error( "Unknown engine %s!\n", p_engine->sval[0] );
+      exit(-1);
+    }
+    if( !engine->has_holes && p_h->count > 0 )
+    {
+      C_log_error( "The %s engine has no maximal hole length!\n", engine->name );
+      exit(-1);
+    }
+  }
+
+  /* Only the options given are sent, the server using its own otherwise */
+  astre_options o = astre_options_default();
+  int keys = 0 ;
+  o.e = p_e->dval[0];
+  if( p_e->count > 0 ) keys |= ASTRE_SUBMIT_EPSILON ;
+  o.h = p_h->ival[0];
+  if( p_h->count > 0 ) keys |= ASTRE_SUBMIT_MAX_HOLE_LENGTH ;
+  o.l = p_L->ival[0];
+  C_assert( o.l == 0 || o.l >= 3 );
+  if( p_L->count > 0 ) keys |= ASTRE_SUBMIT_MAX_LENGTH ;
+  o.auto_crop = p_c->count > 0 ;
+  if( p_c->count > 0 ) keys |= ASTRE_SUBMIT_AUTO_CROP ;
+
+  Rawdata rd_in = load_rawdata( in );
+  if( !rd_in ) exit(-1);
+  Rawdata rd_out = new_rawdata_or_die();
+
+  int err = astre_submit( socket_path, engine, &o, keys, rd_in, rd_out, stdout );
+  if( !err )
+    save_rawdata( rd_out, out );
+
+  mw_delete_rawdata( rd_in );
+  mw_delete_rawdata( rd_out );
+
+  /* Clean memory */
+  arg_parser_free_all( &ap );
+  return err ? -1 : 0 ;
+}
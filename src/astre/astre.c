@@ -16,6 +16,9 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+/* This file is compiled once for each engine of the library, with
+ * ASTRE_HAS_NO_HOLES and with ASTRE_HAS_HOLES (see astre/astre.h) */
+
 #define ALL_CHECKS                              /* undef to remove asserts checkings */
 #undef ALL_CHECKS
 
@@ -49,12 +52,30 @@ criterion__define(
   int last_accel_X = (int)(v_accel_X + 0.5f);
   int last_accel_Y = (int)(v_accel_Y + 0.5f);
   float criterion = discrete_area( last_accel_X, last_accel_Y );
-  return criterion / IMAGE_AREA[q] ;
+  return criterion / S->IMAGE_AREA[q] ;
 }
 #define ASTRE_DEFINE_CRITERION \
   float criterion = criterion__define( \
       px_X, px_Y, py_X, py_Y, pz_X, pz_Y, q \
   );
+static inline uint32_t
+criterion__define_code(
+  float px_X, float px_Y,
+  float py_X, float py_Y,
+  float pz_X, float pz_Y,
+  int q
+)
+{
+  float v_accel_X = abs_f(px_X + pz_X - 2.0*py_X);
+  float v_accel_Y = abs_f(px_Y + pz_Y - 2.0*py_Y);
+  int last_accel_X = (int)(v_accel_X + 0.5f);
+  int last_accel_Y = (int)(v_accel_Y + 0.5f);
+  return criterion_code( last_accel_X, last_accel_Y, q );
+}
+#define ASTRE_DEFINE_CRITERION_CODE \
+  const G_KERNEL_CODE_T criterion = (G_KERNEL_CODE_T)criterion__define_code( \
+      px_X, px_Y, py_X, py_Y, pz_X, pz_Y, q \
+  );
 #endif
 #ifdef ASTRE_HAS_HOLES
 static inline float
@@ -71,13 +92,33 @@ criterion__define(
   int last_accel_X = (int)(v_accel_X + 0.5f);
   int last_accel_Y = (int)(v_accel_Y + 0.5f);
   float criterion = discrete_area( last_accel_X, last_accel_Y );
-  return criterion / IMAGE_AREA[q] ;
+  return criterion / S->IMAGE_AREA[q] ;
 }
 #define ASTRE_DEFINE_CRITERION \
   float criterion = criterion__define( \
       px_X, px_Y, py_X, py_Y, pz_X, pz_Y, \
       f_h1_p1, f_h2_p1, q \
   );
+static inline uint32_t
+criterion__define_code(
+  float px_X, float px_Y,
+  float py_X, float py_Y,
+  float pz_X, float pz_Y,
+  float f_h1_p1, float f_h2_p1,
+  int q
+)
+{
+  float v_accel_X = abs_f((px_X-py_X)/f_h1_p1 + (pz_X-py_X)/f_h2_p1) ;
+  float v_accel_Y = abs_f((px_Y-py_Y)/f_h1_p1 + (pz_Y-py_Y)/f_h2_p1) ;
+  int last_accel_X = (int)(v_accel_X + 0.5f);
+  int last_accel_Y = (int)(v_accel_Y + 0.5f);
+  return criterion_code( last_accel_X, last_accel_Y, q );
+}
+#define ASTRE_DEFINE_CRITERION_CODE \
+  const G_KERNEL_CODE_T criterion = (G_KERNEL_CODE_T)criterion__define_code( \
+      px_X, px_Y, py_X, py_Y, pz_X, pz_Y, \
+      f_h1_p1, f_h2_p1, q \
+  );
 #endif
 
 /*******************************************************************************
@@ -109,14 +150,14 @@ log_NFA_l( int kl, float a, int l )
 
   double dl = (double)l ;
 
-  double lnprod = LOG_Nprod[k0][l][l] ;
+  double lnprod = log_nprod( k0, l, l ) ;
 #ifdef ALL_CHECKS
   if( lnprod < 0 ) /* undefined log_nprod, might not happen */
     mini_mwerror( FATAL, 1, "[log_NFA] internal error\n" );
 #endif
 
   double l_NFA =
-    LOG_k[K] + LOG_k[K-l+1] + lnprod +
+    S->LOG_k[S->K] + S->LOG_k[S->K-l+1] + lnprod +
       (dl - 2.0)*log10((double)a) ;
 
   return l_NFA ;
@@ -149,28 +190,28 @@ log_NFA_ls( int kl, float a, int l, int s, int j )
     double h = (double)(l - s)/dp ;
     double dhh = ((h+1.0)*(h+1.0));
 
-    double lnprod = LOG_Nprod[k0][l][s] ;
+    double lnprod = log_nprod( k0, l, s ) ;
 #ifdef ALL_CHECKS
     if( lnprod < 0 ) /* undefined log_prod, might not happen */
       mini_mwerror( FATAL, 1, "[log_NFA] internal error\n" );
 #endif
 
     double l_NFA =
-      LOG_K + LOG_k[l] + LOG_k[K-l+1] + LOG_Cnk[l*(K+1)+s] +
+      S->LOG_K + S->LOG_k[l] + S->LOG_k[S->K-l+1] + LOG_CNK( l, s ) +
       lnprod + (ds - 2.0)*log10((double)a) + dp*log10(dhh) ;
 
     return l_NFA ;
   }
   else
   {
-    double lnprod = LOG_Nprod[k0][l][l] ;
+    double lnprod = log_nprod( k0, l, l ) ;
 #ifdef ALL_CHECKS
     if( lnprod < 0 ) /* undefined log_prod, might not happen */
       mini_mwerror( FATAL, 1, "[log_NFA] internal error\n" );
 #endif
 
     double l_NFA =
-      LOG_K + LOG_k[l] + LOG_k[K-l+1] + /* LOG_Cnk[l*(K+1)+s] = 1 since l = s (j = 1)*/
+      S->LOG_K + S->LOG_k[l] + S->LOG_k[S->K-l+1] + /* LOG_CNK( l, s ) = 0 since l = s (j = 1)*/
       lnprod + (ds - 2.0)*log10((double)a) ;
 
     return l_NFA ;
@@ -181,18 +222,18 @@ log_NFA_ls( int kl, float a, int l, int s, int j )
 
 /*******************************************************************************
 
-        Find the NFA of the most significant trajectory.
+        NFA of a candidate trajectory.
 
-        find_minimal_nfa
+        g_candidates_collect
 
 *******************************************************************************/
 #ifdef ASTRE_HAS_NO_HOLES
-#define FIND_MINIMAL_NFA__COMPUTE_NFA(k,x,y,l,delta) \
+#define CANDIDATE__COMPUTE_NFA(k,x,y,l,delta) \
   const double lNFA = log_NFA( k, delta, l )
 #endif
 
 #ifdef ASTRE_HAS_HOLES
-#define FIND_MINIMAL_NFA__COMPUTE_NFA(k,x,y,l,s,j,delta) \
+#define CANDIDATE__COMPUTE_NFA(k,x,y,l,s,j,delta) \
   const double lNFA = log_NFA( k, delta, l, s, j );
 #endif
 
@@ -203,59 +244,20 @@ log_NFA_ls( int kl, float a, int l, int s, int j )
 *******************************************************************************/
 
 #define ASTRE__INITIALIZATION astre__initialization();
-void astre__initialization()
+static void
+astre__initialization()
 {
   // ...
   // my_astre_variable1 = 10 ;
 }
 
 #define ASTRE__DEINITIALIZATION astre__deinitialization();
-void astre__deinitialization()
+static void
+astre__deinitialization()
 {
   // ...
 }
 
-#define ASTRE__SHOW_INFORMATIONS astre__show_informations();
-void astre__show_informations()
-{
-  info_on_traj(
-    "S0 P14 P15 P0 P13 P17 P12 P8 P2 P15 P13 P2 P5 P5 P7 P13 P13 P6 P2 P9 P1 ;"
-  );
-
-  info_on_traj(
-    "S5 P12 P8 P2 P15 P13 P2 P5 P5 P7 P13 P13 P6 P2 P9 P1 ;"
-  );
-}
-#undef ASTRE__SHOW_INFORMATIONS
-
-/*******************************************************************************
-
-        Main function
-
-*******************************************************************************/
-char *main__help_msg =
-#ifdef ASTRE_HAS_NO_HOLES
-    "ASTRE (no holes)\n"
-#else
-    "ASTRE (with holes)\n"
-#endif
-"Detect trajectories in a noise point clouds sequence.\n" ;
-
-typedef struct st_astre_parameters {
-  // int param1 ;
-} astre_parameters ;
-
-#define MAIN__DEFINE_ARGUMENTS \
-  // Define command-line arguments
-
-#define MAIN__VERIFY_ARGUMENTS \
-  // Verify the values of your command-line arguments
-  // Store them in the parameter struct
-
-#define MAIN__AFTER_PROCESSING \
-  // Save files if needed
-  // Clean-up memory
-
 /*******************************************************************************
 
         Generic ASTRE code
@@ -0,0 +1,144 @@
+/*
+    ASTRE a-contrario single trajectory extraction
+    Copyright (C) 2011 Mael Primet (mael.primet AT gmail.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <vision/core.h>
+#include <vision/utils/argparser.h>
+#include <vision/utils/threadpool.h>
+#include <astre/astre.h>
+#include <cbase/util.h>
+
+/*******************************************************************************
+
+        Main function
+
+*******************************************************************************/
+char *main__help_msg =
+    "ASTRED\n"
+"Serve trajectory detection jobs on a Unix socket (see astre-submit).\n" ;
+
+static volatile sig_atomic_t main__stop = 0 ;
+
+static void
+main__on_signal( int sig )
+{
+  main__stop = 1 ;
+}
+
+int main( int ARGC, char** ARGV )
+{
+  arg_parser ap = arg_parser_new();
+
+  arg_parser_set_info( ap, main__help_msg );
+
+  struct arg_str *p_socket = arg_str1( NULL, NULL, "socket", "Path of the Unix socket" );
+  arg_parser_add( ap, p_socket );
+
+  struct arg_str *p_engine = arg_str0( NULL, "engine", "<name>",
+      "Default detection engine of the jobs, noholes or holes (default: noholes)" );
+  arg_parser_add( ap, p_engine );
+
+  struct arg_dbl *p_e = arg_dbl0( "e", "epsilon", "<e>",
+      "Default maximal allowed log(NFA) of the jobs (default: 0)" );
+  if( p_e ) p_e->dval[0] = 0.0 ;
+  arg_parser_add( ap, p_e );
+
+  struct arg_int *p_h = arg_int0( "h", "max-hole-length", "<h>",
+      "Default maximal allowed hole length of the jobs, with holes (default: -1, any length)" );
+  if( p_h ) p_h->ival[0] = -1 ;
+  arg_parser_add( ap, p_h );
+
+  struct arg_int *p_L = arg_int0( "L", "max-length", "<L>",
+      "Default maximal allowed trajectory length of the jobs (default: 0, any length)" );
+  if( p_L ) p_L->ival[0] = 0 ;
+  arg_parser_add( ap, p_L );
+
+  struct arg_lit *p_c = arg_lit0( NULL, "auto-crop",
+      "Auto-crop the images of the jobs to their bounding-box by default" );
+  arg_parser_add( ap, p_c );
+
+  struct arg_int *p_w = arg_int0( NULL, "workers", "<n>",
+      "Number of jobs detected at the same time (default: 0, one per processor)" );
+  if( p_w ) p_w->ival[0] = 0 ;
+  arg_parser_add( ap, p_w );
+
+  struct arg_int *p_q = arg_int0( NULL, "max-queue", "<n>",
+      "Maximal number of jobs waiting for a worker, the other jobs are refused (default: 16)" );
+  if( p_q ) p_q->ival[0] = 16 ;
+  arg_parser_add( ap, p_q );
+
+  struct arg_int *p_s = arg_int0( NULL, "max-size", "<MB>",
+      "Maximal size of the points of a job in MB, the larger jobs are refused (default: 256)" );
+  if( p_s ) p_s->ival[0] = 256 ;
+  arg_parser_add( ap, p_s );
+
+  struct arg_dbl *p_to = arg_dbl0( NULL, "timeout", "<s>",
+      "Maximal duration of a job in seconds, the longer jobs are stopped (default: 0, none)" );
+  if( p_to ) p_to->dval[0] = 0.0 ;
+  arg_parser_add( ap, p_to );
+
+  struct arg_lit *p_v = arg_lit0( NULL, "verbose", "Show the logs of the detections" );
+  arg_parser_add( ap, p_v );
+
+  /* Handle arguments */
+  arg_parser_handle( ap, ARGC, ARGV );
+
+  /* Check arguments */
+  char* socket_path = (char*)p_socket->sval[0]; C_assert( socket_path && strlen(socket_path) > 0 );
+
+  astre_server_options so ;
+  memset( &so, 0, sizeof(astre_server_options) );
+  so.e = &astre_engine_noholes ;
+  if( p_engine->count > 0 )
+  {
+    so.e = astre_engine_find( p_engine->sval[0] );
+    if( !so.e )
+    {
+      C_log_error( "Unknown engine %s!\n", p_engine->sval[0] );
+      exit(-1);
+    }
+  }
+  so.o = astre_options_default();
+  so.o.e = p_e->dval[0];
+  so.o.h = p_h->ival[0];
+  so.o.l = p_L->ival[0];
+  C_assert( so.o.l == 0 || so.o.l >= 3 );
+  so.o.auto_crop = p_c->count > 0 ;
+  so.workers = p_w->ival[0] > 0 ? p_w->ival[0] : thread_pool_n_cpus() ;
+  so.max_queue = p_q->ival[0];
+  C_assert( so.max_queue >= 1 );
+  so.max_size = (long)p_s->ival[0] << 20 ;
+  C_assert( so.max_size >= 1 );
+  so.timeout = p_to->dval[0];
+  C_assert( so.timeout >= 0 );
+  so.verbose = p_v->count > 0 ;
+
+  /* The logs of the server are written as they happen */
+  setvbuf( stdout, (char*)NULL, _IOLBF, 0 );
+
+  struct sigaction sa ;
+  memset( &sa, 0, sizeof(sa) );
+  sa.sa_handler = &main__on_signal ;
+  sigaction( SIGINT, &sa, NULL );
+  sigaction( SIGTERM, &sa, NULL );
+
+  int err = astre_serve( socket_path, &so, &main__stop );
+
+  /* Clean memory */
+  arg_parser_free_all( &ap );
+  return err ? -1 : 0 ;
+}
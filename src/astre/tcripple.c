@@ -40,6 +40,7 @@ tcripple
 )
 {
   points_desc pd = points_desc_load ( i_pd ) ;
+  if( !pd ) exit(-1);
   points_desc pd_crippled = points_desc_new();
 
   if( i_r < 0 || i_r > 100 )
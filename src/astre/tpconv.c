@@ -0,0 +1,66 @@
+/*
+    ASTRE a-contrario single trajectory extraction
+    Copyright (C) 2011 Mael Primet (mael.primet AT gmail.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <vision/core.h>
+#include <vision/utils/argparser.h>
+#include <vision/trajs/pointsdesc.h>
+
+int main( int ARGC, char** ARGV )
+{
+  arg_parser ap = arg_parser_new();
+
+  arg_parser_set_info( ap,
+"Convert a points file between the text (PointsFile v.1.0) and the binary\n"
+"(PointsFile v.2) formats.\n\n"
+"The format of the input file is detected.\n" );
+
+  struct arg_str *p_in = arg_str1( NULL, NULL, "in",
+      "Input points file" );
+  arg_parser_add( ap, p_in );
+
+  struct arg_str *p_out = arg_str1( NULL, NULL, "out",
+      "Output points file" );
+  arg_parser_add( ap, p_out );
+
+  struct arg_lit *p_b = arg_lit0( "b", "binary", "Save a binary file (default: text file)" );
+  arg_parser_add( ap, p_b );
+
+  /* Handle arguments */
+  arg_parser_handle( ap, ARGC, ARGV );
+
+  /* Check arguments */
+  char* in = (char*)p_in->sval[0]; C_assert( in && strlen(in) > 0 );
+  char* out = (char*)p_out->sval[0]; C_assert( out && strlen(out) > 0 );
+
+  points_desc pd = points_desc_load_file( in );
+  if( !pd ) exit(-1);
+  Rawdata rd_out = new_rawdata_or_die();
+
+  if( p_b->count > 0 )
+    points_desc_save_binary( rd_out, pd );
+  else
+    points_desc_save( rd_out, pd );
+
+  save_rawdata( rd_out, out );
+
+  points_desc_free_all( &pd );
+  mw_delete_rawdata( rd_out );
+
+  /* Clean memory */
+  arg_parser_free_all( &ap );
+}
@@ -70,9 +70,11 @@ tstats
 {
   /* Load points and trajectories */
   r_pd = points_desc_load( rd1 );
+  if( !r_pd ) exit(-1);
   if( rd2 )
   {
     f_pd = points_desc_load( rd2 );
+    if( !f_pd ) exit(-1);
     if( r_pd->uid != f_pd->uid )
       mini_mwerror( FATAL, 1, "Pointsdesc file UID do not match!\n" );
   }
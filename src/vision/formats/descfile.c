@@ -100,165 +100,186 @@ desc_file_free_all( desc_file* pdf )
 /*}}}*/
 }
 
-/******************************************************************************
-
-        desc_file_load
-
-        Create a desc_file structure from [raw_in]
+static void
+desc_file_malformed()
+{
+  C_log_error("DescFile file malformed!\n");
+}
 
-******************************************************************************/
-desc_file
-desc_file_load( Rawdata raw_in )
+/* Split the header line "caption = content" in place, return -1 if it is
+ * malformed */
+static int
+desc_file_split_header( char* header, char** p_caption, char** p_content )
 {
 /*{{{*/
-  desc_file df = desc_file_new();
-
-  char has_seen_DATA = FALSE ;
-
-  parse_array pa = pa_new(0,NULL) ;
-  pa->size = raw_in->size ;
-  pa->data = raw_in->data ;
-  pa->ptr = pa->data ;
-
-  void malformed () { C_log_error("DescFile file malformed!\n"); exit(-1); }
-
-  int buf_size = 1024 ;
-  char* buf = (char*)calloc_or_die( buf_size, sizeof(char) );
+  /* is this a header? */
+  int n = str_index_of_char( header, '=' );
+  if( n <= 0 )
+  {
+    printf("Header \"%s\" is not \"caption=content\"\n",header);
+    desc_file_malformed();
+    return -1 ;
+  }
+  char* caption = header ;
+  char* content = header+n+1 ;
+  *(header+n) = '\0' ;
+  *p_caption = trim_whitespace(caption);
+  *p_content = trim_whitespace(content);
+  return 0 ;
+/*}}}*/
+}
 
-  int len = -1, n = -1 ;
+/* Parse the data line and append it to df->lines, of allocated size *p_dsize,
+ * return -1 if it is malformed */
+static int
+desc_file_add_data_line( desc_file df, char* line, int* p_dsize )
+{
+/*{{{*/
+  /* Count fields */
+  int n_fields = 0 ;
+  char* cur = line ;
+  while( *cur != '\0' )
+  {
+    while( *cur != '\0' && is_whitespace(*cur) ) cur++ ;
+    if( *cur == '\0' ) break ;
+    n_fields++ ;
+    while( *cur != '\0' && !is_whitespace(*cur) ) cur++ ;
+  }
 
-  c_vector_t* vec_captions = C_vector_start(100);
-  c_vector_t* vec_contents = C_vector_start(100);
+  if( n_fields == 0 )
+  {
+    printf(" Error, line \"%s\" has no fields!\n", line );
+    desc_file_malformed();
+    return -1 ;
+  }
 
-  inline void add_header( char* header )
+  if( df->n_fields == 0 )
+  {
+    df->n_fields = n_fields ;
+    df->tags = (char**)calloc_or_die( n_fields, sizeof(char*) );
+    for( int k = 0 ; k < n_fields ; k++ )
+      df->tags[k] = (char*)NULL ;
+  }
+  else
   {
-    /* is this a header? */
-    int n = str_index_of_char( header, '=' );
-    if( n <= 0 )
+    if( df->n_fields != n_fields )
     {
-      printf("Header \"%s\" is not \"caption=content\"\n",header);
-      malformed();
+      printf( "Error, line \"%s\" has %d fields instead of %d!\n",line, n_fields, df->n_fields );
+      desc_file_malformed();
+      return -1 ;
     }
-    else
-    {
-      char* caption = header ;
-      char* content = header+n+1 ;
-      *(header+n) = '\0' ;
-      caption = trim_whitespace(caption);
-      content = trim_whitespace(content);
+  }
 
-      C_vector_store(vec_captions, C_string_dup(caption));
-      C_vector_store(vec_contents, C_string_dup(content));
-    }
+  if( df->n_lines >= *p_dsize )
+  {
+    *p_dsize = max_i( 2*(*p_dsize)+1, df->n_lines+1 );
+    df->lines = (double**)realloc_or_die( df->lines, (*p_dsize)*sizeof(double*) );
   }
+  df->lines[df->n_lines] = (double*)calloc_or_die( n_fields, sizeof(double) );
 
-  int dsize = 0 ;
-  inline void add_data( char* line )
+  /* Extract fields */
+  cur = line ;
+  int curfield = 0 ;
+  while( *cur != '\0' )
   {
-    /* Count fields */
-    int n_fields = 0 ;
-    char* cur = line ;
-    while( *cur != '\0' )
+    while( *cur != '\0' && is_whitespace(*cur) ) cur++ ;
+    if( *cur == '\0' ) break ;
+
+    char* start = cur ;
+    while( *cur != '\0' && !is_whitespace(*cur) ) cur++ ;
+    char is_end_of_string = *cur == '\0' ;
+    *cur = '\0' ;
+
+    char* tag = (char*)NULL ;
+
+    int p = str_index_of_char( start, ':' );
+    if( p >= 0 )
     {
-      while( *cur != '\0' && is_whitespace(*cur) ) cur++ ;
-      if( *cur == '\0' ) break ;
-      n_fields++ ;
-      while( *cur != '\0' && !is_whitespace(*cur) ) cur++ ;
+      tag = start ;
+      *(start+p) = '\0' ;
+      start = start + p + 1 ;
     }
 
-    if( n_fields == 0 )
+    char* check_cur = start ;
+    while( *check_cur != '\0' && (
+        (*check_cur >= '0' && *check_cur <= '9') ||
+        *check_cur == 'e' || *check_cur == 'E' || *check_cur == '+' || *check_cur == '-'
+        || *check_cur == '.' ) ) check_cur++ ;
+    if( *check_cur != '\0' )
     {
-      printf(" Error, line \"%s\" has no fields!\n", line );
-      malformed();
+      printf("Malformed field value \"%s\"!\n", start );
+      goto malformed ;
     }
 
-    if( df->n_fields == 0 )
+    double f = -1.0 ; int q = sscanf( start, "%lf", &f );
+
+    if( q != 1 )
     {
-      df->n_fields = n_fields ;
-      df->tags = (char**)calloc_or_die( n_fields, sizeof(char*) );
-      for( int k = 0 ; k < n_fields ; k++ )
-        df->tags[k] = (char*)NULL ;
+      printf("Malformed field value \"%s\"!\n", start );
+      goto malformed ;
     }
-    else
+
+    df->lines[df->n_lines][curfield] = f ;
+    if( tag )
     {
-      if( df->n_fields != n_fields )
+      if( df->tags[curfield] == (char*)NULL )
+      {
+        df->tags[curfield] = strdup(tag);
+      }
+      else if( strcmp(df->tags[curfield], tag) != 0 )
       {
-        printf( "Error, line \"%s\" has %d fields instead of %d!\n",line, n_fields, df->n_fields );
-        malformed();
+        printf("Line \"%s\", field %d has tag %s instead of %s!\n", line, curfield, tag, df->tags[curfield] );
+        goto malformed ;
       }
     }
+    curfield++ ;
 
-    if( df->n_lines >= dsize )
-    {
-      dsize = max_i( 2*dsize+1, df->n_lines+1 );
-      df->lines = (double**)realloc_or_die( df->lines, dsize*sizeof(double*) );
-    }
-    df->lines[df->n_lines] = (double*)calloc_or_die( n_fields, sizeof(double) );
+    if( is_end_of_string ) break ;
+    else cur++ ;
+  }
+  df->n_lines++ ;
+  return 0 ;
 
-    /* Extract fields */
-    cur = line ;
-    int curfield = 0 ;
-    while( *cur != '\0' )
-    {
-      while( *cur != '\0' && is_whitespace(*cur) ) cur++ ;
-      if( *cur == '\0' ) break ;
+malformed:
+  desc_file_malformed();
+  free( df->lines[df->n_lines] ); df->lines[df->n_lines] = (double*)NULL ;
+  return -1 ;
+/*}}}*/
+}
 
-      char* start = cur ;
-      while( *cur != '\0' && !is_whitespace(*cur) ) cur++ ;
-      char is_end_of_string = *cur == '\0' ;
-      *cur = '\0' ;
+/******************************************************************************
 
-      char* tag = (char*)NULL ;
+        desc_file_load
 
-      int p = str_index_of_char( start, ':' );
-      if( p >= 0 )
-      {
-        tag = start ;
-        *(start+p) = '\0' ;
-        start = start + p + 1 ;
-      }
+        Create a desc_file structure from [raw_in], or return NULL if it is
+        malformed
 
-      char* check_cur = start ;
-      while( *check_cur != '\0' && (
-          (*check_cur >= '0' && *check_cur <= '9') ||
-          *check_cur == 'e' || *check_cur == 'E' || *check_cur == '+' || *check_cur == '-'
-          || *check_cur == '.' ) ) check_cur++ ;
-      if( *check_cur != '\0' )
-      {
-        printf("Malformed field value \"%s\"!\n", start );
-        malformed();
-      }
+******************************************************************************/
+desc_file
+desc_file_load( Rawdata raw_in )
+{
+/*{{{*/
+  desc_file df = desc_file_new();
 
-      double f = -1.0 ; int q = sscanf( start, "%lf", &f );
+  char has_seen_DATA = FALSE ;
 
-      if( q != 1 )
-      {
-        printf("Malformed field value \"%s\"!\n", start );
-        malformed();
-      }
+  parse_array pa = pa_new(0,NULL) ;
+  pa->size = raw_in->size ;
+  pa->data = raw_in->data ;
+  pa->ptr = pa->data ;
 
-      df->lines[df->n_lines][curfield] = f ;
-      if( tag )
-      {
-        if( df->tags[curfield] == (char*)NULL )
-        {
-          df->tags[curfield] = strdup(tag);
-        }
-        else if( strcmp(df->tags[curfield], tag) != 0 )
-        {
-          printf("Line \"%s\", field %d has tag %s instead of %s!\n", line, curfield, tag, df->tags[curfield] );
-          malformed();
-        }
-      }
-      curfield++ ;
+  int buf_size = 1024 ;
+  char* buf = (char*)calloc_or_die( buf_size, sizeof(char) );
 
-      if( is_end_of_string ) break ;
-      else cur++ ;
-    }
-    df->n_lines++ ;
-  }
+  int len = -1 ;
+
+  c_vector_t* vec_captions = C_vector_start(100);
+  c_vector_t* vec_contents = C_vector_start(100);
 
-  while( (len = pa_read_line_clean( pa, &buf, &buf_size )) >= 0 )
+  int dsize = 0 ;
+  int err = 0 ;
+
+  while( !err && (len = pa_read_line_clean( pa, &buf, &buf_size )) >= 0 )
   {
     char *str = trim_whitespace( buf );
     if( str[0] == '#' || str[0] == '\0' ) continue ; /* Comment or empty line */
@@ -267,23 +288,28 @@ desc_file_load( Rawdata raw_in )
       if( has_seen_DATA )
       {
         printf("File has many DATA sections!");
-        malformed();
+        desc_file_malformed();
+        err = -1 ;
       }
       else
       {
         /* Enter data section */
         has_seen_DATA = TRUE ;
-        continue ;
       }
+      continue ;
     }
 
     if( !has_seen_DATA )
     {
-      add_header( str );
+      char *caption, *content ;
+      err = desc_file_split_header( str, &caption, &content );
+      if( err ) continue ;
+      C_vector_store(vec_captions, C_string_dup(caption));
+      C_vector_store(vec_contents, C_string_dup(content));
     }
     else
     {
-      add_data( str );
+      err = desc_file_add_data_line( df, str, &dsize );
     }
   }
 
@@ -293,10 +319,153 @@ desc_file_load( Rawdata raw_in )
   free( buf );
   pa_free_structure(pa) ;
 
+  if( err ) desc_file_free_all( &df );
   return df ;
 /*}}}*/
 }
 
+/******************************************************************************
+
+        desc_file_stream_open
+
+        Read the headers of a desc_file from [in], up to the DATA line, or
+        return NULL if they are malformed
+
+******************************************************************************/
+desc_file_stream
+desc_file_stream_open( FILE* in )
+{
+/*{{{*/
+  desc_file_stream s = (desc_file_stream)malloc_or_die( sizeof(struct st_desc_file_stream) );
+  s->in = in ;
+  s->df = desc_file_new();
+  s->buf_size = 1024 ;
+  s->buf = (char*)calloc_or_die( s->buf_size, sizeof(char) );
+  s->dsize = 0 ;
+  s->error = FALSE ;
+
+  char* str ;
+  while( (str = desc_file_stream_read_raw_line( s )) != NULL )
+  {
+    if( strcmp(str,"DATA") == 0 ) return s ;
+
+    char *caption, *content ;
+    if( desc_file_split_header( str, &caption, &content ) != 0 )
+    {
+      desc_file_stream_free_all( &s );
+      return (desc_file_stream)NULL ;
+    }
+    desc_file_add_header( s->df, C_string_dup(caption), C_string_dup(content) );
+  }
+
+  printf("Stream has no DATA section!\n");
+  desc_file_malformed();
+  desc_file_stream_free_all( &s );
+  return (desc_file_stream)NULL ;
+/*}}}*/
+}
+
+/******************************************************************************
+
+        desc_file_stream_read_raw_line
+
+        Read the next line of [s] that is neither empty nor a comment, and
+        return it without its surrounding whitespaces, or NULL at the end of
+        the stream. The line is only valid until the next read
+
+******************************************************************************/
+char*
+desc_file_stream_read_raw_line( desc_file_stream s )
+{
+/*{{{*/
+  while( TRUE )
+  {
+    int len = 0 ;
+    while( TRUE )
+    {
+      if( !fgets( s->buf + len, s->buf_size - len, s->in ) )
+      {
+        if( len == 0 ) return (char*)NULL ;
+        break ;
+      }
+      len += strlen( s->buf + len );
+      if( len > 0 && s->buf[len-1] == '\n' ) break ;
+      if( len < s->buf_size-1 ) continue ;
+      s->buf_size *= 2 ;
+      s->buf = (char*)realloc_or_die( s->buf, s->buf_size );
+    }
+
+    char *str = trim_whitespace( s->buf );
+    if( str[0] == '#' || str[0] == '\0' ) continue ; /* Comment or empty line */
+    return str ;
+  }
+/*}}}*/
+}
+
+/******************************************************************************
+
+        desc_file_stream_read_line
+
+        Read the next data line of [s] and return its fields, or NULL at the
+        end of the stream or if the line is malformed (s->error is then set,
+        and the stream is not read any further). The fields are only valid
+        until the next read
+
+******************************************************************************/
+double*
+desc_file_stream_read_line( desc_file_stream s )
+{
+/*{{{*/
+  desc_file df = s->df ;
+  for( int k = 0 ; k < df->n_lines ; k++ )
+  {
+    free( df->lines[k] ); df->lines[k] = (double*)NULL ;
+  }
+  df->n_lines = 0 ;
+
+  if( s->error ) return (double*)NULL ;
+  char* str = desc_file_stream_read_raw_line( s );
+  if( !str ) return (double*)NULL ;
+  if( strcmp(str,"DATA") == 0 )
+  {
+    printf("Stream has many DATA sections!");
+    desc_file_malformed();
+    s->error = TRUE ;
+    return (double*)NULL ;
+  }
+
+  if( desc_file_add_data_line( df, str, &(s->dsize) ) != 0 )
+  {
+    s->error = TRUE ;
+    return (double*)NULL ;
+  }
+  return df->lines[0] ;
+/*}}}*/
+}
+
+/******************************************************************************
+
+        desc_file_stream_free_all
+
+        Free a desc_file_stream structure, without closing its file
+
+******************************************************************************/
+void
+desc_file_stream_free_all( desc_file_stream* ps )
+{
+/*{{{*/
+  if( !ps ) return ;
+
+  desc_file_stream s = *ps ;
+  if( !s ) return ;
+
+  desc_file_free_all( &(s->df) );
+  free( s->buf ); s->buf = (char*)NULL ;
+
+  free( s ); *ps = (desc_file_stream)NULL ;
+/*}}}*/
+}
+
 /******************************************************************************
 
         desc_file_save
@@ -166,6 +166,72 @@ combinatorics_log_Cnk_fill_store( double* store, int N )
 /*}}}*/
 }
 
+/*******************************************************************************
+
+        Compute log C(n,k), n = 0 .. N
+                            k = 0 .. n
+
+        only the band k <= n is stored, use combinatorics_log_Cnk_band to
+        read it, which falls back to combinatorics_log_Cnk_lgamma for n > N
+
+        RETURNS:
+          store[n*(n+1)/2+k] = log C(n,k)
+
+*******************************************************************************/
+double*
+combinatorics_log_Cnk_band_init( int N )
+{
+  double* store = (double*)calloc_or_die( (size_t)(N+1)*(N+2)/2, sizeof(double) );
+  combinatorics_log_Cnk_band_fill_store( store, N );
+  return store ;
+}
+
+/* store: array of (N+1)*(N+2)/2 doubles */
+void
+combinatorics_log_Cnk_band_fill_store( double* store, int N )
+{
+/*{{{*/
+  double* LOG_kfact = combinatorics_log_Kfact_init( N );
+
+  for( int n = 0 ; n <= N ; n++ )
+  {
+    double* row = &(store[ (size_t)n*(n+1)/2 ]) ;
+    int max_k = n/2 ;
+
+    /* Compute log C(n,k) */
+    for( int k = 0 ; k <= max_k ; k++ )
+    {
+      row[k] = LOG_kfact[n] - LOG_kfact[n-k] - LOG_kfact[k] ;
+    }
+
+    /* Mirror all computations, since comb( n, k ) = comb( n, n-k ) */
+    for( int k = 0 ; k < (n+1)/2 ; k++ )
+    {
+      row[n-k] = row[k];
+    }
+  }
+
+  free( LOG_kfact ); LOG_kfact = (double*)NULL ;
+/*}}}*/
+}
+
+/*******************************************************************************
+
+        Compute log C(n,k) from the log-gamma function, without any store
+
+        RETURNS:
+          log C(n,k) (0 <= k <= n)
+          -1.0 otherwise
+
+*******************************************************************************/
+double
+combinatorics_log_Cnk_lgamma( int n, int k )
+{
+  if( k < 0 || k > n ) return -1.0 ;
+  if( k == 0 || k == n ) return 0.0 ;
+  return ( lgamma( n+1.0 ) - lgamma( n-k+1.0 ) - lgamma( k+1.0 ) ) / M_LN10 ;
+}
+
 /*******************************************************************************
 
         Compute log C(n,k), n = 0 .. N
@@ -224,7 +224,7 @@ load_rawdata( char* fname )
   if ( (!(fp = fopen(fname, "r"))) || (fstat(fileno(fp),&buf) != 0) )
     {
       mini_mwerror(ERROR, 0,"File \"%s\" not found or unreadable\n",fname);
-      fclose(fp);
+      if (fp) fclose(fp);
       return(NULL);
     }
   /* Size of the file = size of the data, in bytes */
@@ -1,5 +1,9 @@
 #include <vision/formats/descfile.h>
 #include <vision/trajs/pointsdesc.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 /*
     ASTRE a-contrario single trajectory extraction
@@ -41,6 +45,9 @@ points_desc_new()
   pd->tags = (char**)NULL ;
   pd->points = (double**)NULL ;
 
+  pd->map = (void*)NULL ;
+  pd->map_size = 0 ;
+
   return pd ;
 /*}}}*/
 }
@@ -74,12 +81,18 @@ points_desc_free_all( points_desc* ppd )
   free( pd->n_points_in_frame ); pd->n_points_in_frame = (int*)NULL ;
   if( pd->points )
   {
-    for( int k = 0 ; k < pd->n_frames ; k++ )
-    {
-      free( pd->points[k] ); pd->points[k] = (double*)NULL ;
-    }
+    /* The points of a binary file belong to its mapping */
+    if( !pd->map )
+      for( int k = 0 ; k < pd->n_frames ; k++ )
+      {
+        free( pd->points[k] ); pd->points[k] = (double*)NULL ;
+      }
     free( pd->points ); pd->points = (double**)NULL ;
   }
+  if( pd->map )
+  {
+    munmap( pd->map, pd->map_size ); pd->map = (void*)NULL ;
+  }
   /* Some tags can be NULL so we must rely on pd->n_fields to free
    * the whole array */
   if( pd->tags )
@@ -113,42 +126,65 @@ points_desc_set_uid( points_desc pd )
   pd->uid = (int)time(NULL) + (int)getpid();
 }
 
-/* Load and add an additional column */
-points_desc
-points_desc_load_ext( Rawdata raw_in, int n_additional_fields )
+static void
+points_desc_malformed()
 {
-/*{{{*/
-  /* load rawdata descriptor */
-  desc_file df = desc_file_load( raw_in );
-  points_desc pd = points_desc_new();
-
-  void malformed () { C_log_error("PointsDescFile file malformed!\n"); exit(-1); }
+  C_log_error("PointsDescFile file malformed!\n");
+}
 
+/* Check the type of the file and read the uid, width and height headers,
+ * return -1 if they are malformed */
+static int
+points_desc_read_headers( desc_file df, points_desc pd )
+{
+/*{{{*/
   int p = desc_file_find_header( df, "type" );
-  if( p < 0 ) malformed();
+  if( p < 0 ) return -1 ;
   if( strcmp(df->header_contents[p], "PointsFile v.1.0") != 0 )
   {
     printf( "Wrong PointsFile version: %s\n", df->header_contents[p] );
-    malformed();
+    return -1 ;
   }
 
   if( !desc_file_read_header_value( df, "width", "%d", &(pd->width) ) )
   {
-    printf( "Couldn't read width!\n" ); malformed();
+    printf( "Couldn't read width!\n" ); return -1 ;
   }
   if( !desc_file_read_header_value( df, "height", "%d", &(pd->height) ) )
   {
-    printf( "Couldn't read height!\n" ); malformed();
+    printf( "Couldn't read height!\n" ); return -1 ;
   }
   if( !desc_file_read_header_value( df, "uid", "%d", &(pd->uid) ) )
   {
-    printf( "Couldn't read uid!\n" ); malformed();
+    printf( "Couldn't read uid!\n" ); return -1 ;
   }
+  return 0 ;
+/*}}}*/
+}
+
+static char points_desc_is_binary( const unsigned char* data, size_t size );
+static points_desc points_desc_load_binary( unsigned char* data, size_t size,
+                                            char in_place, int n_additional_fields );
+
+/* Load and add an additional column */
+points_desc
+points_desc_load_ext( Rawdata raw_in, int n_additional_fields )
+{
+/*{{{*/
+  if( points_desc_is_binary( raw_in->data, raw_in->size ) )
+    return points_desc_load_binary( raw_in->data, raw_in->size, FALSE, n_additional_fields );
+
+  /* load rawdata descriptor */
+  desc_file df = desc_file_load( raw_in );
+  if( !df ) return (points_desc)NULL ;
+  points_desc pd = points_desc_new();
+
+  if( points_desc_read_headers( df, pd ) != 0 ) goto malformed ;
 
   if( df->n_fields < 3 )
   {
     printf( "Not enough fields in data lines (need at least frame, x, y)!\n" );
-    malformed();
+    goto malformed ;
   }
 
   /* Move headers */
@@ -182,7 +218,7 @@ points_desc_load_ext( Rawdata raw_in, int n_additional_fields )
     if( !double_is_integer( df->lines[k][0] ) )
     {
       printf( "Error on line %d, frame number %f is not an integer!\n", k, df->lines[k][0] );
-      malformed();
+      goto malformed ;
     }
 
     int f = (int)df->lines[k][0] ;
@@ -242,6 +278,12 @@ points_desc_load_ext( Rawdata raw_in, int n_additional_fields )
   desc_file_free_all( &df );
 
   return pd ;
+
+malformed:
+  points_desc_malformed();
+  desc_file_free_all( &df );
+  points_desc_free_all( &pd );
+  return (points_desc)NULL ;
 /*}}}*/
 }
 
@@ -252,6 +294,450 @@ points_desc_load( Rawdata raw_in )
   return points_desc_load_ext( raw_in, 0 );
 }
 
+/*******************************************************************************
+
+        Binary PointsFile v.2 (see vision/trajs/pointsdesc.h).
+
+        The points of a frame are stored as the array pd->points[k], so that
+        a mapped file is used as is, and the frame numbers are given by the
+        index instead of a field.
+
+*******************************************************************************/
+
+#define POINTS_DESC_BINARY_MAGIC        "\177PFv2\r\n\032"
+#define POINTS_DESC_BINARY_HEADER_SIZE  64
+
+static char
+points_desc_is_binary( const unsigned char* data, size_t size )
+{
+  return size >= 8 && memcmp( data, POINTS_DESC_BINARY_MAGIC, 8 ) == 0 ;
+}
+
+/* Little-endian integer of n_bytes bytes */
+static uint64_t
+points_desc_get_le( const unsigned char* data, int n_bytes )
+{
+/*{{{*/
+  uint64_t v = 0 ;
+  for( int b = n_bytes-1 ; b >= 0 ; b-- )
+    v = (v << 8) | data[b] ;
+  return v ;
+/*}}}*/
+}
+
+static void
+points_desc_put_le( unsigned char* data, uint64_t v, int n_bytes )
+{
+/*{{{*/
+  for( int b = 0 ; b < n_bytes ; b++, v >>= 8 )
+    data[b] = (unsigned char)( v & 0xFF );
+/*}}}*/
+}
+
+static char
+points_desc_host_is_little_endian()
+{
+  const uint16_t one = 1 ;
+  return *(const unsigned char*)&one == 1 ;
+}
+
+/* Swap the bytes of the n doubles of a, on big-endian hosts */
+static void
+points_desc_swap_doubles( double* a, size_t n )
+{
+/*{{{*/
+  for( size_t i = 0 ; i < n ; i++ )
+  {
+    unsigned char* b = (unsigned char*)&(a[i]) ;
+    for( int j = 0 ; j < 4 ; j++ )
+    {
+      unsigned char t = b[j] ; b[j] = b[7-j] ; b[7-j] = t ;
+    }
+  }
+/*}}}*/
+}
+
+/* Load the binary PointsFile data of size bytes, or return NULL if it is
+ * malformed. If in_place is set, the points of the frames are stored in data
+ * itself, which must be writable and outlive pd, otherwise they are copied
+ * with n_additional_fields more fields */
+static points_desc
+points_desc_load_binary( unsigned char* data, size_t size, char in_place,
+                         int n_additional_fields )
+{
+/*{{{*/
+  C_assert( !in_place || n_additional_fields == 0 );
+
+  if( size < POINTS_DESC_BINARY_HEADER_SIZE
+   || points_desc_get_le( data+8, 4 ) != POINTS_DESC_BINARY_HEADER_SIZE )
+  {
+    printf( "Truncated binary PointsFile header!\n" );
+    points_desc_malformed();
+    return (points_desc)NULL ;
+  }
+  uint64_t n_fields = points_desc_get_le( data+12, 4 );
+  uint64_t n_frames = points_desc_get_le( data+32, 4 );
+  uint64_t n_headers = points_desc_get_le( data+36, 4 );
+  uint64_t index_offset = points_desc_get_le( data+40, 8 );
+  uint64_t data_offset = points_desc_get_le( data+48, 8 );
+  uint64_t n_points = points_desc_get_le( data+56, 8 );
+
+  /* Check that the index and the points are in the file, and that the
+   * counts fit in an int before anything is allocated */
+  if( n_fields < 2 )
+  {
+    printf( "Not enough fields in data lines (need at least x, y)!\n" );
+    points_desc_malformed();
+    return (points_desc)NULL ;
+  }
+  if( n_fields > (uint64_t)(INT_MAX - n_additional_fields) || n_frames > INT_MAX )
+  {
+    printf( "Too many fields or frames in binary PointsFile!\n" );
+    points_desc_malformed();
+    return (points_desc)NULL ;
+  }
+  /* The headers and the tags are NUL-terminated strings before the index */
+  if( index_offset < POINTS_DESC_BINARY_HEADER_SIZE || index_offset % 8 != 0
+   || index_offset > size || (size-index_offset)/8 < n_frames+1
+   || data_offset < index_offset + 8*(n_frames+1) || data_offset % 8 != 0
+   || data_offset > size
+   || (size-data_offset)/8/n_fields < n_points
+   || 2*n_headers + n_fields > index_offset-POINTS_DESC_BINARY_HEADER_SIZE )
+  {
+    printf( "Truncated binary PointsFile!\n" );
+    points_desc_malformed();
+    return (points_desc)NULL ;
+  }
+
+  points_desc pd = points_desc_new();
+  pd->width = (int32_t)points_desc_get_le( data+16, 4 );
+  pd->height = (int32_t)points_desc_get_le( data+20, 4 );
+  pd->uid = (int32_t)points_desc_get_le( data+24, 4 );
+  pd->orig_first_frame = (int32_t)points_desc_get_le( data+28, 4 );
+
+  /* Headers and tags, which are NUL-terminated strings before the index */
+  unsigned char* cur = data + POINTS_DESC_BINARY_HEADER_SIZE ;
+  unsigned char* end = data + index_offset ;
+  char*
+  next_string()
+  {
+    unsigned char* nul = (unsigned char*)memchr( cur, '\0', end-cur );
+    if( !nul )
+    {
+      printf( "Truncated headers in binary PointsFile!\n" );
+      return (char*)NULL ;
+    }
+    char* str = (char*)cur ;
+    cur = nul+1 ;
+    return str ;
+  }
+
+  pd->n_headers = (int)n_headers ;
+  pd->header_captions = (char**)calloc_or_die( pd->n_headers, sizeof(char*) );
+  pd->header_contents = (char**)calloc_or_die( pd->n_headers, sizeof(char*) );
+  for( int k = 0 ; k < pd->n_headers ; k++ )
+  {
+    char* caption = next_string();
+    char* content = caption ? next_string() : (char*)NULL ;
+    if( !content ) goto malformed ;
+    pd->header_captions[k] = C_string_dup( caption );
+    pd->header_contents[k] = C_string_dup( content );
+  }
+
+  pd->n_fields = (int)n_fields + n_additional_fields ;
+  pd->tags = (char**)calloc_or_die( pd->n_fields, sizeof(char*) );
+  for( int k = 0 ; k < pd->n_fields ; k++ )
+    pd->tags[k] = (char*)NULL ;
+  for( int k = 0 ; k < (int)n_fields ; k++ )
+  {
+    char* tag = next_string();
+    if( !tag ) goto malformed ;
+    if( tag[0] != '\0' ) pd->tags[k] = C_string_dup( tag );
+  }
+
+  /* Index */
+  pd->n_frames = (int)n_frames ;
+  pd->n_points_in_frame = (int*)calloc_or_die( pd->n_frames, sizeof(int) );
+  pd->points = (double**)calloc_or_die( pd->n_frames, sizeof(double*) );
+  uint64_t first = points_desc_get_le( data+index_offset, 8 );
+  if( first != 0 ) goto malformed ;
+  for( int k = 0 ; k < pd->n_frames ; k++ )
+  {
+    uint64_t next = points_desc_get_le( data+index_offset+8*(k+1), 8 );
+    if( next < first || next > n_points || next-first > INT_MAX/pd->n_fields )
+    {
+      printf( "Wrong index of frame %d in binary PointsFile!\n", k );
+      goto malformed ;
+    }
+    pd->n_points_in_frame[k] = (int)(next-first) ;
+
+    double* points = (double*)(data + data_offset + first*n_fields*sizeof(double)) ;
+    if( in_place )
+      pd->points[k] = points ;
+    else
+    {
+      pd->points[k] = (double*)calloc_or_die( pd->n_points_in_frame[k]*pd->n_fields,
+          sizeof(double) );
+      for( int p = 0 ; p < pd->n_points_in_frame[k] ; p++ )
+        memcpy( &(pd->points[k][p*pd->n_fields]), &(points[p*n_fields]),
+            n_fields*sizeof(double) );
+    }
+    if( !points_desc_host_is_little_endian() )
+      for( int p = 0 ; p < pd->n_points_in_frame[k] ; p++ )
+        points_desc_swap_doubles( &(pd->points[k][p*pd->n_fields]), n_fields );
+    first = next ;
+  }
+  if( first != n_points ) goto malformed ;
+
+  return pd ;
+
+malformed:
+  points_desc_malformed();
+  /* The points stored in data are not freed */
+  if( in_place )
+  {
+    free( pd->points ); pd->points = (double**)NULL ;
+  }
+  points_desc_free_all( &pd );
+  return (points_desc)NULL ;
+/*}}}*/
+}
+
+/* Load the pointsdesc file fname, see pointsdesc.h */
+points_desc
+points_desc_load_file( char* fname )
+{
+/*{{{*/
+  int fd = open( fname, O_RDONLY );
+  struct stat st ;
+  if( fd < 0 || fstat( fd, &st ) != 0 )
+  {
+    C_log_error( "File \"%s\" not found or unreadable\n", fname );
+    if( fd >= 0 ) close( fd );
+    return (points_desc)NULL ;
+  }
+
+  unsigned char magic[8] ;
+  if( pread( fd, magic, 8, 0 ) != 8 || !points_desc_is_binary( magic, 8 ) )
+  {
+    close( fd );
+    Rawdata rd = load_rawdata( fname );
+    if( !rd ) return (points_desc)NULL ;
+    points_desc pd = points_desc_load( rd );
+    mw_delete_rawdata( rd );
+    return pd ;
+  }
+
+  /* The mapping is private, so that the points may be modified without
+   * modifying the file */
+  size_t size = (size_t)st.st_size ;
+  void* map = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+  close( fd );
+  if( map == MAP_FAILED )
+  {
+    C_log_error( "Cannot map \"%s\" in memory\n", fname );
+    return (points_desc)NULL ;
+  }
+
+  points_desc pd = points_desc_load_binary( (unsigned char*)map, size, TRUE, 0 );
+  if( !pd )
+  {
+    munmap( map, size );
+    return (points_desc)NULL ;
+  }
+  pd->map = map ;
+  pd->map_size = size ;
+  return pd ;
+/*}}}*/
+}
+
+/* Open a stream of n_frames frames, see points_desc_stream */
+points_desc_stream
+points_desc_stream_open( FILE* in, int n_frames )
+{
+/*{{{*/
+  desc_file_stream dfs = desc_file_stream_open( in );
+  if( !dfs ) return (points_desc_stream)NULL ;
+
+  points_desc_stream s = (points_desc_stream)malloc_or_die( sizeof(struct st_points_desc_stream) );
+  s->dfs = dfs ;
+  s->pd = points_desc_new();
+  s->n_read_frames = 0 ;
+  s->has_pending = FALSE ;
+  s->pending = (double*)NULL ;
+  s->error = FALSE ;
+
+  desc_file df = s->dfs->df ;
+  points_desc pd = s->pd ;
+
+  points_desc_stream malformed ()
+  {
+    points_desc_malformed();
+    points_desc_stream_free_all( &s );
+    return (points_desc_stream)NULL ;
+  }
+
+  if( points_desc_read_headers( df, pd ) != 0 ) return malformed();
+
+  /* Read the first line, to know the fields and the first frame */
+  double* line = desc_file_stream_read_line( s->dfs );
+  if( !line )
+  {
+    if( !s->dfs->error ) printf( "No points in the stream!\n" );
+    return malformed();
+  }
+  if( df->n_fields < 3 )
+  {
+    printf( "Not enough fields in data lines (need at least frame, x, y)!\n" );
+    return malformed();
+  }
+
+  /* Copy headers */
+  pd->n_headers = df->n_headers ;
+  pd->header_captions = (char**)calloc_or_die( pd->n_headers, sizeof(char*) );
+  pd->header_contents = (char**)calloc_or_die( pd->n_headers, sizeof(char*) );
+  for( int k = 0 ; k < pd->n_headers ; k++ )
+  {
+    pd->header_captions[k] = C_string_dup( df->header_captions[k] );
+    pd->header_contents[k] = C_string_dup( df->header_contents[k] );
+  }
+
+  /* Copy tags, first field is the frame number */
+  pd->n_fields = df->n_fields - 1 ;
+  pd->tags = (char**)calloc_or_die( pd->n_fields, sizeof(char*) );
+  for( int k = 1 ; k < df->n_fields ; k++ )
+    pd->tags[k-1] = df->tags[k] ? C_string_dup( df->tags[k] ) : (char*)NULL ;
+
+  pd->orig_first_frame = (int)line[0] ;
+  pd->n_frames = n_frames ;
+  pd->n_points_in_frame = (int*)calloc_or_die( n_frames, sizeof(int) );
+  pd->points = (double**)calloc_or_die( n_frames, sizeof(double*) );
+
+  s->pending = (double*)calloc_or_die( df->n_fields, sizeof(double) );
+  memcpy( s->pending, line, df->n_fields*sizeof(double) );
+  s->has_pending = TRUE ;
+
+  return s ;
+/*}}}*/
+}
+
+/* Read the points of the next frame of the stream into pd->points, returns
+ * FALSE at the end of the stream, or if it is malformed (s->error is then
+ * set) */
+char
+points_desc_stream_read_frame( points_desc_stream s )
+{
+/*{{{*/
+  void malformed () { points_desc_malformed(); s->error = TRUE ; }
+
+  points_desc pd = s->pd ;
+  const int n_fields = pd->n_fields ;
+  const int k = s->n_read_frames ;
+
+  if( !s->has_pending ) return FALSE ;
+  if( k >= pd->n_frames )
+  {
+    printf( "Ignoring the frames from frame %d, the stream has %d frames!\n",
+        (int)s->pending[0], pd->n_frames );
+    s->has_pending = FALSE ;
+    return FALSE ;
+  }
+
+  /* The frame is complete once a line of a next frame has been read */
+  int n = 0, size = 0 ;
+  double* points = (double*)NULL ;
+  while( s->has_pending && (int)s->pending[0] - pd->orig_first_frame == k )
+  {
+    if( n >= size )
+    {
+      size = max_i( 2*size, 16 );
+      points = (double*)realloc_or_die( points, size*n_fields*sizeof(double) );
+    }
+    memcpy( &(points[n*n_fields]), s->pending+1, n_fields*sizeof(double) );
+    n++ ;
+
+    double* line = desc_file_stream_read_line( s->dfs );
+    if( !line && !s->dfs->error )
+    {
+      s->has_pending = FALSE ;
+      break ;
+    }
+    if( !line )
+      s->error = TRUE ;
+    else if( line[0] - (int)line[0] != 0.0 )
+    {
+      printf( "Error, frame number %f is not an integer!\n", line[0] );
+      malformed();
+    }
+    else if( (int)line[0] - pd->orig_first_frame < k )
+    {
+      printf( "Error, frame %d comes after frame %d!\n",
+          (int)line[0], k + pd->orig_first_frame );
+      malformed();
+    }
+    if( s->error )
+    {
+      free( points );
+      s->has_pending = FALSE ;
+      return FALSE ;
+    }
+    memcpy( s->pending, line, (n_fields+1)*sizeof(double) );
+  }
+
+  free( pd->points[k] );
+  pd->points[k] = points ;
+  pd->n_points_in_frame[k] = n ;
+  s->n_read_frames++ ;
+
+  return TRUE ;
+/*}}}*/
+}
+
+void
+points_desc_stream_free_all( points_desc_stream* ps )
+{
+/*{{{*/
+  if( ps == NULL ) return ;
+
+  points_desc_stream s = *ps ;
+  if( s == NULL ) return ;
+
+  desc_file_stream_free_all( &(s->dfs) );
+  points_desc_free_all( &(s->pd) );
+  free( s->pending ); s->pending = (double*)NULL ;
+
+  free( s );
+  *ps = (points_desc_stream)NULL ;
+/*}}}*/
+}
+
+/* Write the headers of pd and the DATA line */
+void
+points_desc_write_headers( FILE* out, points_desc pd )
+{
+/*{{{*/
+  for( int k = 0 ; k < pd->n_headers ; k++ )
+    fprintf( out, "%s = %s\n", pd->header_captions[k], pd->header_contents[k] );
+  fprintf( out, "DATA\n" );
+/*}}}*/
+}
+
+/* Write the data line of the point p of frame k, followed by the field tag:v */
+void
+points_desc_write_point( FILE* out, points_desc pd, int k, int p, char* tag, double v )
+{
+/*{{{*/
+  double* fields = &(pd->points[k][p*pd->n_fields]) ;
+  fprintf( out, "f:%g ", (double)(k+pd->orig_first_frame) );
+  for( int q = 0 ; q < pd->n_fields ; q++ )
+  {
+    if( pd->tags[q] ) fprintf( out, "%s:", pd->tags[q] );
+    fprintf( out, "%g ", fields[q] );
+  }
+  fprintf( out, "%s:%g \n", tag, v );
+/*}}}*/
+}
+
 void
 points_desc_save( Rawdata raw_out, points_desc pd )
 {
@@ -343,6 +829,102 @@ points_desc_save( Rawdata raw_out, points_desc pd )
 /*}}}*/
 }
 
+void
+points_desc_save_binary( Rawdata raw_out, points_desc pd )
+{
+/*{{{*/
+  /* The headers, with the type of the file */
+  char* type = "PointsFile v.2" ;
+  int n_headers = pd->n_headers ;
+  char** captions = (char**)calloc_or_die( n_headers+1, sizeof(char*) );
+  char** contents = (char**)calloc_or_die( n_headers+1, sizeof(char*) );
+  char has_type = FALSE ;
+  for( int k = 0 ; k < pd->n_headers ; k++ )
+  {
+    captions[k] = pd->header_captions[k] ;
+    contents[k] = pd->header_contents[k] ;
+    if( strcmp( captions[k], "type" ) == 0 )
+    {
+      contents[k] = type ;
+      has_type = TRUE ;
+    }
+  }
+  if( !has_type )
+  {
+    captions[n_headers] = "type" ;
+    contents[n_headers] = type ;
+    n_headers++ ;
+  }
+
+  /* Layout of the file */
+  size_t text_size = 0 ;
+  for( int k = 0 ; k < n_headers ; k++ )
+    text_size += strlen( captions[k] ) + strlen( contents[k] ) + 2 ;
+  for( int k = 0 ; k < pd->n_fields ; k++ )
+    text_size += ( pd->tags[k] ? strlen( pd->tags[k] ) : 0 ) + 1 ;
+
+  uint64_t n_points = 0 ;
+  for( int k = 0 ; k < pd->n_frames ; k++ )
+    n_points += pd->n_points_in_frame[k] ;
+
+  uint64_t index_offset = ( POINTS_DESC_BINARY_HEADER_SIZE + text_size + 7 ) / 8 * 8 ;
+  uint64_t data_offset = ( index_offset + 8*(pd->n_frames+1) + 63 ) / 64 * 64 ;
+  uint64_t size = data_offset + n_points*pd->n_fields*sizeof(double) ;
+  if( size > INT_MAX )
+  {
+    C_log_error( "Too many points for a binary PointsFile (%llu bytes)!\n",
+        (unsigned long long)size );
+    exit(-1);
+  }
+
+  raw_out = change_rawdata_or_die( raw_out, (int)size );
+  unsigned char* data = raw_out->data ;
+  memset( data, 0, data_offset );
+
+  memcpy( data, POINTS_DESC_BINARY_MAGIC, 8 );
+  points_desc_put_le( data+8, POINTS_DESC_BINARY_HEADER_SIZE, 4 );
+  points_desc_put_le( data+12, pd->n_fields, 4 );
+  points_desc_put_le( data+16, (uint32_t)pd->width, 4 );
+  points_desc_put_le( data+20, (uint32_t)pd->height, 4 );
+  points_desc_put_le( data+24, (uint32_t)pd->uid, 4 );
+  points_desc_put_le( data+28, (uint32_t)pd->orig_first_frame, 4 );
+  points_desc_put_le( data+32, pd->n_frames, 4 );
+  points_desc_put_le( data+36, n_headers, 4 );
+  points_desc_put_le( data+40, index_offset, 8 );
+  points_desc_put_le( data+48, data_offset, 8 );
+  points_desc_put_le( data+56, n_points, 8 );
+
+  char* cur = (char*)data + POINTS_DESC_BINARY_HEADER_SIZE ;
+  for( int k = 0 ; k < n_headers ; k++ )
+  {
+    strcpy( cur, captions[k] ); cur += strlen( captions[k] ) + 1 ;
+    strcpy( cur, contents[k] ); cur += strlen( contents[k] ) + 1 ;
+  }
+  for( int k = 0 ; k < pd->n_fields ; k++ )
+  {
+    if( pd->tags[k] ) strcpy( cur, pd->tags[k] );
+    cur += ( pd->tags[k] ? strlen( pd->tags[k] ) : 0 ) + 1 ;
+  }
+
+  /* Index and points */
+  uint64_t first = 0 ;
+  for( int k = 0 ; k < pd->n_frames ; k++ )
+  {
+    points_desc_put_le( data+index_offset+8*k, first, 8 );
+    double* points = (double*)(data + data_offset + first*pd->n_fields*sizeof(double)) ;
+    size_t n = (size_t)pd->n_points_in_frame[k]*pd->n_fields ;
+    memcpy( points, pd->points[k], n*sizeof(double) );
+    if( !points_desc_host_is_little_endian() )
+      points_desc_swap_doubles( points, n );
+    first += pd->n_points_in_frame[k] ;
+  }
+  points_desc_put_le( data+index_offset+8*pd->n_frames, first, 8 );
+
+  free( captions );
+  free( contents );
+/*}}}*/
+}
+
 points_desc
 points_desc_copy( points_desc pd, int n_new_fields )
 {
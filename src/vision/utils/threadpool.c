@@ -0,0 +1,189 @@
+#include <vision/core.h>
+#include <vision/utils/threadpool.h>
+
+/*
+    ASTRE a-contrario single trajectory extraction
+    Copyright (C) 2011 Mael Primet (mael.primet AT gmail.com)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+typedef struct st_thread_pool_worker_arg {
+  thread_pool tp ;
+  int thread ;
+} thread_pool_worker_arg ;
+
+/* Take jobs until there are none left in the current loop */
+static void
+thread_pool_eat_jobs( thread_pool tp, int thread )
+{
+  while( TRUE )
+  {
+    int i = __sync_fetch_and_add( &(tp->next_job), 1 );
+    if( i >= tp->n_jobs ) break ;
+    tp->job( tp->data, i, thread );
+  }
+}
+
+static void*
+thread_pool_worker( void* arg )
+{
+/*{{{*/
+  thread_pool tp = ((thread_pool_worker_arg*)arg)->tp ;
+  int thread = ((thread_pool_worker_arg*)arg)->thread ;
+  free( arg );
+
+  if( tp->init ) tp->init( tp->init_arg, thread );
+
+  int seen_generation = 0 ;
+
+  while( TRUE )
+  {
+    pthread_mutex_lock( &(tp->lock) );
+    while( tp->generation == seen_generation && !tp->shutdown )
+      pthread_cond_wait( &(tp->start), &(tp->lock) );
+    if( tp->shutdown )
+    {
+      pthread_mutex_unlock( &(tp->lock) );
+      break ;
+    }
+    seen_generation = tp->generation ;
+    pthread_mutex_unlock( &(tp->lock) );
+
+    thread_pool_eat_jobs( tp, thread );
+
+    pthread_mutex_lock( &(tp->lock) );
+    tp->n_busy-- ;
+    if( tp->n_busy == 0 ) pthread_cond_signal( &(tp->done) );
+    pthread_mutex_unlock( &(tp->lock) );
+  }
+
+  return NULL ;
+/*}}}*/
+}
+
+thread_pool
+thread_pool_new( int n_threads )
+{
+  return thread_pool_new_with_init( n_threads, (thread_pool_init)NULL, NULL );
+}
+
+thread_pool
+thread_pool_new_with_init( int n_threads, thread_pool_init init, void* arg )
+{
+/*{{{*/
+  if( n_threads < 1 ) n_threads = 1 ;
+
+  thread_pool tp = (thread_pool)malloc_or_die( sizeof(struct st_thread_pool) );
+  tp->n_threads = n_threads ;
+  tp->job = (thread_pool_job)NULL ;
+  tp->data = NULL ;
+  tp->n_jobs = 0 ;
+  tp->next_job = 0 ;
+  tp->generation = 0 ;
+  tp->n_busy = 0 ;
+  tp->shutdown = FALSE ;
+  tp->init = init ;
+  tp->init_arg = arg ;
+
+  pthread_mutex_init( &(tp->lock), NULL );
+  pthread_cond_init( &(tp->start), NULL );
+  pthread_cond_init( &(tp->done), NULL );
+
+  tp->workers = (pthread_t*)calloc_or_die( n_threads, sizeof(pthread_t) );
+  for( int t = 1 ; t < n_threads ; t++ )
+  {
+    thread_pool_worker_arg* arg =
+      (thread_pool_worker_arg*)malloc_or_die( sizeof(thread_pool_worker_arg) );
+    arg->tp = tp ;
+    arg->thread = t ;
+    if( pthread_create( &(tp->workers[t]), NULL, &thread_pool_worker, arg ) != 0 )
+    {
+      C_log_error( "Could not create worker thread %d!\n", t );
+      free( arg );
+      /* Stop the workers created so far */
+      tp->n_threads = t ;
+      thread_pool_free_all( &tp );
+      return (thread_pool)NULL ;
+    }
+  }
+
+  return tp ;
+/*}}}*/
+}
+
+void
+thread_pool_free_all( thread_pool* ptp )
+{
+/*{{{*/
+  if( !ptp || !*ptp ) return ;
+  thread_pool tp = *ptp ;
+
+  pthread_mutex_lock( &(tp->lock) );
+  tp->shutdown = TRUE ;
+  pthread_cond_broadcast( &(tp->start) );
+  pthread_mutex_unlock( &(tp->lock) );
+
+  for( int t = 1 ; t < tp->n_threads ; t++ )
+    pthread_join( tp->workers[t], NULL );
+
+  pthread_cond_destroy( &(tp->done) );
+  pthread_cond_destroy( &(tp->start) );
+  pthread_mutex_destroy( &(tp->lock) );
+  free( tp->workers );
+  free( tp );
+
+  *ptp = (thread_pool)NULL ;
+/*}}}*/
+}
+
+void
+thread_pool_run( thread_pool tp, int n_jobs, thread_pool_job job, void* data )
+{
+/*{{{*/
+  if( n_jobs <= 0 ) return ;
+
+  /* Nothing to share: run everything in the calling thread */
+  if( tp->n_threads == 1 || n_jobs == 1 )
+  {
+    for( int i = 0 ; i < n_jobs ; i++ )
+      job( data, i, 0 );
+    return ;
+  }
+
+  pthread_mutex_lock( &(tp->lock) );
+  tp->job = job ;
+  tp->data = data ;
+  tp->n_jobs = n_jobs ;
+  tp->next_job = 0 ;
+  tp->n_busy = tp->n_threads-1 ;
+  tp->generation++ ;
+  pthread_cond_broadcast( &(tp->start) );
+  pthread_mutex_unlock( &(tp->lock) );
+
+  thread_pool_eat_jobs( tp, 0 );
+
+  pthread_mutex_lock( &(tp->lock) );
+  while( tp->n_busy > 0 )
+    pthread_cond_wait( &(tp->done), &(tp->lock) );
+  pthread_mutex_unlock( &(tp->lock) );
+/*}}}*/
+}
+
+int
+thread_pool_n_cpus()
+{
+  long n = sysconf( _SC_NPROCESSORS_ONLN );
+  return n < 1 ? 1 : (int)n ;
+}
@@ -0,0 +1,55 @@
+#!/bin/sh
+
+#   ASTRE a-contrario single trajectory extraction
+#   Copyright (C) 2011 Mael Primet (mael.primet AT gmail.com)
+#
+#   This program is free software: you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation, either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# Times the G kernels of each instruction set (--simd 0 to 3) on a points
+# file, and checks that they all give the trajectories of the scalar ones.
+#
+# usage: bench-simd.sh [points file] [astre options...]
+#
+# The defaults scan data/synthetic-t20-n160 without the spatial index, so
+# that the time is spent relaxing the G values. ASTRE gives the binary to
+# use (bin/astre-noholes by default).
+
+ASTRE=${ASTRE:-bin/astre-noholes}
+IN=${1:-data/synthetic-t20-n160}
+[ $# -gt 0 ] && shift
+[ $# -eq 0 ] && set -- --no-spatial-index
+
+TMP=$(mktemp -d) || exit 1
+trap 'rm -rf "$TMP"' EXIT
+
+status=0
+for level in 0 1 2 3
+do
+  start=$(date +%s.%N)
+  if ! "$ASTRE" --simd $level "$@" "$IN" "$TMP/out.$level" > "$TMP/log.$level" 2>&1
+  then
+    echo "simd $level: failed, see below" ; cat "$TMP/log.$level" ; exit 1
+  fi
+  end=$(date +%s.%N)
+
+  kernels=$(sed -n 's/^ > Kernels: //p' "$TMP/log.$level")
+  same=""
+  if [ $level -gt 0 ] && ! cmp -s "$TMP/out.0" "$TMP/out.$level"
+  then
+    same=" (OUTPUT DIFFERS FROM THE SCALAR ONE)" ; status=1
+  fi
+  echo "simd $level ($kernels): $(awk "BEGIN { printf \"%.2f\", $end - $start }") s$same"
+done
+
+exit $status